@@ -91,10 +91,10 @@ namespace {
     void LogTask(void* unused_)
     {
         while (1) {
-            // Wait until a 100ms timer has elapsed, or the
-            // log buffer hits 50% or rolls over.  Then flush the
+            // Wait until a 500ms timer has elapsed, or the
+            // log buffer reaches its high watermark.  Then flush the
             // logging data out the debug interface
-            clLogNotify.Wait(100, nullptr);
+            clLogNotify.Wait(500, nullptr);
             auto &logBuf = LogBuf::Instance();
             logBuf.FlushData();
         }
@@ -130,6 +130,11 @@ int main()
     logBuf.SetNotifyCallback(OnLogNotify);
     logBuf.SetLogWriter(LogWriter);
 
+    // Wake the logger thread once half the buffer is unflushed, or every 16
+    // records, but no more than once every 50ms.
+    logBuf.SetNotifyThresholds(256, 64, 16);
+    logBuf.SetNotifyInterval(50);
+
     // Initialize the main application thread that logs data to the logger
     clAppThread.Init(wAppStack, sizeof(wAppStack), 2, AppTask, nullptr);
     clAppThread.Start();
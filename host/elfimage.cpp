@@ -0,0 +1,259 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file elfimage.cpp Read-only view of a target's .elf file, by target address
+ */
+#include "elfimage.h"
+
+#include <algorithm>
+
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//---------------------------------------------------------------------------
+ElfImage::ElfImage(const char* szPath_)
+: m_szPath{szPath_}
+, m_pvMap{nullptr}
+, m_uMapSize{0}
+, m_pstSections{nullptr}
+, m_iSections{0}
+, m_pstSymbols{nullptr}
+, m_iSymbols{0}
+, m_u64CodeSize{0}
+, m_u64ConstSize{0}
+{}
+
+//---------------------------------------------------------------------------
+ElfImage::~ElfImage()
+{
+    free(m_pstSections);
+    free(m_pstSymbols);
+    if (m_pvMap) {
+        munmap(m_pvMap, m_uMapSize);
+    }
+}
+
+//---------------------------------------------------------------------------
+bool ElfImage::Init()
+{
+    auto fd = open(m_szPath, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat stStat;
+    if (fstat(fd, &stStat) || (stStat.st_size < EI_NIDENT)) {
+        close(fd);
+        return false;
+    }
+    m_uMapSize = stStat.st_size;
+    m_pvMap = mmap(nullptr, m_uMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m_pvMap == MAP_FAILED) {
+        m_pvMap = nullptr;
+        return false;
+    }
+
+    auto* pu8Ident = (const uint8_t*)m_pvMap;
+    if (memcmp(pu8Ident, ELFMAG, SELFMAG) || (pu8Ident[EI_DATA] != ELFDATA2LSB)) {
+        return false;
+    }
+    switch (pu8Ident[EI_CLASS]) {
+        case ELFCLASS32: return IndexSections<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>();
+        case ELFCLASS64: return IndexSections<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>();
+        default: return false;
+    }
+}
+
+//---------------------------------------------------------------------------
+template <typename Ehdr, typename Shdr, typename Sym>
+bool ElfImage::IndexSections()
+{
+    auto* pu8File = (const uint8_t*)m_pvMap;
+    if (m_uMapSize < sizeof(Ehdr)) {
+        return false;
+    }
+    Ehdr stHeader;
+    memcpy(&stHeader, pu8File, sizeof(stHeader));
+    if ((stHeader.e_shentsize != sizeof(Shdr))
+        || ((stHeader.e_shoff + ((uint64_t)stHeader.e_shnum * sizeof(Shdr))) > m_uMapSize)) {
+        return false;
+    }
+
+    // Section names, used to leave the .logger section out of the image size
+    const char* szNames = nullptr;
+    uint64_t u64NamesSize = 0;
+    if (stHeader.e_shstrndx < stHeader.e_shnum) {
+        Shdr stNames;
+        memcpy(&stNames, &pu8File[stHeader.e_shoff + (stHeader.e_shstrndx * sizeof(Shdr))], sizeof(stNames));
+        if ((stNames.sh_offset + stNames.sh_size) <= m_uMapSize) {
+            szNames = (const char*)&pu8File[stNames.sh_offset];
+            u64NamesSize = stNames.sh_size;
+        }
+    }
+
+    m_pstSections = (ElfSection*)malloc(sizeof(ElfSection) * (stHeader.e_shnum + 1));
+    m_iSections = 0;
+    for (auto i = 0; i < stHeader.e_shnum; i++) {
+        Shdr stSection;
+        memcpy(&stSection, &pu8File[stHeader.e_shoff + (i * sizeof(Shdr))], sizeof(stSection));
+
+        // The symbol table's names are held in the section it links to
+        if ((stSection.sh_type == SHT_SYMTAB) && !m_pstSymbols && (stSection.sh_link < stHeader.e_shnum)) {
+            Shdr stStrings;
+            memcpy(&stStrings, &pu8File[stHeader.e_shoff + (stSection.sh_link * sizeof(Shdr))], sizeof(stStrings));
+            IndexSymbols<Shdr, Sym>(stSection, stStrings, (stHeader.e_machine == EM_ARM));
+        }
+
+        if ((stSection.sh_flags & SHF_ALLOC) && (stSection.sh_type == SHT_PROGBITS)) {
+            auto bLogger = szNames && (stSection.sh_name < u64NamesSize)
+                           && !strncmp(&szNames[stSection.sh_name], ".logger", u64NamesSize - stSection.sh_name);
+            if (stSection.sh_flags & SHF_EXECINSTR) {
+                m_u64CodeSize += stSection.sh_size;
+            } else if (!(stSection.sh_flags & SHF_WRITE) && !bLogger) {
+                m_u64ConstSize += stSection.sh_size;
+            }
+        }
+
+        // Only sections that occupy memory on the target, and whose contents
+        // are stored in the file, can be read back.
+        if (!(stSection.sh_flags & SHF_ALLOC) || (stSection.sh_type != SHT_PROGBITS)) {
+            continue;
+        }
+        if ((stSection.sh_offset + stSection.sh_size) > m_uMapSize) {
+            continue;
+        }
+        auto& stEntry = m_pstSections[m_iSections++];
+        stEntry.address = stSection.sh_addr;
+        stEntry.size = stSection.sh_size;
+        stEntry.data = &pu8File[stSection.sh_offset];
+        stEntry.name = "";
+        if (szNames && (stSection.sh_name < u64NamesSize)
+            && memchr(&szNames[stSection.sh_name], '\0', u64NamesSize - stSection.sh_name)) {
+            stEntry.name = &szNames[stSection.sh_name];
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+template <typename Shdr, typename Sym>
+void ElfImage::IndexSymbols(const Shdr& stSymbols_, const Shdr& stStrings_, bool bArm_)
+{
+    auto* pu8File = (const uint8_t*)m_pvMap;
+    if ((stSymbols_.sh_entsize != sizeof(Sym)) || ((stSymbols_.sh_offset + stSymbols_.sh_size) > m_uMapSize)
+        || ((stStrings_.sh_offset + stStrings_.sh_size) > m_uMapSize) || !stStrings_.sh_size
+        || pu8File[stStrings_.sh_offset + stStrings_.sh_size - 1]) {
+        return;
+    }
+    auto* szStrings = (const char*)&pu8File[stStrings_.sh_offset];
+    auto uCount = stSymbols_.sh_size / sizeof(Sym);
+
+    m_pstSymbols = (ElfSymbol*)malloc(sizeof(ElfSymbol) * (uCount + 1));
+    m_iSymbols = 0;
+    for (size_t i = 0; i < uCount; i++) {
+        Sym stSymbol;
+        memcpy(&stSymbol, &pu8File[stSymbols_.sh_offset + (i * sizeof(Sym))], sizeof(stSymbol));
+
+        // Only named functions and objects that are defined in the image
+        auto iType = stSymbol.st_info & 0xF;
+        if (((iType != STT_FUNC) && (iType != STT_OBJECT)) || (stSymbol.st_shndx == SHN_UNDEF)
+            || (stSymbol.st_shndx >= SHN_LORESERVE) || !stSymbol.st_name || (stSymbol.st_name >= stStrings_.sh_size)) {
+            continue;
+        }
+        auto& stEntry = m_pstSymbols[m_iSymbols++];
+        stEntry.address = stSymbol.st_value;
+        stEntry.size = stSymbol.st_size;
+        stEntry.name = &szStrings[stSymbol.st_name];
+        stEntry.thumb = bArm_ && (iType == STT_FUNC) && (stSymbol.st_value & 1);
+        if (stEntry.thumb) {
+            stEntry.address &= ~1ULL;
+        }
+    }
+
+    // Symbols at the same address (i.e. aliases) are ordered largest first, so
+    // a search lands on one that has a size, where any does.
+    std::sort(m_pstSymbols, m_pstSymbols + m_iSymbols, [](const ElfSymbol& a, const ElfSymbol& b) {
+        return (a.address != b.address) ? (a.address < b.address) : (a.size > b.size);
+    });
+}
+
+//---------------------------------------------------------------------------
+const ElfSymbol* ElfImage::FindSymbol(uint64_t u64Address_, uint64_t* pu64Offset_) const
+{
+    // The last symbol starting at or before the address (the first of those
+    // sharing its address)
+    auto* pstEnd = m_pstSymbols + m_iSymbols;
+    auto* pstSymbol = std::upper_bound(m_pstSymbols, pstEnd, u64Address_,
+                                       [](uint64_t u64Address, const ElfSymbol& stSymbol) { return u64Address < stSymbol.address; });
+    if (pstSymbol == m_pstSymbols) {
+        return nullptr;
+    }
+    pstSymbol--;
+    while ((pstSymbol > m_pstSymbols) && (pstSymbol[-1].address == pstSymbol->address)) {
+        pstSymbol--;
+    }
+
+    // Symbols without a size only match their own address
+    auto u64Offset = u64Address_ - pstSymbol->address;
+    if (pstSymbol->size ? (u64Offset >= pstSymbol->size) : (u64Offset != 0)) {
+        return nullptr;
+    }
+    // A pointer to a Thumb function carries the function's address + 1
+    if (pstSymbol->thumb && (u64Offset == 1)) {
+        u64Offset = 0;
+    }
+    *pu64Offset_ = u64Offset;
+    return pstSymbol;
+}
+
+//---------------------------------------------------------------------------
+const ElfSection* ElfImage::FindSection(const char* szName_) const
+{
+    for (auto i = 0; i < m_iSections; i++) {
+        if (!strcmp(m_pstSections[i].name, szName_)) {
+            return &m_pstSections[i];
+        }
+    }
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------
+const uint8_t* ElfImage::Read(uint64_t u64Address_, size_t* puAvailable_) const
+{
+    for (auto i = 0; i < m_iSections; i++) {
+        auto& stSection = m_pstSections[i];
+        if ((u64Address_ >= stSection.address) && (u64Address_ < (stSection.address + stSection.size))) {
+            auto u64Offset = u64Address_ - stSection.address;
+            *puAvailable_ = stSection.size - u64Offset;
+            return &stSection.data[u64Offset];
+        }
+    }
+    return nullptr;
+}
+
+//---------------------------------------------------------------------------
+const char* ElfImage::ReadString(uint64_t u64Address_) const
+{
+    size_t uAvailable;
+    auto* pu8Data = Read(u64Address_, &uAvailable);
+    if (!pu8Data || !memchr(pu8Data, '\0', uAvailable)) {
+        return nullptr;
+    }
+    return (const char*)pu8Data;
+}
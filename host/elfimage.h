@@ -0,0 +1,145 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file elfimage.h Read-only view of a target's .elf file, by target address
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The ElfSection struct
+ *
+ * A section of the target image that holds initialized data at run-time
+ */
+struct ElfSection {
+    uint64_t        address;    //!< Target address of the start of the section
+    uint64_t        size;       //!< Size of the section, in bytes
+    const uint8_t*  data;       //!< Contents of the section, within the mapped file
+    const char*     name;       //!< Name of the section, within the mapped file ("" if unknown)
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The ElfSymbol struct
+ *
+ * A function or object from the image's symbol table
+ */
+struct ElfSymbol {
+    uint64_t        address;    //!< Target address of the start of the symbol
+    uint64_t        size;       //!< Size of the symbol, in bytes (0 if unknown)
+    const char*     name;       //!< Name of the symbol, within the mapped file
+    bool            thumb;      //!< Thumb function, whose pointers have bit 0 set
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The ElfImage class
+ *
+ * Maps a (32 or 64-bit, little-endian) .elf file built for the target, and
+ * resolves target addresses to the data stored at those addresses, so that
+ * arguments logged as pointers to constant data (i.e. TagString) can be
+ * rendered on the host, and to the functions and objects at those addresses,
+ * so that other pointers (i.e. TagVoidptr) can be rendered symbolically.
+ */
+class ElfImage {
+public:
+    /**
+     * @brief ElfImage
+     * @param szPath_ Path to the target's .elf file
+     */
+    ElfImage(const char* szPath_);
+    ~ElfImage();
+
+    /**
+     * @brief Init
+     *
+     * Map the file, and index its loadable sections and the functions and
+     * objects in its symbol table.
+     *
+     * @return true on success, false if the file couldn't be read or isn't a
+     *         supported .elf file
+     */
+    bool Init();
+
+    /**
+     * @brief Read
+     * @param u64Address_ Target address to read from
+     * @param puAvailable_ [out] Number of bytes available from that address to
+     *        the end of the section containing it
+     * @return Pointer to the data at the given address, or nullptr if the
+     *         address is not within any of the image's sections
+     */
+    const uint8_t* Read(uint64_t u64Address_, size_t* puAvailable_) const;
+
+    /**
+     * @brief ReadString
+     * @param u64Address_ Target address of a nul-terminated string
+     * @return Pointer to the string, or nullptr if the address is not within
+     *         the image, or the string isn't terminated within its section
+     */
+    const char* ReadString(uint64_t u64Address_) const;
+
+    /**
+     * @brief FindSymbol
+     *
+     * Find the function or object containing a target address, by binary
+     * search of the symbol index built by Init().
+     *
+     * @param u64Address_ Target address to resolve
+     * @param pu64Offset_ [out] Offset of the address from the start of the symbol
+     * @return The symbol containing the address, or nullptr if there is none
+     *         (or the image has no symbol table)
+     */
+    const ElfSymbol* FindSymbol(uint64_t u64Address_, uint64_t* pu64Offset_) const;
+
+    /**
+     * @brief FindSection
+     * @param szName_ Name of the section (i.e. "logger_sites")
+     * @return The loadable section with the given name, or nullptr if there is none
+     */
+    const ElfSection* FindSection(const char* szName_) const;
+
+    /**
+     * @brief GetCodeSize
+     * @return Total size of the image's executable sections, in bytes
+     */
+    uint64_t GetCodeSize() const { return m_u64CodeSize; }
+
+    /**
+     * @brief GetConstSize
+     * @return Total size of the image's read-only data sections (excluding the
+     *         .logger section, which isn't loaded on the target), in bytes
+     */
+    uint64_t GetConstSize() const { return m_u64ConstSize; }
+
+private:
+    template <typename Ehdr, typename Shdr, typename Sym>
+    bool IndexSections();
+
+    template <typename Shdr, typename Sym>
+    void IndexSymbols(const Shdr& stSymbols_, const Shdr& stStrings_, bool bArm_);
+
+    const char*     m_szPath;
+    void*           m_pvMap;
+    size_t          m_uMapSize;
+    ElfSection*     m_pstSections;
+    int             m_iSections;
+    ElfSymbol*      m_pstSymbols;   // Sorted by address
+    int             m_iSymbols;
+    uint64_t        m_u64CodeSize;
+    uint64_t        m_u64ConstSize;
+};
@@ -21,6 +21,23 @@ public:
         m_clList.Add(pclFile_);
     }
 
+    FileMap* Find(uint32_t fileHash_) {
+        // Consecutive records tend to come from the same file
+        if (m_pclLast && m_pclLast->m_fileHash == fileHash_) {
+            return m_pclLast;
+        }
+        auto* node = m_clList.GetHead();
+        while (node != nullptr) {
+            auto* mapNode = static_cast<FileMap*>(node);
+            if (mapNode->m_fileHash == fileHash_) {
+                m_pclLast = mapNode;
+                return mapNode;
+            }
+            node = node->GetNext();
+        }
+        return nullptr;
+    }
+
     void Serialize() {
         auto* node = m_clList.GetHead();
         printf("\"fileMap\": [\n");
@@ -41,4 +58,5 @@ public:
 
 private:
     DoubleLinkList m_clList;
+    FileMap* m_pclLast = nullptr;
 };
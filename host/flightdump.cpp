@@ -0,0 +1,167 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file flightdump.cpp Recovery of records from a RAM dump of a target's flight recorder
+ */
+#include "flightdump.h"
+#include "crc16.h"
+#include "crc32.h"
+#include "logstream.h"
+#include "logtypes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    constexpr uint16_t syncBegin = 0xCAFE;
+    constexpr uint16_t syncEnd = 0xF00D;
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+FlightDump::FlightDump(const char* szPath_, bool bAll_)
+: m_szPath{szPath_}
+, m_bAll{bAll_}
+, m_pu8Capture{nullptr}
+, m_uCaptureLen{0}
+, m_uCaptureSize{0}
+, m_iRecorders{0}
+{}
+
+//---------------------------------------------------------------------------
+FlightDump::~FlightDump()
+{
+    free(m_pu8Capture);
+}
+
+//---------------------------------------------------------------------------
+bool FlightDump::Init()
+{
+    auto* pstFile = fopen(m_szPath, "rb");
+    if (!pstFile) {
+        return false;
+    }
+    size_t uSize = 0;
+    size_t uCapacity = 64 * 1024;
+    auto* pu8Dump = (uint8_t*)malloc(uCapacity);
+    size_t nr;
+    while ((nr = fread(&pu8Dump[uSize], 1, uCapacity - uSize, pstFile)) > 0) {
+        uSize += nr;
+        if (uSize == uCapacity) {
+            uCapacity *= 2;
+            pu8Dump = (uint8_t*)realloc(pu8Dump, uCapacity);
+        }
+    }
+    fclose(pstFile);
+
+    // Headers aren't necessarily aligned within the dump, so check every offset
+    for (size_t i = 0; (i + sizeof(LogFlightHeader_t)) <= uSize; i++) {
+        LogFlightHeader_t stHeader;
+        memcpy(&stHeader, &pu8Dump[i], sizeof(stHeader));
+        if ((stHeader.magic != flight_recorder_magic)
+            || (stHeader.crc != crc32_nibble(&stHeader, offsetof(LogFlightHeader_t, crc)))
+            || (stHeader.read_idx > stHeader.size) || (stHeader.last_read_idx > stHeader.size)
+            || ((i + sizeof(stHeader) + stHeader.size) > uSize)) {
+            continue;
+        }
+
+        auto* pu8Ring = &pu8Dump[i + sizeof(stHeader)];
+        auto uData = m_uCaptureLen;
+
+        // The oldest data that can survive in the ring follows the end of the
+        // committed records (possibly in the middle of a record, or of one that
+        // was being written, which the decoder skips).
+        size_t uStart = m_bAll ? stHeader.read_idx : stHeader.last_read_idx;
+        size_t uEnd = stHeader.read_idx;
+        if (m_bAll || (uEnd < uStart)) {
+            Append(&pu8Ring[uStart], stHeader.size - uStart);
+            Append(pu8Ring, uEnd);
+        } else {
+            Append(&pu8Ring[uStart], uEnd - uStart);
+        }
+
+        // Shard records are stamped with the time of the first record recovered
+        // from the shard, so they don't disturb the timeline, and framed like
+        // it, so they aren't rejected from a framed (LOGBUF_FRAMING) capture.
+        if (stHeader.shard_count > 1) {
+            LogRecord stRecord;
+            size_t uOffset = uData;
+            while ((uOffset < m_uCaptureLen)
+                   && (LogStream::Decode(&m_pu8Capture[uOffset], m_uCaptureLen - uOffset, &stRecord) <= 0)) {
+                uOffset++;
+            }
+            if (uOffset < m_uCaptureLen) {
+                InsertShardRecord(uData, stHeader.shard, stHeader.shard_count, stRecord.header.timestamp,
+                                  (stRecord.flags & log_flag_crc) != 0);
+            }
+        }
+
+        m_iRecorders++;
+        i += sizeof(stHeader) + stHeader.size - 1;
+    }
+    free(pu8Dump);
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void FlightDump::Append(const uint8_t* pu8Data_, size_t uLen_)
+{
+    if ((m_uCaptureLen + uLen_) > m_uCaptureSize) {
+        m_uCaptureSize = (m_uCaptureLen + uLen_) * 2;
+        m_pu8Capture = (uint8_t*)realloc(m_pu8Capture, m_uCaptureSize);
+    }
+    memcpy(&m_pu8Capture[m_uCaptureLen], pu8Data_, uLen_);
+    m_uCaptureLen += uLen_;
+}
+
+//---------------------------------------------------------------------------
+void FlightDump::InsertShardRecord(size_t uOffset_, uint8_t u8Shard_, uint8_t u8Count_, uint32_t u32Timestamp_, bool bFramed_)
+{
+    // Attribute the records that follow to their shard, as the target does
+    // when flushing sharded buffers, so they can be merged back into order.
+    // As with the records the target writes directly, a framed shard record
+    // carries a CRC, but no sequence number.
+    struct __attribute__((packed)) {
+        uint16_t syncBegin;
+        LogHeader_t header;
+        uint8_t shardTlv;
+        uint8_t shard;
+        uint8_t countTlv;
+        uint8_t count;
+        uint16_t crc;
+        uint16_t syncEnd;
+    } stRecord = {
+        syncBegin,
+        { system_file_id, u32Timestamp_, (uint16_t)LogSystemRecord::Shard, (uint8_t)(2 | (bFramed_ ? log_flag_crc : 0)) },
+        tlv_byte(LogTag::LogTagUint8, SizeTag::LogTagUint8),
+        u8Shard_,
+        tlv_byte(LogTag::LogTagUint8, SizeTag::LogTagUint8),
+        u8Count_,
+        0,
+        syncEnd,
+    };
+    auto uLen = sizeof(stRecord);
+    if (bFramed_) {
+        stRecord.crc = crc16_update(crc16_init, &stRecord.header, offsetof(decltype(stRecord), crc) - sizeof(uint16_t));
+    } else {
+        // Unframed: the end sync word takes the CRC's place
+        stRecord.crc = syncEnd;
+        uLen -= sizeof(uint16_t);
+    }
+
+    Append((const uint8_t*)&stRecord, uLen);
+    memmove(&m_pu8Capture[uOffset_ + uLen], &m_pu8Capture[uOffset_], m_uCaptureLen - uLen - uOffset_);
+    memcpy(&m_pu8Capture[uOffset_], &stRecord, uLen);
+}
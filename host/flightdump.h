@@ -0,0 +1,84 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file flightdump.h Recovery of records from a RAM dump of a target's flight recorder
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The FlightDump class
+ *
+ * Scans a raw dump of a target's RAM (or of just the region holding its log
+ * buffers, when built with LOGBUF_NOINIT) for valid flight recorder headers,
+ * and reassembles the records held in each shard's ring into a capture that
+ * can be decoded with LogStream.
+ *
+ * By default, only records that were committed but not yet flushed are
+ * recovered.  Optionally, the whole ring is recovered, from the oldest record
+ * that survives, which is useful when the target's logs weren't being
+ * captured at the time.
+ */
+class FlightDump {
+public:
+    /**
+     * @brief FlightDump
+     * @param szPath_ Path to the RAM dump
+     * @param bAll_ Recover the whole ring, rather than only unflushed records
+     */
+    FlightDump(const char* szPath_, bool bAll_);
+    ~FlightDump();
+
+    /**
+     * @brief Init
+     *
+     * Read the dump, and reassemble the records from each flight recorder
+     * found in it.
+     *
+     * @return true on success, false if the dump couldn't be read
+     */
+    bool Init();
+
+    /**
+     * @brief GetData
+     * @return Reassembled capture data
+     */
+    const uint8_t* GetData() const { return m_pu8Capture; }
+
+    /**
+     * @brief GetLength
+     * @return Length of the reassembled capture data
+     */
+    size_t GetLength() const { return m_uCaptureLen; }
+
+    /**
+     * @brief GetRecorders
+     * @return Number of valid flight recorders found in the dump
+     */
+    int GetRecorders() const { return m_iRecorders; }
+
+private:
+    void Append(const uint8_t* pu8Data_, size_t uLen_);
+    void InsertShardRecord(size_t uOffset_, uint8_t u8Shard_, uint8_t u8Count_, uint32_t u32Timestamp_, bool bFramed_);
+
+    const char* m_szPath;
+    bool        m_bAll;
+    uint8_t*    m_pu8Capture;
+    size_t      m_uCaptureLen;
+    size_t      m_uCaptureSize;
+    int         m_iRecorders;
+};
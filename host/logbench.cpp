@@ -0,0 +1,708 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logbench.cpp Decoder throughput benchmarks with golden-output checks
+
+  Usage: logbench [-n records] [-r repeats] [-F fixture_dir] [-g golden_dir] [-R]
+                  [-c inline.elf -C outlined.elf] [-o results.json] <logger.bin>
+
+  Generates synthetic captures of several site mixes from the dictionary, and
+  measures dictionary load time, and records/s and MB/s for the decode-only,
+  decode+format and filter-only paths (best of N runs).  Results are written as
+  JSON (to stdout, or the file given by -o), with a summary on stderr.
+
+  Every run first checks the decode+format output for each mix, generated from
+  the fixture dictionary (<fixture_dir>/logger.bin, built from test/fixture.cpp;
+  test/golden by default, relative to the host directory), line-by-line
+  against <fixture_dir>/<mix>.golden, so that performance work can't silently
+  change decoded output; a missing or mismatching golden file fails the run.
+  With -g, the output for the benchmarked dictionary is also compared against
+  <golden_dir>/<mix>.golden.  -R (re)records the golden files instead.
+  Captures are generated from a fixed seed, so golden files are stable for a
+  given dictionary and record count.
+
+  The damaged mixes also report how many of the records generated were
+  damaged, against the number lost, as counted by the decoder from gaps in
+  sequence numbers (for framed mixes, which add sequence numbers and CRCs to
+  each record, as LOGBUF_FRAMING), and the wire size of each record.
+
+  The target's LogCompressor is also measured on streams of representative
+  (and incompressible) argument values, flushed in blocks of the size the
+  target would flush by default: the compression ratio, compression cost in
+  cycles (TSC, where available) per byte, and decompression throughput are
+  reported, and the decompressed streams are checked against the originals.
+
+  With -c and -C, the code size of two builds of the same target (the first
+  built with LOGBUF_INLINE_SITES, the second without) is compared, and the
+  code and read-only data saved per DEBUG_LOG() site (as counted in the
+  dictionary) by outlining the record encoding is reported.
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "elfimage.h"
+#include "logcompress.h"
+#include "logdecoder.h"
+#include "logdecompress.h"
+#include "loggen.h"
+#include "loggerparser.h"
+#include "logstream.h"
+
+//---------------------------------------------------------------------------
+namespace {
+    constexpr auto maxResults = 64;
+    constexpr auto maxLineLength = 1024;
+
+    // Records per mix checked against the fixture's golden files
+    constexpr uint64_t fixtureRecords = 500;
+
+    //---------------------------------------------------------------------------
+    // Site mixes benchmarked: from every site equally busy, to a few very hot
+    // sites, plus damaged streams exercising resynchronization, and framed
+    // streams measuring the cost of validating sequence numbers and CRCs.
+    struct Mix {
+        const char* name;
+        double      zipf;
+        double      corrupt;
+        double      overwrite;
+        bool        framed;
+    };
+
+    const Mix astMixes[] = {
+        { "uniform",        0.0, 0.0,    0.0,  false },
+        { "zipf",           1.0, 0.0,    0.0,  false },
+        { "hot",            2.5, 0.0,    0.0,  false },
+        { "damaged",        1.0, 0.0005, 0.01, false },
+        { "framed",         1.0, 0.0,    0.0,  true  },
+        { "framed-damaged", 1.0, 0.0005, 0.01, true  },
+    };
+
+    //---------------------------------------------------------------------------
+    // Streams compressed: argument values from typical (small values and
+    // counters) to incompressible (uniformly-distributed 64-bit values).
+    struct Stream {
+        const char* name;
+        double      zipf;
+        GenValues   values;
+        bool        framed;
+    };
+
+    const Stream astStreams[] = {
+        { "small",          1.0, GenValues::Small,   false },
+        { "counter",        1.0, GenValues::Counter, false },
+        { "uniform",        1.0, GenValues::Uniform, false },
+        { "hot-small",      2.5, GenValues::Small,   false },
+        { "framed-small",   1.0, GenValues::Small,   true  },
+    };
+
+    // Data is compressed in flushes of the size at which the target requests
+    // a flush by default (half of its 512-byte ring).
+    constexpr size_t flushSize = 256;
+
+    //---------------------------------------------------------------------------
+    struct Capture {
+        uint8_t*    data;
+        size_t      length;
+        uint64_t    damaged;    //!< Number of records damaged by the generator
+    };
+
+    //---------------------------------------------------------------------------
+    // Records recovered from a capture, against those generated
+    struct Integrity {
+        uint64_t    generated;
+        uint64_t    damaged;
+        uint64_t    decoded;
+        uint64_t    lost;
+        uint64_t    crcErrors;
+        uint64_t    skipped;
+    };
+
+    //---------------------------------------------------------------------------
+    struct Result {
+        const char* mix;
+        const char* path;
+        uint64_t    records;
+        uint64_t    bytes;
+        double      seconds;
+    };
+
+    Result astResults[maxResults];
+    int iResults = 0;
+
+    //---------------------------------------------------------------------------
+    struct Compression {
+        uint64_t    raw;
+        uint64_t    compressed;
+        double      compressSeconds;
+        double      cyclesPerByte;      //!< Compression cost, or 0 if the TSC isn't available
+        double      decompressSeconds;
+        bool        match;              //!< Decompressed data matches the original
+    };
+
+    //---------------------------------------------------------------------------
+    double Now()
+    {
+        struct timespec stNow;
+        clock_gettime(CLOCK_MONOTONIC, &stNow);
+        return stNow.tv_sec + (stNow.tv_nsec / 1e9);
+    }
+
+    //---------------------------------------------------------------------------
+    uint64_t Cycles()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    //---------------------------------------------------------------------------
+    void Usage()
+    {
+        fprintf(stderr, "usage: logbench [-n records] [-r repeats] [-F fixture_dir] [-g golden_dir] [-R]\n"
+                        "                [-c inline.elf -C outlined.elf] [-o results.json] <logger.bin>\n");
+    }
+
+    //---------------------------------------------------------------------------
+    bool Generate(LoggerParser* pclDictionary_, const GenConfig& stConfig_, Capture* pstCapture_)
+    {
+        LogGenerator clGenerator(pclDictionary_, stConfig_);
+        if (!clGenerator.Init()) {
+            return false;
+        }
+
+        size_t uCapacity = 1024 * 1024;
+        pstCapture_->data = (uint8_t*)malloc(uCapacity);
+        pstCapture_->length = 0;
+        while (true) {
+            if ((pstCapture_->length + GEN_MAX_RECORD_SIZE) > uCapacity) {
+                uCapacity *= 2;
+                pstCapture_->data = (uint8_t*)realloc(pstCapture_->data, uCapacity);
+            }
+            auto uLen = clGenerator.Next(&pstCapture_->data[pstCapture_->length]);
+            if (!uLen) {
+                break;
+            }
+            pstCapture_->length += uLen;
+        }
+        pstCapture_->damaged = clGenerator.GetDamaged();
+        return true;
+    }
+
+    bool Generate(LoggerParser* pclDictionary_, const Mix& stMix_, uint64_t u64Records_, Capture* pstCapture_)
+    {
+        GenConfig stConfig;
+        stConfig.u64Records = u64Records_;
+        stConfig.dZipf = stMix_.zipf;
+        stConfig.dCorrupt = stMix_.corrupt;
+        stConfig.dOverwrite = stMix_.overwrite;
+        stConfig.bFramed = stMix_.framed;
+        stConfig.eValues = GenValues::Uniform;
+        stConfig.u64Seed = 0x4D61726B33ULL;
+        return Generate(pclDictionary_, stConfig, pstCapture_);
+    }
+
+    //---------------------------------------------------------------------------
+    // Compressed blocks are written to a preallocated buffer, as the target's
+    // log writer would to its debug link
+    Capture stCompressed;
+
+    void CompressedWriter(const uint8_t* pu8Data_, size_t uLength_)
+    {
+        memcpy(&stCompressed.data[stCompressed.length], pu8Data_, uLength_);
+        stCompressed.length += uLength_;
+    }
+
+    Compression Compress(const Capture& stCapture_, int iRepeats_)
+    {
+        // Incompressible data takes 9 bits per byte, plus block headers
+        stCompressed.data = (uint8_t*)malloc(stCapture_.length * 2);
+        Compression stResult = {};
+        for (auto i = 0; i < iRepeats_; i++) {
+            LogCompressor clCompressor;
+            stCompressed.length = 0;
+            auto dStart = Now();
+            auto u64Start = Cycles();
+            for (size_t uOffset = 0; uOffset < stCapture_.length; uOffset += flushSize) {
+                auto uLength = stCapture_.length - uOffset;
+                if (uLength > flushSize) {
+                    uLength = flushSize;
+                }
+                clCompressor.Write(CompressedWriter, &stCapture_.data[uOffset], uLength);
+                clCompressor.Flush(CompressedWriter);
+            }
+            auto u64Cycles = Cycles() - u64Start;
+            auto dElapsed = Now() - dStart;
+            if (!i || (dElapsed < stResult.compressSeconds)) {
+                stResult.compressSeconds = dElapsed;
+                stResult.cyclesPerByte = (double)u64Cycles / stCapture_.length;
+            }
+        }
+        stResult.raw = stCapture_.length;
+        stResult.compressed = stCompressed.length;
+
+        auto* pu8Out = (uint8_t*)malloc(stCapture_.length + COMPRESSED_BLOCK_MAX);
+        size_t uOut = 0;
+        for (auto i = 0; i < iRepeats_; i++) {
+            LogDecompressor clDecompressor;
+            size_t uConsumed;
+            auto dStart = Now();
+            uOut = clDecompressor.Decompress(stCompressed.data, stCompressed.length, &uConsumed, pu8Out,
+                                             stCapture_.length + COMPRESSED_BLOCK_MAX);
+            auto dElapsed = Now() - dStart;
+            if (!i || (dElapsed < stResult.decompressSeconds)) {
+                stResult.decompressSeconds = dElapsed;
+            }
+        }
+        stResult.match = (uOut == stCapture_.length) && !memcmp(pu8Out, stCapture_.data, uOut);
+        free(pu8Out);
+        free(stCompressed.data);
+        return stResult;
+    }
+
+    //---------------------------------------------------------------------------
+    Integrity CheckIntegrity(const Capture& stCapture_, uint64_t u64Generated_)
+    {
+        LogStream clStream(stCapture_.data, stCapture_.length);
+        LogRecord stRecord;
+        Integrity stIntegrity = {};
+        while (clStream.Next(&stRecord)) {
+            stIntegrity.decoded++;
+        }
+        stIntegrity.generated = u64Generated_;
+        stIntegrity.damaged = stCapture_.damaged;
+        stIntegrity.lost = clStream.GetLostRecords();
+        stIntegrity.crcErrors = clStream.GetCrcErrors();
+        stIntegrity.skipped = clStream.GetSkippedBytes();
+        return stIntegrity;
+    }
+
+    //---------------------------------------------------------------------------
+    // Each path returns the number of records it processed; the sink value
+    // keeps the compiler from optimizing the work away.
+    volatile uint64_t u64Sink;
+
+    uint64_t DecodeOnly(LoggerParser*, const Capture& stCapture_)
+    {
+        LogStream clStream(stCapture_.data, stCapture_.length);
+        LogRecord stRecord;
+        uint64_t u64Records = 0;
+        uint64_t u64Sum = 0;
+        while (clStream.Next(&stRecord)) {
+            LogArgReader clReader(stRecord);
+            LogArg stArg;
+            while (clReader.Next(&stArg)) {
+                u64Sum += stArg.AsUnsigned();
+            }
+            u64Records++;
+        }
+        u64Sink = u64Sum;
+        return u64Records;
+    }
+
+    uint64_t DecodeFormat(LoggerParser* pclDictionary_, const Capture& stCapture_)
+    {
+        LogStream clStream(stCapture_.data, stCapture_.length);
+        LogDecoder clDecoder(pclDictionary_, &clStream.GetClock());
+        LogRecord stRecord;
+        char szLine[maxLineLength];
+        uint64_t u64Records = 0;
+        uint64_t u64Chars = 0;
+        while (clStream.Next(&stRecord)) {
+            u64Chars += clDecoder.Render(szLine, sizeof(szLine), stRecord);
+            u64Records++;
+        }
+        u64Sink = u64Chars;
+        return u64Records;
+    }
+
+    uint64_t FilterOnly(LoggerParser*, const Capture& stCapture_)
+    {
+        // Select every record from the file of the first record in the capture
+        LogStream clStream(stCapture_.data, stCapture_.length);
+        LogRecord stRecord;
+        uint64_t u64Records = 0;
+        uint64_t u64Matches = 0;
+        uint32_t u32File = 0;
+        while (clStream.Next(&stRecord)) {
+            if (!u64Records++) {
+                u32File = stRecord.header.file_id;
+            }
+            u64Matches += (stRecord.header.file_id == u32File);
+        }
+        u64Sink = u64Matches;
+        return u64Records;
+    }
+
+    //---------------------------------------------------------------------------
+    // Size of the code and read-only data of one build of the target
+    struct ImageSize {
+        uint64_t    code;
+        uint64_t    rodata;
+    };
+
+    bool ReadImageSize(const char* szPath_, ImageSize* pstSize_)
+    {
+        ElfImage clImage(szPath_);
+        if (!clImage.Init()) {
+            fprintf(stderr, "error opening %s\n", szPath_);
+            return false;
+        }
+        pstSize_->code = clImage.GetCodeSize();
+        pstSize_->rodata = clImage.GetConstSize();
+        return true;
+    }
+
+    //---------------------------------------------------------------------------
+    using BenchPath_t = uint64_t (*)(LoggerParser* pclDictionary_, const Capture& stCapture_);
+
+    void Run(const char* szMix_, const char* szPath_, BenchPath_t pfPath_, int iRepeats_,
+             LoggerParser* pclDictionary_, const Capture& stCapture_)
+    {
+        auto dBest = 0.0;
+        uint64_t u64Records = 0;
+        for (auto i = 0; i < iRepeats_; i++) {
+            auto dStart = Now();
+            u64Records = pfPath_(pclDictionary_, stCapture_);
+            auto dElapsed = Now() - dStart;
+            if (!i || (dElapsed < dBest)) {
+                dBest = dElapsed;
+            }
+        }
+        if (iResults < maxResults) {
+            astResults[iResults++] = { szMix_, szPath_, u64Records, stCapture_.length, dBest };
+        }
+        fprintf(stderr, "  %-14s %-14s %10llu records %10.0f records/s %8.1f MB/s\n",
+                szMix_, szPath_, (unsigned long long)u64Records,
+                u64Records / dBest, (stCapture_.length / 1e6) / dBest);
+    }
+
+    //---------------------------------------------------------------------------
+    // Golden files hold one record per line, so control characters rendered
+    // from arguments (i.e. a %c of a newline) are escaped.
+    void Escape(const char* szIn_, char* szOut_)
+    {
+        for (; *szIn_; szIn_++) {
+            auto u8Char = (uint8_t)*szIn_;
+            if ((u8Char < 0x20) || (u8Char == 0x7F)) {
+                szOut_ += sprintf(szOut_, "\\x%02x", u8Char);
+            } else {
+                *szOut_++ = (char)u8Char;
+            }
+        }
+        *szOut_ = '\0';
+    }
+
+    //---------------------------------------------------------------------------
+    // Compare (or record) decode+format output against a golden file.  Returns
+    // 0 on a match, the (1-based) first mismatching line otherwise, or -1 if
+    // the golden file couldn't be read/written.
+    long CheckGolden(const char* szDir_, const char* szMix_, bool bRecord_,
+                     LoggerParser* pclDictionary_, const Capture& stCapture_)
+    {
+        char szPath[512];
+        snprintf(szPath, sizeof(szPath), "%s/%s.golden", szDir_, szMix_);
+        auto* pstFile = fopen(szPath, bRecord_ ? "w" : "r");
+        if (!pstFile) {
+            return -1;
+        }
+
+        LogStream clStream(stCapture_.data, stCapture_.length);
+        LogDecoder clDecoder(pclDictionary_, &clStream.GetClock());
+        LogRecord stRecord;
+        char szLine[maxLineLength + 1];
+        char szEscaped[(maxLineLength * 4) + 1];
+        char szGolden[(maxLineLength * 4) + 2];
+        long lLine = 0;
+        long lRc = 0;
+        while (clStream.Next(&stRecord)) {
+            lLine++;
+            clDecoder.Render(szLine, maxLineLength, stRecord);
+            Escape(szLine, szEscaped);
+            if (bRecord_) {
+                fprintf(pstFile, "%s\n", szEscaped);
+                continue;
+            }
+            if (!fgets(szGolden, sizeof(szGolden), pstFile)) {
+                lRc = lLine;
+                break;
+            }
+            szGolden[strcspn(szGolden, "\n")] = '\0';
+            if (strcmp(szEscaped, szGolden)) {
+                lRc = lLine;
+                break;
+            }
+        }
+        // Golden output with extra lines is also a mismatch
+        if (!bRecord_ && !lRc && fgets(szGolden, sizeof(szGolden), pstFile)) {
+            lRc = lLine + 1;
+        }
+        fclose(pstFile);
+        return lRc;
+    }
+
+    //---------------------------------------------------------------------------
+    // Check (or record) the golden files of every mix against the fixture
+    // dictionary, returning false if any failed.
+    bool CheckFixture(const char* szDir_, bool bRecord_, long* alGolden_)
+    {
+        char szPath[512];
+        snprintf(szPath, sizeof(szPath), "%s/logger.bin", szDir_);
+        LoggerParser clDictionary(szPath);
+        if (!clDictionary.Init()) {
+            fprintf(stderr, "error opening fixture %s (see -F)\n", szPath);
+            return false;
+        }
+        clDictionary.Parse();
+
+        auto bOk = true;
+        for (size_t i = 0; i < (sizeof(astMixes) / sizeof(astMixes[0])); i++) {
+            auto& stMix = astMixes[i];
+            Capture stCapture;
+            if (!Generate(&clDictionary, stMix, fixtureRecords, &stCapture)) {
+                fprintf(stderr, "no log sites found in %s\n", szPath);
+                return false;
+            }
+            alGolden_[i] = CheckGolden(szDir_, stMix.name, bRecord_, &clDictionary, stCapture);
+            if (alGolden_[i]) {
+                bOk = false;
+                fprintf(stderr, "  %-14s fixture golden: %s (line %ld)\n", stMix.name,
+                        (alGolden_[i] < 0) ? "missing" : "MISMATCH", alGolden_[i]);
+            }
+            free(stCapture.data);
+        }
+        fprintf(stderr, "fixture: %s, golden output %s\n", szDir_, bOk ? (bRecord_ ? "recorded" : "matches") : "FAILED");
+        return bOk;
+    }
+
+    //---------------------------------------------------------------------------
+    void PrintGolden(FILE* pstOut_, const char* szName_, bool bRecord_, const long* alGolden_)
+    {
+        fprintf(pstOut_, ",\n  \"%s\": [\n", szName_);
+        for (size_t i = 0; i < (sizeof(astMixes) / sizeof(astMixes[0])); i++) {
+            fprintf(pstOut_, "    { \"mix\": \"%s\", \"status\": \"%s\", \"line\": %ld }%s\n",
+                    astMixes[i].name,
+                    bRecord_ ? (alGolden_[i] ? "error" : "recorded")
+                             : (!alGolden_[i] ? "pass" : ((alGolden_[i] < 0) ? "missing" : "fail")),
+                    alGolden_[i],
+                    (i + 1 < (sizeof(astMixes) / sizeof(astMixes[0]))) ? "," : "");
+        }
+        fprintf(pstOut_, "  ]");
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    uint64_t u64Records = 200000;
+    auto iRepeats = 3;
+    const char* szGolden = nullptr;
+    const char* szFixture = "test/golden";
+    const char* szOutput = nullptr;
+    const char* szInlineImage = nullptr;
+    const char* szOutlinedImage = nullptr;
+    auto bRecord = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:F:g:Rc:C:o:")) != -1) {
+        switch (opt) {
+            case 'n': u64Records = strtoull(optarg, nullptr, 0); break;
+            case 'r': iRepeats = atoi(optarg); break;
+            case 'F': szFixture = optarg; break;
+            case 'g': szGolden = optarg; break;
+            case 'R': bRecord = true; break;
+            case 'c': szInlineImage = optarg; break;
+            case 'C': szOutlinedImage = optarg; break;
+            case 'o': szOutput = optarg; break;
+            default: Usage(); return -1;
+        }
+    }
+    if (((argc - optind) != 1) || (iRepeats < 1) || (!szInlineImage != !szOutlinedImage)) {
+        Usage();
+        return -1;
+    }
+    auto* szDictionary = argv[optind];
+
+    long alFixture[sizeof(astMixes) / sizeof(astMixes[0])] = {};
+    auto bFailed = !CheckFixture(szFixture, bRecord, alFixture);
+
+    // Dictionary load time, best of N
+    auto dLoad = 0.0;
+    for (auto i = 0; i < iRepeats; i++) {
+        auto dStart = Now();
+        LoggerParser clDictionary(szDictionary);
+        if (!clDictionary.Init()) {
+            fprintf(stderr, "error opening %s\n", szDictionary);
+            return -1;
+        }
+        clDictionary.Parse();
+        // Lookups are indexed lazily, so include building the index
+        clDictionary.FindLogLine(0, 0);
+        auto dElapsed = Now() - dStart;
+        if (!i || (dElapsed < dLoad)) {
+            dLoad = dElapsed;
+        }
+    }
+
+    LoggerParser clDictionary(szDictionary);
+    clDictionary.Init();
+    clDictionary.Parse();
+    fprintf(stderr, "dictionary: %s, loaded in %.3f ms\n", szDictionary, dLoad * 1e3);
+
+    // Code size saved per site by outlining the record encoding
+    ImageSize stInline = {};
+    ImageSize stOutlined = {};
+    auto iSites = 0;
+    auto dSavedPerSite = 0.0;
+    if (szInlineImage) {
+        if (!ReadImageSize(szInlineImage, &stInline) || !ReadImageSize(szOutlinedImage, &stOutlined)) {
+            return -1;
+        }
+        for (auto* pclLine = clDictionary.GetLogLines(); pclLine; pclLine = static_cast<LogLine*>(pclLine->GetNext())) {
+            iSites++;
+        }
+        if (iSites) {
+            dSavedPerSite = ((double)(stInline.code + stInline.rodata) - (double)(stOutlined.code + stOutlined.rodata)) / iSites;
+        }
+        fprintf(stderr, "code size: inline %llu+%llu bytes, outlined %llu+%llu bytes (code+rodata), %d sites, %.1f bytes/site saved\n",
+                (unsigned long long)stInline.code, (unsigned long long)stInline.rodata,
+                (unsigned long long)stOutlined.code, (unsigned long long)stOutlined.rodata, iSites, dSavedPerSite);
+    }
+
+    auto* pstOut = szOutput ? fopen(szOutput, "w") : stdout;
+    if (!pstOut) {
+        fprintf(stderr, "error opening %s\n", szOutput);
+        return -1;
+    }
+
+    long alGolden[sizeof(astMixes) / sizeof(astMixes[0])] = {};
+    Integrity astIntegrity[sizeof(astMixes) / sizeof(astMixes[0])] = {};
+    for (size_t i = 0; i < (sizeof(astMixes) / sizeof(astMixes[0])); i++) {
+        auto& stMix = astMixes[i];
+        Capture stCapture;
+        if (!Generate(&clDictionary, stMix, u64Records, &stCapture)) {
+            fprintf(stderr, "no log sites found in %s\n", szDictionary);
+            return -1;
+        }
+        Run(stMix.name, "decode", DecodeOnly, iRepeats, &clDictionary, stCapture);
+        Run(stMix.name, "decode+format", DecodeFormat, iRepeats, &clDictionary, stCapture);
+        Run(stMix.name, "filter", FilterOnly, iRepeats, &clDictionary, stCapture);
+
+        auto& stIntegrity = astIntegrity[i];
+        stIntegrity = CheckIntegrity(stCapture, u64Records);
+        fprintf(stderr, "  %-14s %.1f bytes/record, %llu damaged, %llu lost, %llu crc errors, %llu bytes skipped\n",
+                stMix.name, (double)stCapture.length / u64Records,
+                (unsigned long long)stIntegrity.damaged, (unsigned long long)stIntegrity.lost,
+                (unsigned long long)stIntegrity.crcErrors, (unsigned long long)stIntegrity.skipped);
+
+        if (szGolden) {
+            alGolden[i] = CheckGolden(szGolden, stMix.name, bRecord, &clDictionary, stCapture);
+            if (alGolden[i]) {
+                bFailed = true;
+                fprintf(stderr, "  %-14s golden: %s (line %ld)\n", stMix.name,
+                        (alGolden[i] < 0) ? "missing" : "MISMATCH", alGolden[i]);
+            }
+        }
+        free(stCapture.data);
+    }
+
+    Compression astCompression[sizeof(astStreams) / sizeof(astStreams[0])] = {};
+    for (size_t i = 0; i < (sizeof(astStreams) / sizeof(astStreams[0])); i++) {
+        auto& stStream = astStreams[i];
+        GenConfig stConfig;
+        stConfig.u64Records = u64Records;
+        stConfig.dZipf = stStream.zipf;
+        stConfig.eValues = stStream.values;
+        stConfig.bFramed = stStream.framed;
+        stConfig.u64Seed = 0x4D61726B33ULL;
+        Capture stCapture;
+        if (!Generate(&clDictionary, stConfig, &stCapture)) {
+            fprintf(stderr, "no log sites found in %s\n", szDictionary);
+            return -1;
+        }
+        auto& stResult = astCompression[i];
+        stResult = Compress(stCapture, iRepeats);
+        fprintf(stderr, "  %-14s compress       %5.2f:1 %6.1f cycles/byte %8.1f MB/s, decompress %8.1f MB/s%s\n",
+                stStream.name, (double)stResult.raw / stResult.compressed, stResult.cyclesPerByte,
+                (stResult.raw / 1e6) / stResult.compressSeconds, (stResult.raw / 1e6) / stResult.decompressSeconds,
+                stResult.match ? "" : ", MISMATCH");
+        if (!stResult.match) {
+            bFailed = true;
+        }
+        free(stCapture.data);
+    }
+
+    fprintf(pstOut, "{\n  \"dictionary\": { \"path\": \"%s\", \"load_ms\": %.3f },\n", szDictionary, dLoad * 1e3);
+    if (szInlineImage) {
+        fprintf(pstOut, "  \"code_size\": { \"sites\": %d, "
+                        "\"inline\": { \"code\": %llu, \"rodata\": %llu }, "
+                        "\"outlined\": { \"code\": %llu, \"rodata\": %llu }, "
+                        "\"saved_per_site\": %.1f },\n",
+                iSites,
+                (unsigned long long)stInline.code, (unsigned long long)stInline.rodata,
+                (unsigned long long)stOutlined.code, (unsigned long long)stOutlined.rodata, dSavedPerSite);
+    }
+    fprintf(pstOut, "  \"results\": [\n");
+    for (auto i = 0; i < iResults; i++) {
+        auto& stResult = astResults[i];
+        fprintf(pstOut, "    { \"mix\": \"%s\", \"path\": \"%s\", \"records\": %llu, \"bytes\": %llu, "
+                        "\"seconds\": %.6f, \"records_per_s\": %.0f, \"mb_per_s\": %.2f }%s\n",
+                stResult.mix, stResult.path,
+                (unsigned long long)stResult.records, (unsigned long long)stResult.bytes,
+                stResult.seconds, stResult.records / stResult.seconds, (stResult.bytes / 1e6) / stResult.seconds,
+                (i + 1 < iResults) ? "," : "");
+    }
+    fprintf(pstOut, "  ],\n  \"integrity\": [\n");
+    for (size_t i = 0; i < (sizeof(astMixes) / sizeof(astMixes[0])); i++) {
+        auto& stIntegrity = astIntegrity[i];
+        fprintf(pstOut, "    { \"mix\": \"%s\", \"framed\": %s, \"generated\": %llu, \"damaged\": %llu, "
+                        "\"decoded\": %llu, \"lost\": %llu, \"crc_errors\": %llu, \"skipped_bytes\": %llu }%s\n",
+                astMixes[i].name, astMixes[i].framed ? "true" : "false",
+                (unsigned long long)stIntegrity.generated, (unsigned long long)stIntegrity.damaged,
+                (unsigned long long)stIntegrity.decoded, (unsigned long long)stIntegrity.lost,
+                (unsigned long long)stIntegrity.crcErrors, (unsigned long long)stIntegrity.skipped,
+                (i + 1 < (sizeof(astMixes) / sizeof(astMixes[0]))) ? "," : "");
+    }
+    fprintf(pstOut, "  ],\n  \"compression\": [\n");
+    for (size_t i = 0; i < (sizeof(astStreams) / sizeof(astStreams[0])); i++) {
+        auto& stResult = astCompression[i];
+        fprintf(pstOut, "    { \"stream\": \"%s\", \"raw_bytes\": %llu, \"compressed_bytes\": %llu, \"ratio\": %.3f, "
+                        "\"cycles_per_byte\": %.1f, \"compress_mb_per_s\": %.2f, \"decompress_mb_per_s\": %.2f, "
+                        "\"match\": %s }%s\n",
+                astStreams[i].name, (unsigned long long)stResult.raw, (unsigned long long)stResult.compressed,
+                (double)stResult.raw / stResult.compressed, stResult.cyclesPerByte,
+                (stResult.raw / 1e6) / stResult.compressSeconds, (stResult.raw / 1e6) / stResult.decompressSeconds,
+                stResult.match ? "true" : "false",
+                (i + 1 < (sizeof(astStreams) / sizeof(astStreams[0]))) ? "," : "");
+    }
+    fprintf(pstOut, "  ]");
+    PrintGolden(pstOut, "fixture", bRecord, alFixture);
+    if (szGolden) {
+        PrintGolden(pstOut, "golden", bRecord, alGolden);
+    }
+    fprintf(pstOut, "\n}\n");
+    if (pstOut != stdout) {
+        fclose(pstOut);
+    }
+    return bFailed ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logdecoder.cpp Render records from a capture as human-readable text
+ */
+#include "logdecoder.h"
+#include "logformat.h"
+#include "metricseries.h"
+#include "sitestats.h"
+#include "textbuf.h"
+
+#include <stdio.h>
+#include <time.h>
+
+//---------------------------------------------------------------------------
+size_t LogDecoder::Render(char* szOut_, size_t uLen_, const LogRecord& stRecord_)
+{
+    if (!uLen_) {
+        return 0;
+    }
+    szOut_[0] = '\0';
+
+    auto& header = stRecord_.header;
+    size_t uOut = 0;
+
+    Append(szOut_, uLen_, &uOut, "%llu ", (unsigned long long)stRecord_.timestamp);
+    if (m_pclClock && m_pclClock->IsSynced()) {
+        auto i64EpochUs = m_pclClock->ToEpochUs(stRecord_.timestamp);
+        auto tSeconds = (time_t)(i64EpochUs / 1000000);
+        struct tm stTime;
+        char szTime[32];
+        gmtime_r(&tSeconds, &stTime);
+        strftime(szTime, sizeof(szTime), "%Y-%m-%dT%H:%M:%S", &stTime);
+        Append(szOut_, uLen_, &uOut, "%s.%06uZ ", szTime, (unsigned)(i64EpochUs % 1000000));
+    }
+
+    if (header.file_id == system_file_id) {
+        Append(szOut_, uLen_, &uOut, "<%s>", LogSystemRecordName(header.line));
+        LogArgReader clArgs(stRecord_);
+        LogArg stArg;
+        if ((header.line == (uint16_t)LogSystemRecord::Repeat) && clArgs.Next(&stArg)) {
+            Append(szOut_, uLen_, &uOut, " previous record repeated %llu times", (unsigned long long)stArg.AsUnsigned());
+        }
+        if (((header.line == (uint16_t)LogSystemRecord::ScopeBegin) || (header.line == (uint16_t)LogSystemRecord::ScopeEnd))
+            && clArgs.Next(&stArg)) {
+            auto* szScope = m_pclDictionary ? m_pclDictionary->FindScope((uint32_t)stArg.AsUnsigned()) : nullptr;
+            if (szScope) {
+                Append(szOut_, uLen_, &uOut, " %s", szScope);
+            } else {
+                Append(szOut_, uLen_, &uOut, " %08x", (uint32_t)stArg.AsUnsigned());
+            }
+        }
+        if ((header.line == (uint16_t)LogSystemRecord::SiteFilter) && clArgs.Next(&stArg)) {
+            static const char* const aszCommands[] = { "?", "enable", "disable", "enable-all", "disable-all" };
+            auto u64Command = stArg.AsUnsigned();
+            Append(szOut_, uLen_, &uOut, " %s", aszCommands[(u64Command <= (uint64_t)LogCommand::DisableAll) ? u64Command : 0]);
+            if (clArgs.Next(&stArg)) {
+                Append(szOut_, uLen_, &uOut, " changed %llu sites", (unsigned long long)stArg.AsUnsigned());
+            }
+        }
+        TargetStats stTarget;
+        if (DecodeTargetStats(stRecord_, &stTarget)) {
+            Append(szOut_, uLen_, &uOut, " records=%u/%u bytes=%u/%u overruns=%u high-water=%u", stTarget.recordsFlushed,
+                   stTarget.records, stTarget.bytesFlushed, stTarget.bytes, stTarget.overruns, stTarget.highWater);
+            Append(szOut_, uLen_, &uOut, " lock=%.2f/%.2fus flush=%.2f/%.2fus", stTarget.ToUs(stTarget.lockMax),
+                   stTarget.ToUs(stTarget.lockMean), stTarget.ToUs(stTarget.flushMax), stTarget.ToUs(stTarget.flushMean));
+        }
+        MetricSummary stMetric;
+        if (DecodeMetric(stRecord_, &stMetric)) {
+            auto* pstInfo = m_pclDictionary ? m_pclDictionary->FindMetric(stMetric.id) : nullptr;
+            if (pstInfo) {
+                Append(szOut_, uLen_, &uOut, " %s", pstInfo->name.c_str());
+            } else {
+                Append(szOut_, uLen_, &uOut, " %08x", stMetric.id);
+            }
+            if (stMetric.type == LogSectionType::Counter) {
+                Append(szOut_, uLen_, &uOut, " count=%u", stMetric.count);
+            } else if (stMetric.type == LogSectionType::Gauge) {
+                Append(szOut_, uLen_, &uOut, " last=%d min=%d max=%d", stMetric.last, stMetric.min, stMetric.max);
+            } else {
+                for (size_t i = 0; i < stMetric.buckets.size(); i++) {
+                    if (pstInfo && (i < pstInfo->bounds.size())) {
+                        Append(szOut_, uLen_, &uOut, " <=%u:%u", pstInfo->bounds[i], stMetric.buckets[i]);
+                    } else if (pstInfo && i) {
+                        Append(szOut_, uLen_, &uOut, " >%u:%u", pstInfo->bounds[i - 1], stMetric.buckets[i]);
+                    } else {
+                        Append(szOut_, uLen_, &uOut, " %u", stMetric.buckets[i]);
+                    }
+                }
+            }
+        }
+        return uOut;
+    }
+
+    auto* pclFile = m_pclDictionary ? m_pclDictionary->FindFile(header.file_id) : nullptr;
+    if (pclFile) {
+        Append(szOut_, uLen_, &uOut, "%s:%u ", pclFile->filename, header.line);
+    } else {
+        Append(szOut_, uLen_, &uOut, "%08x:%u ", header.file_id, header.line);
+    }
+
+    auto* pclLine = m_pclDictionary ? m_pclDictionary->FindLogLine(header.file_id, header.line) : nullptr;
+    if (pclLine && (uOut < uLen_)) {
+        uOut += LogFormatter::Format(&szOut_[uOut], uLen_ - uOut, pclLine->m_szFormatString, stRecord_, m_pclImage);
+    }
+
+    // Lines are terminated by the caller
+    while (uOut && (szOut_[uOut - 1] == '\n' || szOut_[uOut - 1] == '\r')) {
+        szOut_[--uOut] = '\0';
+    }
+    if (stRecord_.suppressed) {
+        Append(szOut_, uLen_, &uOut, " [%u suppressed]", stRecord_.suppressed);
+    }
+    return uOut;
+}
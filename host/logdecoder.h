@@ -0,0 +1,66 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logdecoder.h Render records from a capture as human-readable text
+ */
+#pragma once
+
+#include "elfimage.h"
+#include "loggerparser.h"
+#include "logstream.h"
+#include "tickclock.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogDecoder class
+ *
+ * Renders records as single lines of text, of the form:
+ *
+ *  <ticks> [<wall-clock time>] <file>:<line> <formatted message>
+ *
+ * Where the wall-clock time is only present once the capture's clock has been
+ * synchronized by a clock-sync record.
+ */
+class LogDecoder {
+public:
+    /**
+     * @brief LogDecoder
+     * @param pclDictionary_ Parsed .logger dictionary used to resolve sites
+     * @param pclClock_ Clock used to convert record timestamps to wall-clock time
+     * @param pclImage_ Target image used to resolve constant strings and symbolize pointers, or nullptr
+     */
+    LogDecoder(LoggerParser* pclDictionary_, const TickClock* pclClock_, const ElfImage* pclImage_ = nullptr)
+    : m_pclDictionary{pclDictionary_}
+    , m_pclClock{pclClock_}
+    , m_pclImage{pclImage_}
+    {}
+
+    /**
+     * @brief Render
+     *
+     * @param szOut_ Buffer to write the resulting line to (without a newline)
+     * @param uLen_ Size of the output buffer
+     * @param stRecord_ Record to render
+     * @return Number of characters written (excluding the terminating nul)
+     */
+    size_t Render(char* szOut_, size_t uLen_, const LogRecord& stRecord_);
+
+private:
+    LoggerParser*       m_pclDictionary;
+    const TickClock*    m_pclClock;
+    const ElfImage*     m_pclImage;
+};
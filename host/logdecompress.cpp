@@ -0,0 +1,189 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logdecompress.cpp Streaming decompressor for captures written through a LogCompressor
+ */
+#include "logdecompress.h"
+
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    //---------------------------------------------------------------------------
+    // Reject headers that no compressor could have written, so that a sync word
+    // found within other data isn't mistaken for a block.
+    bool HeaderValid(const LogCompressedHeader_t& stHeader_)
+    {
+        auto iWindowBits = stHeader_.params >> 4;
+        auto iLengthBits = stHeader_.params & 0x0F;
+        if ((iWindowBits < 4) || (iLengthBits < 1) || (iLengthBits > 8) || (stHeader_.flags & ~compressed_flag_keyframe)
+            || !stHeader_.raw_length) {
+            return false;
+        }
+        // Literals take 9 bits per byte; matches at least 1 + window + length
+        // bits per match.
+        auto u64MaxLength = ((stHeader_.raw_length * 9ULL) + 7) / 8;
+        auto u64MaxRaw = ((stHeader_.length * 8ULL) / (1 + iWindowBits + iLengthBits)) * (compressed_min_match + (1 << iLengthBits) - 1)
+                         + ((stHeader_.length * 8ULL) / 9);
+        return (stHeader_.length <= u64MaxLength) && (stHeader_.raw_length <= u64MaxRaw);
+    }
+
+    //---------------------------------------------------------------------------
+    // MSB-first reader over a block's bitstream
+    class BitReader {
+    public:
+        BitReader(const uint8_t* pu8Data_, size_t uLen_)
+        : m_pu8Data{pu8Data_}
+        , m_uRemaining{uLen_}
+        , m_u32Bits{0}
+        , m_iBits{0}
+        {}
+
+        bool Read(int iCount_, uint32_t* pu32Value_)
+        {
+            while (m_iBits < iCount_) {
+                if (!m_uRemaining) {
+                    return false;
+                }
+                m_u32Bits = (m_u32Bits << 8) | *m_pu8Data++;
+                m_uRemaining--;
+                m_iBits += 8;
+            }
+            m_iBits -= iCount_;
+            *pu32Value_ = (m_u32Bits >> m_iBits) & ((1u << iCount_) - 1);
+            return true;
+        }
+
+    private:
+        const uint8_t*  m_pu8Data;
+        size_t          m_uRemaining;
+        uint32_t        m_u32Bits;
+        int             m_iBits;
+    };
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+LogDecompressor::LogDecompressor()
+: m_u32WindowPos{0}
+, m_u8Params{0}
+, m_u8NextSequence{0}
+, m_bSynced{false}
+, m_u64Blocks{0}
+, m_u64Dropped{0}
+, m_u64Skipped{0}
+, m_u64Compressed{0}
+, m_u64Raw{0}
+{}
+
+//---------------------------------------------------------------------------
+size_t LogDecompressor::Decompress(const uint8_t* pu8In_, size_t uInLen_, size_t* puConsumed_, uint8_t* pu8Out_,
+                                   size_t uOutLen_)
+{
+    size_t uIn = 0;
+    size_t uOut = 0;
+    while ((uInLen_ - uIn) >= sizeof(LogCompressedHeader_t)) {
+        LogCompressedHeader_t stHeader;
+        memcpy(&stHeader, &pu8In_[uIn], sizeof(stHeader));
+        if ((stHeader.sync != compressed_block_sync) || !HeaderValid(stHeader)) {
+            // Skip to the next candidate sync word
+            auto* pu8Start = &pu8In_[uIn + 1];
+            auto* pu8Sync = (const uint8_t*)memchr(pu8Start, compressed_block_sync & 0xFF, uInLen_ - (uIn + 1));
+            auto skip = 1 + (pu8Sync ? (pu8Sync - pu8Start) : (uInLen_ - (uIn + 1)));
+            m_u64Skipped += skip;
+            uIn += skip;
+            continue;
+        }
+
+        auto uBlock = sizeof(stHeader) + stHeader.length;
+        if (((uInLen_ - uIn) < uBlock) || ((uOutLen_ - uOut) < stHeader.raw_length)) {
+            break;
+        }
+
+        // A block refers to the data decoded from those before it, back to the
+        // last keyframe, so can only be decoded if none of those were lost.
+        auto bKeyframe = (stHeader.flags & compressed_flag_keyframe) != 0;
+        if (!bKeyframe && (!m_bSynced || (stHeader.sequence != m_u8NextSequence) || (stHeader.params != m_u8Params))) {
+            m_bSynced = false;
+            m_u64Dropped++;
+            uIn += uBlock;
+            continue;
+        }
+        if (bKeyframe) {
+            memset(m_au8Window, 0, sizeof(m_au8Window));
+            m_u8Params = stHeader.params;
+        }
+        if (!DecodeBlock(stHeader, &pu8In_[uIn + sizeof(stHeader)], &pu8Out_[uOut])) {
+            // Not a block after all, or a corrupt one: the window can't be
+            // trusted until the next keyframe.
+            m_bSynced = false;
+            m_u64Dropped++;
+            m_u64Skipped++;
+            uIn++;
+            continue;
+        }
+        m_bSynced = true;
+        m_u8NextSequence = stHeader.sequence + 1;
+        m_u64Blocks++;
+        m_u64Compressed += uBlock;
+        m_u64Raw += stHeader.raw_length;
+        uIn += uBlock;
+        uOut += stHeader.raw_length;
+    }
+    *puConsumed_ = uIn;
+    return uOut;
+}
+
+//---------------------------------------------------------------------------
+bool LogDecompressor::DecodeBlock(const LogCompressedHeader_t& stHeader_, const uint8_t* pu8Data_, uint8_t* pu8Out_)
+{
+    auto iWindowBits = stHeader_.params >> 4;
+    auto iLengthBits = stHeader_.params & 0x0F;
+    auto u32Mask = (1u << iWindowBits) - 1;
+    BitReader clReader(pu8Data_, stHeader_.length);
+
+    auto u32Out = 0u;
+    while (u32Out < stHeader_.raw_length) {
+        uint32_t u32Literal;
+        if (!clReader.Read(1, &u32Literal)) {
+            return false;
+        }
+        if (u32Literal) {
+            uint32_t u32Byte;
+            if (!clReader.Read(8, &u32Byte)) {
+                return false;
+            }
+            pu8Out_[u32Out++] = (uint8_t)u32Byte;
+            m_au8Window[m_u32WindowPos++ & u32Mask] = (uint8_t)u32Byte;
+            continue;
+        }
+
+        uint32_t u32Distance;
+        uint32_t u32Length;
+        if (!clReader.Read(iWindowBits, &u32Distance) || !clReader.Read(iLengthBits, &u32Length)) {
+            return false;
+        }
+        u32Distance++;
+        u32Length += compressed_min_match;
+        if ((u32Out + u32Length) > stHeader_.raw_length) {
+            return false;
+        }
+        // Byte-by-byte, as a match may overlap the data it produces
+        for (auto i = 0u; i < u32Length; i++) {
+            auto u8Byte = m_au8Window[(m_u32WindowPos - u32Distance) & u32Mask];
+            pu8Out_[u32Out++] = u8Byte;
+            m_au8Window[m_u32WindowPos++ & u32Mask] = u8Byte;
+        }
+    }
+    return true;
+}
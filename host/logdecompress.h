@@ -0,0 +1,88 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logdecompress.h Streaming decompressor for captures written through a LogCompressor
+ */
+#pragma once
+
+#include "logtypes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+// Largest block accepted, with its header: a bound on both the compressed
+// data buffered ahead of a block, and on the output space it requires.
+constexpr size_t COMPRESSED_BLOCK_MAX = sizeof(LogCompressedHeader_t) + UINT16_MAX;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogDecompressor class
+ *
+ * Decodes the blocks written by the target's LogCompressor back into the
+ * original stream of records.  Blocks are found by their sync word, so data
+ * between blocks is skipped; a block that can't be decoded (i.e. following a
+ * dropped block, or when attaching to a running target) is discarded, along
+ * with all blocks until the next keyframe.
+ */
+class LogDecompressor {
+public:
+    LogDecompressor();
+
+    /**
+     * @brief Decompress
+     *
+     * Decode as many complete blocks as are available from a buffer of
+     * compressed data, and fit in the output buffer.
+     *
+     * @param pu8In_ Compressed data
+     * @param uInLen_ Number of bytes of compressed data
+     * @param puConsumed_ [out] Number of bytes of compressed data consumed; the
+     *        rest (i.e. a partial block) must be presented again, followed by
+     *        more data
+     * @param pu8Out_ Buffer for the decompressed data
+     * @param uOutLen_ Size of the output buffer
+     * @return Number of bytes of decompressed data written
+     */
+    size_t Decompress(const uint8_t* pu8In_, size_t uInLen_, size_t* puConsumed_, uint8_t* pu8Out_, size_t uOutLen_);
+
+    uint64_t GetBlocks() const { return m_u64Blocks; }                  //!< Blocks decoded
+    uint64_t GetDroppedBlocks() const { return m_u64Dropped; }          //!< Blocks found, but not decoded
+    uint64_t GetSkippedBytes() const { return m_u64Skipped; }           //!< Bytes discarded outside of blocks
+    uint64_t GetCompressedBytes() const { return m_u64Compressed; }     //!< Bytes of blocks decoded
+    uint64_t GetRawBytes() const { return m_u64Raw; }                   //!< Bytes decoded from those blocks
+
+private:
+    /**
+     * @brief DecodeBlock
+     * @param stHeader_ Header of the block
+     * @param pu8Data_ Bitstream following the header
+     * @param pu8Out_ Buffer for the decoded data (at least raw_length bytes)
+     * @return true if the block decoded to exactly raw_length bytes
+     */
+    bool DecodeBlock(const LogCompressedHeader_t& stHeader_, const uint8_t* pu8Data_, uint8_t* pu8Out_);
+
+    static constexpr int m_iMaxWindowBits = 15;
+
+    uint8_t     m_au8Window[1 << m_iMaxWindowBits];
+    uint32_t    m_u32WindowPos;
+    uint8_t     m_u8Params;
+    uint8_t     m_u8NextSequence;
+    bool        m_bSynced;
+    uint64_t    m_u64Blocks;
+    uint64_t    m_u64Dropped;
+    uint64_t    m_u64Skipped;
+    uint64_t    m_u64Compressed;
+    uint64_t    m_u64Raw;
+};
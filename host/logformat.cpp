@@ -0,0 +1,291 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logformat.cpp Render decoded records using their printf-style format strings
+ */
+#include "logformat.h"
+#include "textbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    constexpr auto maxSpecLength = 32;
+
+    // Build a specifier from the flags/width/precision of szSpec_ (minus its
+    // conversion character), followed by a replacement conversion.
+    void BuildSpec(char* szOut_, const char* szSpec_, const char* szConversion_)
+    {
+        auto len = strlen(szSpec_) - 1;
+        memcpy(szOut_, szSpec_, len);
+        strcpy(&szOut_[len], szConversion_);
+    }
+
+    bool IsSigned(LogTag eTag_)
+    {
+        switch (eTag_) {
+            case LogTag::LogTagInt8:
+            case LogTag::LogTagInt16:
+            case LogTag::LogTagInt32:
+            case LogTag::LogTagInt64:
+            case LogTag::LogTagChar:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool IsString(LogTag eTag_)
+    {
+        return (eTag_ == LogTag::LogTagString) || (eTag_ == LogTag::LogTagStrcopy);
+    }
+
+    // Render the contents of a blob as space-separated hex bytes
+    size_t FormatHex(char* szOut_, size_t uLen_, const uint8_t* pu8Data_, size_t uBytes_, bool bUpper_)
+    {
+        auto* szDigits = bUpper_ ? "0123456789ABCDEF" : "0123456789abcdef";
+        size_t uOut = 0;
+        for (size_t i = 0; (i < uBytes_) && ((uOut + 3) < uLen_); i++) {
+            if (i) {
+                szOut_[uOut++] = ' ';
+            }
+            szOut_[uOut++] = szDigits[pu8Data_[i] >> 4];
+            szOut_[uOut++] = szDigits[pu8Data_[i] & 0x0F];
+        }
+        if (uLen_) {
+            szOut_[uOut] = '\0';
+        }
+        return uOut;
+    }
+
+    // Render the contents of a blob according to a layout declared in the
+    // format string, i.e. "%{ctrl:x32,status:x32,count:u16}".  Each field is an
+    // optional name, followed by a type: u/i/x (unsigned, signed, hex) with a
+    // width of 8, 16, 32 or 64 bits, f32 or f64 (float/double), or c (char).
+    // Fields are packed and little-endian.  Bytes beyond the last field are
+    // rendered as hex; fields beyond the end of the blob are omitted.
+    size_t FormatLayout(char* szOut_, size_t uLen_, const char* szLayout_, size_t uLayoutLen_, const LogArg& stArg_)
+    {
+        size_t uOut = 0;
+        size_t uOffset = 0;
+        auto* szEnd = szLayout_ + uLayoutLen_;
+
+        Append(szOut_, uLen_, &uOut, "{");
+        auto bFirst = true;
+        while (szLayout_ < szEnd) {
+            auto* szField = szLayout_;
+            while ((szLayout_ < szEnd) && (*szLayout_ != ',')) {
+                szLayout_++;
+            }
+            auto uFieldLen = (size_t)(szLayout_ - szField);
+            if (szLayout_ < szEnd) {
+                szLayout_++;
+            }
+
+            // Split the field into name and type
+            auto* szType = (const char*)memchr(szField, ':', uFieldLen);
+            auto uNameLen = szType ? (size_t)(szType - szField) : 0;
+            szType = szType ? (szType + 1) : szField;
+            auto cKind = *szType;
+            auto iBits = atoi(szType + 1);
+            auto uSize = (cKind == 'c') ? sizeof(char) : (size_t)(iBits / 8);
+            if (!strchr("uixfc", cKind) || !uSize || (uSize > sizeof(uint64_t))
+                || ((cKind == 'f') && (uSize != sizeof(float)) && (uSize != sizeof(double)))) {
+                continue;
+            }
+            if ((uOffset + uSize) > stArg_.length) {
+                break;
+            }
+
+            LogArg stField = {LogTag::LogTagUint64, (uint16_t)uSize, &stArg_.value[uOffset]};
+            uOffset += uSize;
+
+            Append(szOut_, uLen_, &uOut, bFirst ? "%.*s%s" : ", %.*s%s", (int)uNameLen, szField, uNameLen ? "=" : "");
+            bFirst = false;
+            switch (cKind) {
+                case 'i': Append(szOut_, uLen_, &uOut, "%lld", (long long)stField.AsSigned()); break;
+                case 'x': Append(szOut_, uLen_, &uOut, "0x%0*llx", (int)(uSize * 2), (unsigned long long)stField.AsUnsigned()); break;
+                case 'c': Append(szOut_, uLen_, &uOut, "'%c'", (char)stField.AsUnsigned()); break;
+                case 'f': {
+                    stField.tag = LogTag::LogTagDouble;
+                    Append(szOut_, uLen_, &uOut, "%g", stField.AsDouble());
+                } break;
+                default: Append(szOut_, uLen_, &uOut, "%llu", (unsigned long long)stField.AsUnsigned()); break;
+            }
+        }
+        if (uOffset < stArg_.length) {
+            if (!bFirst) {
+                Append(szOut_, uLen_, &uOut, ", ");
+            }
+            if (uOut < uLen_) {
+                uOut += FormatHex(&szOut_[uOut], uLen_ - uOut, &stArg_.value[uOffset], stArg_.length - uOffset, false);
+            }
+        }
+        Append(szOut_, uLen_, &uOut, "}");
+        return uOut;
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+size_t LogFormatter::FormatArg(char* szOut_, size_t uLen_, const char* szSpec_, const LogArg& stArg_,
+                               const ElfImage* pclImage_)
+{
+    char szSpec[maxSpecLength + 8];
+    auto cConversion = szSpec_[strlen(szSpec_) - 1];
+    auto bString = IsString(stArg_.tag);
+
+    if (stArg_.tag == LogTag::LogTagBlob) {
+        return FormatHex(szOut_, uLen_, stArg_.value, stArg_.length, (cConversion == 'X'));
+    }
+
+    // Pick a conversion based on the argument's tag when the specifier given
+    // doesn't match the kind of argument that was logged.
+    if (bString ? (cConversion != 's') : !strchr("diouxXcpeEfFgGaA", cConversion)) {
+        switch (stArg_.tag) {
+            case LogTag::LogTagString:
+            case LogTag::LogTagStrcopy: cConversion = 's'; break;
+            case LogTag::LogTagFloat:
+            case LogTag::LogTagDouble:  cConversion = 'g'; break;
+            case LogTag::LogTagChar:    cConversion = 'c'; break;
+            case LogTag::LogTagVoidptr: cConversion = 'p'; break;
+            default: cConversion = IsSigned(stArg_.tag) ? 'd' : 'u'; break;
+        }
+        snprintf(szSpec, sizeof(szSpec), "%%%c", cConversion);
+        szSpec_ = szSpec;
+    }
+
+    switch (cConversion) {
+        case 'd':
+        case 'i': {
+            BuildSpec(szSpec, szSpec_, "lld");
+            auto i64Value = IsSigned(stArg_.tag) ? stArg_.AsSigned() : (int64_t)stArg_.AsUnsigned();
+            return Written(snprintf(szOut_, uLen_, szSpec, (long long)i64Value), uLen_);
+        }
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X': {
+            char szConversion[] = { 'l', 'l', cConversion, '\0' };
+            BuildSpec(szSpec, szSpec_, szConversion);
+            return Written(snprintf(szOut_, uLen_, szSpec, (unsigned long long)stArg_.AsUnsigned()), uLen_);
+        }
+        case 'c': {
+            return Written(snprintf(szOut_, uLen_, szSpec_, (int)stArg_.AsUnsigned()), uLen_);
+        }
+        case 'p': {
+            uint64_t u64Offset;
+            auto* pstSymbol = pclImage_ ? pclImage_->FindSymbol(stArg_.AsUnsigned(), &u64Offset) : nullptr;
+            if (pstSymbol && u64Offset) {
+                return Written(snprintf(szOut_, uLen_, "%s+0x%llx", pstSymbol->name, (unsigned long long)u64Offset), uLen_);
+            }
+            if (pstSymbol) {
+                return Written(snprintf(szOut_, uLen_, "%s", pstSymbol->name), uLen_);
+            }
+            return Written(snprintf(szOut_, uLen_, "0x%llx", (unsigned long long)stArg_.AsUnsigned()), uLen_);
+        }
+        case 's': {
+            if (stArg_.tag == LogTag::LogTagStrcopy) {
+                char szString[UINT8_MAX + 1];
+                memcpy(szString, stArg_.value, stArg_.length);
+                szString[stArg_.length] = '\0';
+                return Written(snprintf(szOut_, uLen_, szSpec_, szString), uLen_);
+            }
+            auto* szString = pclImage_ ? pclImage_->ReadString(stArg_.AsUnsigned()) : nullptr;
+            if (!szString) {
+                return Written(snprintf(szOut_, uLen_, "<0x%llx>", (unsigned long long)stArg_.AsUnsigned()), uLen_);
+            }
+            return Written(snprintf(szOut_, uLen_, szSpec_, szString), uLen_);
+        }
+        default: {
+            return Written(snprintf(szOut_, uLen_, szSpec_, stArg_.AsDouble()), uLen_);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+size_t LogFormatter::Format(char* szOut_, size_t uLen_, const char* szFormat_, const LogRecord& stRecord_,
+                            const ElfImage* pclImage_)
+{
+    if (!uLen_) {
+        return 0;
+    }
+
+    LogArgReader clReader(stRecord_);
+    LogArg stArg;
+    size_t uOut = 0;
+    auto* szIn = szFormat_ ? szFormat_ : "";
+
+    while (*szIn && ((uOut + 1) < uLen_)) {
+        if (*szIn != '%') {
+            szOut_[uOut++] = *szIn++;
+            continue;
+        }
+        if (szIn[1] == '%') {
+            szOut_[uOut++] = '%';
+            szIn += 2;
+            continue;
+        }
+
+        // A blob layout replaces the whole specifier
+        if (szIn[1] == '{') {
+            auto* szLayout = &szIn[2];
+            auto* szLayoutEnd = strchr(szLayout, '}');
+            if (!szLayoutEnd) {
+                break;
+            }
+            szIn = szLayoutEnd + 1;
+            if (!clReader.Next(&stArg)) {
+                continue;
+            }
+            if (stArg.tag == LogTag::LogTagBlob) {
+                uOut += FormatLayout(&szOut_[uOut], uLen_ - uOut, szLayout, szLayoutEnd - szLayout, stArg);
+            } else {
+                uOut += FormatArg(&szOut_[uOut], uLen_ - uOut, "%s", stArg, pclImage_);
+            }
+            continue;
+        }
+
+        // Gather flags, width and precision, dropping any length modifiers.
+        char szSpec[maxSpecLength];
+        auto iSpec = 0;
+        szSpec[iSpec++] = *szIn++;
+        while (*szIn && strchr("-+ #0123456789.", *szIn) && (iSpec < (maxSpecLength - 2))) {
+            szSpec[iSpec++] = *szIn++;
+        }
+        while (*szIn && strchr("hlLqjzt", *szIn)) {
+            szIn++;
+        }
+        if (!*szIn) {
+            break;
+        }
+        szSpec[iSpec++] = *szIn++;
+        szSpec[iSpec] = '\0';
+
+        if (!clReader.Next(&stArg)) {
+            // More specifiers than arguments - emit the specifier as-is
+            auto uSpecLen = strlen(szSpec);
+            if ((uOut + uSpecLen) >= uLen_) {
+                break;
+            }
+            memcpy(&szOut_[uOut], szSpec, uSpecLen);
+            uOut += uSpecLen;
+            continue;
+        }
+        uOut += FormatArg(&szOut_[uOut], uLen_ - uOut, szSpec, stArg, pclImage_);
+    }
+    szOut_[uOut] = '\0';
+    return uOut;
+}
@@ -0,0 +1,74 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logformat.h Render decoded records using their printf-style format strings
+ */
+#pragma once
+
+#include "elfimage.h"
+#include "logstream.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogFormatter class
+ *
+ * Expands a format string from the .logger dictionary using the binary
+ * arguments carried by a record.  Each conversion specifier consumes the next
+ * argument; the specifier's flags, width and precision are honoured, while its
+ * length modifier is replaced according to the argument's tag, so mismatched
+ * specifiers can never read past the argument data.
+ *
+ * String arguments are rendered with the specifier's flags, width and
+ * precision.  Copied strings (TagStrcopy) are taken from the record itself,
+ * while constant strings (TagString) are read from the target's .elf image,
+ * when one is provided; otherwise their address is shown instead.
+ *
+ * Blobs (TagBlob) are rendered as space-separated hex bytes by any conversion
+ * (%X for upper-case digits), or decoded as a packed struct when the format
+ * string declares its layout in place of a conversion specifier, i.e.
+ * "%{ctrl:x32,status:x32,count:u16}" renders "{ctrl=0x..., status=0x..., count=...}".
+ */
+class LogFormatter {
+public:
+    /**
+     * @brief Format
+     *
+     * @param szOut_ Buffer to write the resulting string to
+     * @param uLen_ Size of the output buffer
+     * @param szFormat_ printf-style format string for the record
+     * @param stRecord_ Record containing the arguments to format
+     * @param pclImage_ Target image used to resolve constant strings and symbolize pointers, or nullptr
+     * @return Number of characters written (excluding the terminating nul)
+     */
+    static size_t Format(char* szOut_, size_t uLen_, const char* szFormat_, const LogRecord& stRecord_,
+                         const ElfImage* pclImage_ = nullptr);
+
+    /**
+     * @brief FormatArg
+     *
+     * Render a single argument using the given conversion specifier
+     *
+     * @param szOut_ Buffer to write the resulting string to
+     * @param uLen_ Size of the output buffer
+     * @param szSpec_ Conversion specifier (i.e. "%08x"), without length modifiers
+     * @param stArg_ Argument to render
+     * @param pclImage_ Target image used to resolve constant strings and symbolize pointers, or nullptr
+     * @return Number of characters written (excluding the terminating nul)
+     */
+    static size_t FormatArg(char* szOut_, size_t uLen_, const char* szSpec_, const LogArg& stArg_,
+                            const ElfImage* pclImage_ = nullptr);
+};
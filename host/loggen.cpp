@@ -0,0 +1,426 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file loggen.cpp Synthetic target-stream generator for load-testing host tools
+ */
+#include "loggen.h"
+
+#include "crc16.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    // Size of a pointer on the (32-bit) targets being simulated
+    constexpr uint8_t targetPointerSize = 4;
+
+    uint8_t TagSize(LogTag eTag_)
+    {
+        switch (eTag_) {
+            case LogTag::LogTagUint8:   return sizeof(uint8_t);
+            case LogTag::LogTagUint16:  return sizeof(uint16_t);
+            case LogTag::LogTagUint32:  return sizeof(uint32_t);
+            case LogTag::LogTagUint64:  return sizeof(uint64_t);
+            case LogTag::LogTagInt8:    return sizeof(int8_t);
+            case LogTag::LogTagInt16:   return sizeof(int16_t);
+            case LogTag::LogTagInt32:   return sizeof(int32_t);
+            case LogTag::LogTagInt64:   return sizeof(int64_t);
+            case LogTag::LogTagVoidptr: return targetPointerSize;
+            case LogTag::LogTagFloat:   return sizeof(float);
+            case LogTag::LogTagDouble:  return sizeof(double);
+            case LogTag::LogTagChar:    return sizeof(char);
+            default:                    return 0;
+        }
+    }
+
+    // Derive the argument tags a site would log, from its format string
+    uint8_t ParseTags(const char* szFormat_, LogTag* peTags_)
+    {
+        uint8_t u8Count = 0;
+        for (auto* szIn = szFormat_; szIn && *szIn && (u8Count < log_count_mask); szIn++) {
+            if (*szIn != '%') {
+                continue;
+            }
+            if (*++szIn == '%') {
+                continue;
+            }
+            if (*szIn == '{') {
+                // Blob, rendered using a layout declared in the format string
+                auto* szLayoutEnd = strchr(szIn, '}');
+                if (!szLayoutEnd) {
+                    break;
+                }
+                szIn = szLayoutEnd;
+                peTags_[u8Count++] = LogTag::LogTagBlob;
+                continue;
+            }
+            while (*szIn && strchr("-+ #0123456789.*", *szIn)) {
+                szIn++;
+            }
+            auto iLong = 0;
+            auto iShort = 0;
+            while (*szIn && strchr("hlLqjzt", *szIn)) {
+                iLong += (*szIn == 'l' || *szIn == 'L' || *szIn == 'q' || *szIn == 'j');
+                iShort += (*szIn == 'h');
+                szIn++;
+            }
+            if (!*szIn) {
+                break;
+            }
+
+            auto bSigned = false;
+            switch (*szIn) {
+                case 'd':
+                case 'i':
+                    bSigned = true;
+                    // Fall-through
+                case 'u':
+                case 'o':
+                case 'x':
+                case 'X':
+                    if (iLong >= 2) {
+                        peTags_[u8Count++] = bSigned ? LogTag::LogTagInt64 : LogTag::LogTagUint64;
+                    } else if (iShort >= 2) {
+                        peTags_[u8Count++] = bSigned ? LogTag::LogTagInt8 : LogTag::LogTagUint8;
+                    } else if (iShort == 1) {
+                        peTags_[u8Count++] = bSigned ? LogTag::LogTagInt16 : LogTag::LogTagUint16;
+                    } else {
+                        peTags_[u8Count++] = bSigned ? LogTag::LogTagInt32 : LogTag::LogTagUint32;
+                    }
+                    break;
+                case 'c':
+                    peTags_[u8Count++] = LogTag::LogTagChar;
+                    break;
+                case 'p':
+                    peTags_[u8Count++] = LogTag::LogTagVoidptr;
+                    break;
+                case 's':
+                    peTags_[u8Count++] = LogTag::LogTagStrcopy;
+                    break;
+                case 'e': case 'E':
+                case 'f': case 'F':
+                case 'g': case 'G':
+                case 'a': case 'A':
+                    peTags_[u8Count++] = iLong ? LogTag::LogTagDouble : LogTag::LogTagFloat;
+                    break;
+                default:
+                    peTags_[u8Count++] = LogTag::LogTagUint32;
+                    break;
+            }
+        }
+        return u8Count;
+    }
+
+    inline size_t Put(uint8_t* pu8Out_, const void* pvData_, size_t uLen_)
+    {
+        memcpy(pu8Out_, pvData_, uLen_);
+        return uLen_;
+    }
+
+    inline size_t PutTlv(uint8_t* pu8Out_, LogTag eTag_, uint8_t u8Length_, uint64_t u64Value_)
+    {
+        pu8Out_[0] = (uint8_t)(((unsigned)eTag_ & ((1 << tag_bits) - 1)) | (u8Length_ << tag_bits));
+        // Values are stored little-endian, as written by the target
+        for (auto i = 0; i < u8Length_; i++) {
+            pu8Out_[1 + i] = (uint8_t)(u64Value_ >> (8 * i));
+        }
+        return 1 + u8Length_;
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+LogGenerator::LogGenerator(LoggerParser* pclDictionary_, const GenConfig& stConfig_)
+: m_pclDictionary{pclDictionary_}
+, m_stConfig(stConfig_)
+, m_pstSites{nullptr}
+, m_pdCumulative{nullptr}
+, m_iSites{0}
+, m_u64State{stConfig_.u64Seed ? stConfig_.u64Seed : 1}
+, m_u64Generated{0}
+, m_u64Damaged{0}
+, m_u16Sequence{0}
+, m_dTimeUs{0}
+, m_dNextSyncUs{0}
+{}
+
+//---------------------------------------------------------------------------
+LogGenerator::~LogGenerator()
+{
+    free(m_pstSites);
+    free(m_pdCumulative);
+}
+
+//---------------------------------------------------------------------------
+bool LogGenerator::Init()
+{
+    auto iCount = 0;
+    for (auto* pclLine = m_pclDictionary->GetLogLines(); pclLine; pclLine = static_cast<LogLine*>(pclLine->GetNext())) {
+        iCount++;
+    }
+    if (!iCount) {
+        return false;
+    }
+
+    m_pstSites = (Site*)calloc(iCount, sizeof(Site));
+    m_pdCumulative = (double*)calloc(iCount, sizeof(double));
+    for (auto* pclLine = m_pclDictionary->GetLogLines(); pclLine; pclLine = static_cast<LogLine*>(pclLine->GetNext())) {
+        auto& stSite = m_pstSites[m_iSites++];
+        stSite.fileHash = pclLine->m_fileHash;
+        stSite.line = (uint16_t)pclLine->m_clTempLine;
+        stSite.argCount = ParseTags(pclLine->m_szFormatString, stSite.tags);
+    }
+
+    // Shuffle the sites so the busiest ones aren't simply the first in the
+    // dictionary, then weight them by a Zipf distribution.
+    for (auto i = m_iSites - 1; i > 0; i--) {
+        auto j = (int)(Random() % (i + 1));
+        auto stTmp = m_pstSites[i];
+        m_pstSites[i] = m_pstSites[j];
+        m_pstSites[j] = stTmp;
+    }
+    auto dTotal = 0.0;
+    for (auto i = 0; i < m_iSites; i++) {
+        dTotal += 1.0 / pow(i + 1, m_stConfig.dZipf);
+        m_pdCumulative[i] = dTotal;
+    }
+    for (auto i = 0; i < m_iSites; i++) {
+        m_pdCumulative[i] /= dTotal;
+    }
+
+    m_dNextSyncUs = (m_stConfig.dSyncPeriod > 0) ? 0.0 : INFINITY;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+uint64_t LogGenerator::Random()
+{
+    // xorshift64*
+    m_u64State ^= m_u64State >> 12;
+    m_u64State ^= m_u64State << 25;
+    m_u64State ^= m_u64State >> 27;
+    return m_u64State * 0x2545F4914F6CDD1DULL;
+}
+
+//---------------------------------------------------------------------------
+double LogGenerator::RandomUnit()
+{
+    return (Random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//---------------------------------------------------------------------------
+uint64_t LogGenerator::GenerateValue(Site& stSite_, LogTag eTag_)
+{
+    double dValue;
+    switch (m_stConfig.eValues) {
+        case GenValues::Uniform: {
+            if (eTag_ != LogTag::LogTagFloat && eTag_ != LogTag::LogTagDouble) {
+                return Random();
+            }
+            dValue = (RandomUnit() - 0.5) * 2.0e6;
+        } break;
+        case GenValues::Counter: {
+            dValue = (double)stSite_.counter;
+            if (eTag_ != LogTag::LogTagFloat && eTag_ != LogTag::LogTagDouble) {
+                return stSite_.counter;
+            }
+        } break;
+        case GenValues::Small:
+        default: {
+            auto u64Value = Random() % 100;
+            if (eTag_ != LogTag::LogTagFloat && eTag_ != LogTag::LogTagDouble) {
+                return u64Value;
+            }
+            dValue = u64Value / 4.0;
+        } break;
+    }
+
+    if (eTag_ == LogTag::LogTagFloat) {
+        float fValue = (float)dValue;
+        uint32_t u32Bits;
+        memcpy(&u32Bits, &fValue, sizeof(u32Bits));
+        return u32Bits;
+    }
+    uint64_t u64Bits;
+    memcpy(&u64Bits, &dValue, sizeof(u64Bits));
+    return u64Bits;
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::PutStart(uint8_t* pu8Out_, LogHeader_t stHeader_)
+{
+    size_t uLen = 0;
+    uLen += Put(&pu8Out_[uLen], &TOKEN_RECORD_START, sizeof(uint16_t));
+    if (!m_stConfig.bFramed) {
+        return uLen + Put(&pu8Out_[uLen], &stHeader_, sizeof(stHeader_));
+    }
+    stHeader_.log_count |= log_flag_sequence | log_flag_crc;
+    uLen += Put(&pu8Out_[uLen], &stHeader_, sizeof(stHeader_));
+    uLen += Put(&pu8Out_[uLen], &m_u16Sequence, sizeof(uint16_t));
+    m_u16Sequence++;
+    return uLen;
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::PutEnd(uint8_t* pu8Out_, size_t uLen_)
+{
+    if (m_stConfig.bFramed) {
+        auto u16Crc = crc16_update(crc16_init, &pu8Out_[sizeof(uint16_t)], uLen_ - sizeof(uint16_t));
+        uLen_ += Put(&pu8Out_[uLen_], &u16Crc, sizeof(u16Crc));
+    }
+    return uLen_ + Put(&pu8Out_[uLen_], &TOKEN_RECORD_END, sizeof(uint16_t));
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::Encode(uint8_t* pu8Out_, Site& stSite_, uint64_t u64Ticks_)
+{
+    LogHeader_t header = {
+        .file_id = stSite_.fileHash,
+        .timestamp = (uint32_t)u64Ticks_,
+        .line = stSite_.line,
+        .log_count = stSite_.argCount,
+    };
+
+    auto uLen = PutStart(pu8Out_, header);
+    for (auto i = 0; i < stSite_.argCount; i++) {
+        auto eTag = stSite_.tags[i];
+        if (eTag == LogTag::LogTagStrcopy) {
+            uLen += PutStrcopy(&pu8Out_[uLen]);
+            continue;
+        }
+        if (eTag == LogTag::LogTagBlob) {
+            uLen += PutBlob(&pu8Out_[uLen]);
+            continue;
+        }
+        uLen += PutTlv(&pu8Out_[uLen], eTag, TagSize(eTag), GenerateValue(stSite_, eTag));
+    }
+    uLen = PutEnd(pu8Out_, uLen);
+    stSite_.counter++;
+    return uLen;
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::PutStrcopy(uint8_t* pu8Out_)
+{
+    // Short identifier-like strings, of the kind typically built at runtime
+    static const char acAlphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789_-";
+    auto u8Length = (uint8_t)(Random() % (strcopy_max_length + 1));
+    pu8Out_[0] = (uint8_t)(((unsigned)LogTag::LogTagStrcopy & ((1 << tag_bits) - 1)) | (sizeof(uint8_t) << tag_bits));
+    pu8Out_[1] = u8Length;
+    for (auto i = 0; i < u8Length; i++) {
+        pu8Out_[2 + i] = (uint8_t)acAlphabet[Random() % (sizeof(acAlphabet) - 1)];
+    }
+    return 2 + u8Length;
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::PutBlob(uint8_t* pu8Out_)
+{
+    auto u16Length = (uint16_t)(Random() % (blob_max_length + 1));
+    pu8Out_[0] = (uint8_t)(((unsigned)LogTag::LogTagBlob & ((1 << tag_bits) - 1)) | (sizeof(uint16_t) << tag_bits));
+    pu8Out_[1] = (uint8_t)u16Length;
+    pu8Out_[2] = (uint8_t)(u16Length >> 8);
+    for (auto i = 0; i < u16Length; i++) {
+        pu8Out_[3 + i] = (uint8_t)Random();
+    }
+    return 3 + u16Length;
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::EncodeClockSync(uint8_t* pu8Out_, uint64_t u64Ticks_)
+{
+    LogHeader_t header = {
+        .file_id = system_file_id,
+        .timestamp = (uint32_t)u64Ticks_,
+        .line = (uint16_t)LogSystemRecord::ClockSync,
+        .log_count = 1,
+    };
+
+    auto uLen = PutStart(pu8Out_, header);
+    uLen += PutTlv(&pu8Out_[uLen], LogTag::LogTagUint64, sizeof(uint64_t), m_stConfig.u64EpochUs + (uint64_t)m_dTimeUs);
+    uLen = PutEnd(pu8Out_, uLen);
+    return uLen;
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::EncodeClockRate(uint8_t* pu8Out_, uint64_t u64Ticks_)
+{
+    LogHeader_t header = {
+        .file_id = system_file_id,
+        .timestamp = (uint32_t)u64Ticks_,
+        .line = (uint16_t)LogSystemRecord::ClockRate,
+        .log_count = 2,
+    };
+
+    auto uLen = PutStart(pu8Out_, header);
+    uLen += PutTlv(&pu8Out_[uLen], LogTag::LogTagUint32, sizeof(uint32_t), (uint32_t)(1e6 / m_stConfig.dUsPerTick));
+    uLen += PutTlv(&pu8Out_[uLen], LogTag::LogTagUint64, sizeof(uint64_t), u64Ticks_);
+    uLen = PutEnd(pu8Out_, uLen);
+    return uLen;
+}
+
+//---------------------------------------------------------------------------
+size_t LogGenerator::Next(uint8_t* pu8Out_)
+{
+    if (m_u64Generated >= m_stConfig.u64Records) {
+        return 0;
+    }
+
+    auto u64Ticks = m_stConfig.u32StartTick + (uint64_t)(m_dTimeUs / m_stConfig.dUsPerTick);
+    if (m_dTimeUs >= m_dNextSyncUs) {
+        m_dNextSyncUs += m_stConfig.dSyncPeriod * 1e6;
+        auto uLen = EncodeClockRate(pu8Out_, u64Ticks);
+        return uLen + EncodeClockSync(&pu8Out_[uLen], u64Ticks);
+    }
+
+    // Pick a site, weighted by the site mix
+    auto dPick = RandomUnit();
+    auto lo = 0;
+    auto hi = m_iSites - 1;
+    while (lo < hi) {
+        auto mid = (lo + hi) / 2;
+        if (m_pdCumulative[mid] < dPick) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    auto uLen = Encode(pu8Out_, m_pstSites[lo], u64Ticks);
+    m_u64Generated++;
+
+    // Inject corruption and ring overwrites
+    auto bDamaged = false;
+    if (m_stConfig.dCorrupt > 0) {
+        for (size_t i = 0; i < uLen; i++) {
+            if (RandomUnit() < m_stConfig.dCorrupt) {
+                pu8Out_[i] ^= (uint8_t)(1 << (Random() & 7));
+                bDamaged = true;
+            }
+        }
+    }
+    if ((m_stConfig.dOverwrite > 0) && (RandomUnit() < m_stConfig.dOverwrite)) {
+        uLen = 1 + (Random() % (uLen - 1));
+        bDamaged = true;
+    }
+    m_u64Damaged += bDamaged;
+
+    // Advance stream time by a Poisson inter-arrival, faster during bursts
+    auto dRate = m_stConfig.dRate;
+    if ((m_stConfig.dBurstPeriod > 0) && (fmod(m_dTimeUs / 1e6, m_stConfig.dBurstPeriod) < m_stConfig.dBurstLength)) {
+        dRate *= m_stConfig.dBurstFactor;
+    }
+    m_dTimeUs += (-log(1.0 - RandomUnit()) / dRate) * 1e6;
+    return uLen;
+}
@@ -0,0 +1,152 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file loggen.h Synthetic target-stream generator for load-testing host tools
+ */
+#pragma once
+
+#include "loggerparser.h"
+#include "logstream.h"
+#include "logtypes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+// Maximum size of a single generated record: sync words + header + sequence
+// number and CRC + the maximum number of arguments, each of which may be a blob
+// (TLV + 16-bit length + bytes)
+constexpr size_t GEN_MAX_RECORD_SIZE = RECORD_MIN_SIZE + (2 * sizeof(uint16_t)) + (log_count_mask * (3 + blob_max_length));
+
+//---------------------------------------------------------------------------
+// Distribution of generated argument values
+enum class GenValues {
+    Uniform,    //!< Uniformly-distributed over the full range of each argument's type
+    Small,      //!< Small non-negative values, typical of counters, states and indices
+    Counter,    //!< Per-site counters incrementing by one on each record
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The GenConfig struct
+ *
+ * Parameters describing the load to generate.
+ */
+struct GenConfig {
+    uint64_t    u64Records = 100000;        //!< Number of records to generate
+    double      dRate = 1000.0;             //!< Average record rate (records/s) outside of bursts
+    double      dUsPerTick = 1000.0;        //!< Duration of a target tick (microseconds)
+    uint32_t    u32StartTick = 0;           //!< Timestamp of the first record
+    double      dZipf = 1.0;                //!< Skew of the site mix (0 == all sites equally likely)
+    GenValues   eValues = GenValues::Small; //!< Argument value distribution
+    double      dBurstPeriod = 0.0;         //!< Seconds between the start of bursts (0 == no bursts)
+    double      dBurstLength = 0.0;         //!< Duration of each burst (seconds)
+    double      dBurstFactor = 10.0;        //!< Rate multiplier during a burst
+    double      dCorrupt = 0.0;             //!< Probability of a byte in a record being flipped
+    double      dOverwrite = 0.0;           //!< Probability of a record being torn by a ring overwrite
+    double      dSyncPeriod = 0.0;          //!< Seconds between clock-rate/clock-sync records (0 == none)
+    uint64_t    u64EpochUs = 0;             //!< Wall-clock time of the first record (microseconds since epoch)
+    uint64_t    u64Seed = 1;                //!< Random seed, making the generated stream repeatable
+    bool        bFramed = false;            //!< Add sequence numbers and CRCs to records (as LOGBUF_FRAMING)
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogGenerator class
+ *
+ * Produces records in the exact wire format written by LogBuf on the target,
+ * for every site found in a .logger dictionary.  Argument tags are derived from
+ * each site's format string, sites are drawn from a Zipf-distributed mix, and
+ * records are timestamped by a Poisson arrival process whose rate is multiplied
+ * during periodic bursts.  Corruption (bit flips) and ring overwrites (records
+ * cut short by the writer lapping the reader) can be injected at random.
+ */
+class LogGenerator {
+public:
+    LogGenerator(LoggerParser* pclDictionary_, const GenConfig& stConfig_);
+    ~LogGenerator();
+
+    /**
+     * @brief Init
+     *
+     * Build the table of sites to generate records for.
+     *
+     * @return true on success, false if the dictionary contains no sites
+     */
+    bool Init();
+
+    /**
+     * @brief Next
+     *
+     * Generate the next record in the stream.
+     *
+     * @param pu8Out_ Buffer to write the record to (at least GEN_MAX_RECORD_SIZE bytes)
+     * @return Number of bytes written, 0 once the configured number of records
+     *         have been generated.
+     */
+    size_t Next(uint8_t* pu8Out_);
+
+    /**
+     * @brief GetTimeUs
+     * @return Stream time of the last record generated, in microseconds from
+     *         the start of the stream
+     */
+    double GetTimeUs() const { return m_dTimeUs; }
+
+    /**
+     * @brief GetSiteCount
+     * @return Number of sites records are generated for
+     */
+    int GetSiteCount() const { return m_iSites; }
+
+    /**
+     * @brief GetDamaged
+     * @return Number of records generated so far that were corrupted or torn
+     */
+    uint64_t GetDamaged() const { return m_u64Damaged; }
+
+private:
+    struct Site {
+        uint32_t    fileHash;
+        uint16_t    line;
+        uint8_t     argCount;
+        LogTag      tags[UINT8_MAX];
+        uint64_t    counter;
+    };
+
+    uint64_t Random();
+    double RandomUnit();
+    size_t PutStart(uint8_t* pu8Out_, LogHeader_t stHeader_);
+    size_t PutEnd(uint8_t* pu8Out_, size_t uLen_);
+    size_t Encode(uint8_t* pu8Out_, Site& stSite_, uint64_t u64Ticks_);
+    size_t EncodeClockSync(uint8_t* pu8Out_, uint64_t u64Ticks_);
+    size_t EncodeClockRate(uint8_t* pu8Out_, uint64_t u64Ticks_);
+    size_t PutStrcopy(uint8_t* pu8Out_);
+    size_t PutBlob(uint8_t* pu8Out_);
+    uint64_t GenerateValue(Site& stSite_, LogTag eTag_);
+
+    LoggerParser*   m_pclDictionary;
+    GenConfig       m_stConfig;
+
+    Site*           m_pstSites;
+    double*         m_pdCumulative;
+    int             m_iSites;
+
+    uint64_t        m_u64State;
+    uint64_t        m_u64Generated;
+    uint64_t        m_u64Damaged;
+    uint16_t        m_u16Sequence;
+    double          m_dTimeUs;
+    double          m_dNextSyncUs;
+};
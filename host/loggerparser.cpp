@@ -3,6 +3,7 @@
 #include "filemap.h"
 #include "ll.h"
 #include "logline.h"
+#include "fnv_hash32.h"
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -14,6 +15,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 //---------------------------------------------------------------------------
 LoggerParser::LoggerParser(const char* szPath_)
@@ -21,8 +23,20 @@ LoggerParser::LoggerParser(const char* szPath_)
 , m_bInit{false}
 , m_idx{0}
 , m_fd{0}
+, m_pvMap{nullptr}
+, m_uMapSize{0}
 {}
 
+//---------------------------------------------------------------------------
+LoggerParser::~LoggerParser()
+{
+    // Format strings and file names from a version 2 section point directly
+    // into the mapping, so it's kept for the parser's lifetime.
+    if (m_pvMap) {
+        munmap(m_pvMap, m_uMapSize);
+    }
+}
+
 //---------------------------------------------------------------------------
 bool LoggerParser::Init()
 {
@@ -44,7 +58,141 @@ bool LoggerParser::Parse() {
     if (!m_bInit) {
         return false;
     }
+    if (IsVersion2()) {
+        return ParseVersion2();
+    }
+    return ParseVersion1();
+}
 
+//---------------------------------------------------------------------------
+const LoggerParser::RecordHandler_t LoggerParser::m_apfRecordHandlers[] = {
+    nullptr,                                // Reserved
+    &LoggerParser::FileRecordHandler,       // LogSectionType::File
+    &LoggerParser::SiteRecordHandler,       // LogSectionType::Site
+    &LoggerParser::ScopeRecordHandler,      // LogSectionType::Scope
+    &LoggerParser::MetricRecordHandler,     // LogSectionType::Counter
+    &LoggerParser::MetricRecordHandler,     // LogSectionType::Gauge
+    &LoggerParser::MetricRecordHandler,     // LogSectionType::Histogram
+};
+
+//---------------------------------------------------------------------------
+bool LoggerParser::IsVersion2()
+{
+    LogSectionHeader_t stHeader;
+    auto nr = pread(m_fd, &stHeader, sizeof(stHeader), 0);
+    return (nr == sizeof(stHeader))
+        && (stHeader.magic == logger_section_magic)
+        && (stHeader.version == logger_section_version);
+}
+
+//---------------------------------------------------------------------------
+bool LoggerParser::ParseVersion2()
+{
+    struct stat stStat;
+    if (fstat(m_fd, &stStat) || !stStat.st_size) {
+        return false;
+    }
+    m_uMapSize = stStat.st_size;
+    m_pvMap = mmap(nullptr, m_uMapSize, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (m_pvMap == MAP_FAILED) {
+        m_pvMap = nullptr;
+        return false;
+    }
+
+    auto* pu8Section = (const uint8_t*)m_pvMap;
+    size_t uIdx = 0;
+    while ((uIdx + sizeof(LogSectionHeader_t)) <= m_uMapSize) {
+        // Skip zero-filled alignment between the sections of separate objects
+        uint32_t u32Word;
+        memcpy(&u32Word, &pu8Section[uIdx], sizeof(u32Word));
+        if (!u32Word) {
+            uIdx += sizeof(u32Word);
+            continue;
+        }
+
+        LogSectionHeader_t stHeader;
+        memcpy(&stHeader, &pu8Section[uIdx], sizeof(stHeader));
+        if ((stHeader.magic != logger_section_magic)
+            || (stHeader.version != logger_section_version)
+            || (stHeader.length <= sizeof(stHeader))
+            || ((uIdx + stHeader.length) > m_uMapSize)) {
+            return false;
+        }
+
+        auto* szString = (const char*)&pu8Section[uIdx + sizeof(stHeader)];
+        auto uMaxLen = stHeader.length - sizeof(stHeader);
+        if (strnlen(szString, uMaxLen) == uMaxLen) {
+            return false;
+        }
+
+        // Unknown record types are skipped, for forward compatibility
+        if ((stHeader.type < (sizeof(m_apfRecordHandlers) / sizeof(m_apfRecordHandlers[0])))
+            && m_apfRecordHandlers[stHeader.type]) {
+            (this->*m_apfRecordHandlers[stHeader.type])(stHeader, szString);
+        }
+        uIdx += stHeader.length;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void LoggerParser::FileRecordHandler(const LogSectionHeader_t& stHeader_, const char* szString_)
+{
+    auto* newMapNode = new FileMap();
+    newMapNode->ClearNode();
+    newMapNode->filename = const_cast<char*>(szString_);
+    newMapNode->m_fileHash = stHeader_.file_id;
+    m_clFileMapList.AddFile(newMapNode);
+}
+
+//---------------------------------------------------------------------------
+void LoggerParser::SiteRecordHandler(const LogSectionHeader_t& stHeader_, const char* szString_)
+{
+    auto* newLogNode = new LogLine();
+    newLogNode->ClearNode();
+    newLogNode->m_szFormatString = const_cast<char*>(szString_);
+    newLogNode->m_fileHash = stHeader_.file_id;
+    newLogNode->m_clTempLine = stHeader_.line;
+    m_clLogLineList.AddLog(newLogNode);
+}
+
+//---------------------------------------------------------------------------
+void LoggerParser::ScopeRecordHandler(const LogSectionHeader_t& /*stHeader_*/, const char* szString_)
+{
+    // Records identify a scope by the hash of its name (see SCOPE_ID()), which
+    // is registered once for each site that begins or ends it.
+    m_clScopes[hash_32_fnv1a_const(szString_)] = szString_;
+}
+
+//---------------------------------------------------------------------------
+void LoggerParser::MetricRecordHandler(const LogSectionHeader_t& stHeader_, const char* szString_)
+{
+    // Histograms follow their name with '|' and a comma-separated list of
+    // bounds; the metric's id is the hash of the name alone (see METRIC_ID()).
+    LogMetricInfo stMetric;
+    stMetric.type = (LogSectionType)stHeader_.type;
+    auto* szBounds = strchr(szString_, '|');
+    if (szBounds && (stMetric.type == LogSectionType::Histogram)) {
+        stMetric.name.assign(szString_, szBounds - szString_);
+        for (auto* szNext = szBounds + 1; *szNext;) {
+            char* szEnd;
+            auto u32Bound = (uint32_t)strtoul(szNext, &szEnd, 0);
+            if (szEnd == szNext) {
+                break;
+            }
+            stMetric.bounds.push_back(u32Bound);
+            szNext = szEnd + strcspn(szEnd, ",");
+            szNext += strspn(szNext, ", ");
+        }
+    } else {
+        stMetric.name = szString_;
+    }
+    auto u32Id = hash_32_fnv1a_const(stMetric.name.c_str());
+    m_clMetrics[u32Id] = stMetric;
+}
+
+//---------------------------------------------------------------------------
+bool LoggerParser::ParseVersion1() {
     m_clTempMap.ClearNode();
     m_clTempLine.ClearNode();
     m_eParseState = ParseState::Begin;
@@ -3,6 +3,13 @@
 #include "filemap.h"
 #include "ll.h"
 #include "logline.h"
+#include "logtypes.h"
+
+#include <stddef.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 constexpr auto TOKEN_LOG_END = (0xD00D);
 constexpr auto TOKEN_LOG_START = (0xCAFE);
@@ -23,16 +30,56 @@ enum class ParseState {
     FileEnd
 };
 
+//---------------------------------------------------------------------------
+// Declaration of an on-target metric (see LogMetric), from the .logger section
+struct LogMetricInfo {
+    LogSectionType          type;       //!< LogSectionType::Counter, Gauge or Histogram
+    std::string             name;
+    std::vector<uint32_t>   bounds;     //!< Histogram bucket bounds
+};
+
 class LoggerParser {
 public:
     LoggerParser(const char* szPath_);
+    ~LoggerParser();
 
     bool Init();
     bool Parse();
     void Serialize();
 
+    const LogLine* FindLogLine(uint32_t fileHash_, uint32_t line_) { return m_clLogLineList.Find(fileHash_, line_); }
+    const FileMap* FindFile(uint32_t fileHash_) { return m_clFileMapList.Find(fileHash_); }
+    LogLine* GetLogLines() { return m_clLogLineList.GetHead(); }
+
+    // Name of a traced scope (see TRACE_SCOPE()), given its id, or nullptr
+    const char* FindScope(uint32_t u32Scope_) const
+    {
+        auto it = m_clScopes.find(u32Scope_);
+        return (it != m_clScopes.end()) ? it->second : nullptr;
+    }
+
+    // Declaration of a metric, given its id, or nullptr
+    const LogMetricInfo* FindMetric(uint32_t u32Metric_) const
+    {
+        auto it = m_clMetrics.find(u32Metric_);
+        return (it != m_clMetrics.end()) ? &it->second : nullptr;
+    }
+
 private:
 
+    // Version 2 (table-driven) section format
+    using RecordHandler_t = void (LoggerParser::*)(const LogSectionHeader_t& stHeader_, const char* szString_);
+    static const RecordHandler_t m_apfRecordHandlers[];
+
+    bool IsVersion2();
+    bool ParseVersion2();
+    void FileRecordHandler(const LogSectionHeader_t& stHeader_, const char* szString_);
+    void SiteRecordHandler(const LogSectionHeader_t& stHeader_, const char* szString_);
+    void ScopeRecordHandler(const LogSectionHeader_t& stHeader_, const char* szString_);
+    void MetricRecordHandler(const LogSectionHeader_t& stHeader_, const char* szString_);
+
+    // Version 1 (state-machine) section format
+    bool ParseVersion1();
     bool BeginHandler();
     bool LogBeginHandler();
     bool LogStringHandler();
@@ -57,6 +104,12 @@ private:
     FileMapList m_clFileMapList;
     LogLineList m_clLogLineList;
 
+    std::unordered_map<uint32_t, const char*> m_clScopes;
+    std::unordered_map<uint32_t, LogMetricInfo> m_clMetrics;
+
     bool m_bDirection;
+
+    void* m_pvMap;
+    size_t m_uMapSize;
 };
 
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
+
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "ll.h"
 
@@ -22,8 +25,41 @@ public:
 //---------------------------------------------------------------------------
 class LogLineList {
 public:
+    ~LogLineList() {
+        free(m_ppclIndex);
+    }
+
     void AddLog(LogLine* pclLog_) {
         m_clList.Add(pclLog_);
+        m_bIndexed = false;
+    }
+
+    // Lookups are made once per decoded record, so they go through a sorted
+    // index that's (re)built on the first lookup after the list changes.
+    LogLine* Find(uint32_t fileHash_, uint32_t line_) {
+        if (!m_bIndexed) {
+            BuildIndex();
+        }
+        auto lo = 0;
+        auto hi = m_iCount - 1;
+        while (lo <= hi) {
+            auto mid = (lo + hi) / 2;
+            auto* logNode = m_ppclIndex[mid];
+            if (logNode->m_fileHash == fileHash_ && logNode->m_clTempLine == line_) {
+                return logNode;
+            }
+            if (logNode->m_fileHash < fileHash_ ||
+                (logNode->m_fileHash == fileHash_ && logNode->m_clTempLine < line_)) {
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        return nullptr;
+    }
+
+    LogLine* GetHead() {
+        return static_cast<LogLine*>(m_clList.GetHead());
     }
 
     void Serialize() {
@@ -46,5 +82,26 @@ public:
     }
 
 private:
+    void BuildIndex() {
+        m_iCount = 0;
+        for (auto* node = m_clList.GetHead(); node != nullptr; node = node->GetNext()) {
+            m_iCount++;
+        }
+        free(m_ppclIndex);
+        m_ppclIndex = (LogLine**)malloc(sizeof(LogLine*) * (m_iCount + 1));
+        auto i = 0;
+        for (auto* node = m_clList.GetHead(); node != nullptr; node = node->GetNext()) {
+            m_ppclIndex[i++] = static_cast<LogLine*>(node);
+        }
+        std::sort(m_ppclIndex, m_ppclIndex + m_iCount, [](const LogLine* a, const LogLine* b) {
+            return (a->m_fileHash != b->m_fileHash) ? (a->m_fileHash < b->m_fileHash)
+                                                    : (a->m_clTempLine < b->m_clTempLine);
+        });
+        m_bIndexed = true;
+    }
+
     DoubleLinkList m_clList;
+    LogLine** m_ppclIndex = nullptr;
+    int m_iCount = 0;
+    bool m_bIndexed = false;
 };
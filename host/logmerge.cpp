@@ -0,0 +1,125 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logmerge.cpp Merge records from sharded target buffers into timestamp order
+ */
+#include "logmerge.h"
+
+#include <utility>
+
+//---------------------------------------------------------------------------
+LogMerger::LogMerger(LogStream* pclStream_, size_t uWindow_)
+: m_pclStream{pclStream_}
+, m_uWindow{uWindow_ ? uWindow_ : 1}
+, m_uQueued{0}
+, m_bEof{false}
+, m_iFlushing{-1}
+, m_stCurrent{}
+{}
+
+//---------------------------------------------------------------------------
+void LogMerger::Activate(size_t uShard_)
+{
+    if (uShard_ >= m_clShards.size()) {
+        m_clShards.resize(uShard_ + 1);
+    }
+    m_clShards[uShard_].active = true;
+}
+
+//---------------------------------------------------------------------------
+bool LogMerger::Read()
+{
+    LogRecord stRecord;
+    if (!m_pclStream->Next(&stRecord)) {
+        m_bEof = true;
+        return false;
+    }
+
+    if ((stRecord.header.file_id == system_file_id) && (stRecord.header.line == (uint16_t)LogSystemRecord::Shard)) {
+        LogArgReader clReader(stRecord);
+        LogArg stArg;
+        if (clReader.Next(&stArg) && clReader.Next(&stArg)) {
+            for (size_t i = 0; i < stArg.AsUnsigned(); i++) {
+                Activate(i);
+            }
+        }
+        Activate(stRecord.shard);
+
+        // The previous shard's flush is complete, and this one's is starting
+        if (m_iFlushing >= 0) {
+            m_clShards[m_iFlushing].flushed = true;
+            m_clShards[m_iFlushing].watermark = m_clShards[m_iFlushing].pending;
+        }
+        m_iFlushing = stRecord.shard;
+        m_clShards[stRecord.shard].pending = stRecord.timestamp;
+        return true;
+    }
+
+    // Records point into the stream's buffer, so take a copy of the arguments
+    Activate(stRecord.shard);
+    Entry stEntry;
+    stEntry.record = stRecord;
+    stEntry.args.assign(stRecord.args, stRecord.args + stRecord.argBytes);
+    m_clShards[stRecord.shard].queue.push_back(std::move(stEntry));
+    m_uQueued++;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool LogMerger::Ready(const Entry& stNext_) const
+{
+    // Each shard's records arrive in order, so a shard can only still hold an
+    // earlier record if it has nothing queued, and hasn't been flushed since.
+    for (auto& stShard : m_clShards) {
+        if (stShard.active && stShard.queue.empty()
+            && (!stShard.flushed || (stShard.watermark < stNext_.record.timestamp))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool LogMerger::Next(LogRecord* pstRecord_)
+{
+    while (true) {
+        // The number of shards is small, so a linear scan of the queue heads is
+        // cheaper than maintaining a heap.
+        Shard* pstNext = nullptr;
+        for (auto& stShard : m_clShards) {
+            if (stShard.queue.empty()) {
+                continue;
+            }
+            if (!pstNext || (stShard.queue.front().record.timestamp < pstNext->queue.front().record.timestamp)) {
+                pstNext = &stShard;
+            }
+        }
+
+        if (!m_bEof && (m_uQueued < m_uWindow) && (!pstNext || !Ready(pstNext->queue.front()))) {
+            Read();
+            continue;
+        }
+        if (!pstNext) {
+            return false;
+        }
+
+        m_stCurrent = std::move(pstNext->queue.front());
+        pstNext->queue.pop_front();
+        m_uQueued--;
+
+        *pstRecord_ = m_stCurrent.record;
+        pstRecord_->args = m_stCurrent.args.data();
+        return true;
+    }
+}
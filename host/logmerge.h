@@ -0,0 +1,92 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logmerge.h Merge records from sharded target buffers into timestamp order
+ */
+#pragma once
+
+#include "logstream.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogMerger class
+ *
+ * When a target shards its logs across several buffers, each shard is flushed
+ * as a block, so records from different shards arrive out of timestamp order.
+ * LogMerger reads records from a stream into one queue per shard, and performs
+ * a k-way merge of the queues by timestamp.
+ *
+ * The target begins every flush of a shard with a shard record (even when the
+ * shard has nothing to flush), which identifies the shard and the number of
+ * shards, and is timestamped after anything flushed with it.  A flush is
+ * complete once the next shard record arrives.  A record is only returned once
+ * every other shard either has a record queued, or has completed a flush since
+ * the record's timestamp, so no earlier record can still arrive.
+ * The merge window bounds memory use (and latency) should a shard stop
+ * flushing altogether.
+ *
+ * Shard records are consumed by the merger, and are not returned.
+ */
+class LogMerger {
+public:
+    /**
+     * @brief LogMerger
+     * @param pclStream_ Stream to read records from
+     * @param uWindow_ Maximum number of records to hold back while merging
+     */
+    LogMerger(LogStream* pclStream_, size_t uWindow_ = 65536);
+
+    /**
+     * @brief Next
+     *
+     * Return the next record, in timestamp order.  The record's argument data
+     * is only valid until the next call.
+     *
+     * @param pstRecord_ Record view to populate
+     * @return true if a record was returned, false at end-of-stream
+     */
+    bool Next(LogRecord* pstRecord_);
+
+private:
+    struct Entry {
+        LogRecord               record;
+        std::vector<uint8_t>    args;
+    };
+
+    struct Shard {
+        std::deque<Entry>   queue;
+        bool                active;     //!< Shard is known to exist
+        bool                flushed;    //!< A complete flush of the shard has been seen
+        uint64_t            watermark;  //!< Timestamp of the most recent complete flush
+        uint64_t            pending;    //!< Timestamp of the flush currently being read
+    };
+
+    bool Read();
+    void Activate(size_t uShard_);
+    bool Ready(const Entry& stNext_) const;
+
+    LogStream*                      m_pclStream;
+    size_t                          m_uWindow;
+    size_t                          m_uQueued;
+    bool                            m_bEof;
+    int                             m_iFlushing;
+    std::vector<Shard>              m_clShards;
+    Entry                           m_stCurrent;
+};
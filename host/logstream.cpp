@@ -0,0 +1,483 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logstream.cpp Raw record scanner for binary captures read from a target
+ */
+#include "logstream.h"
+
+#include "crc16.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    // Largest value that can be carried by a single fixed-size TLV argument
+    constexpr int maxValueSize = sizeof(uint64_t);
+
+    // Longest a live stream may hold up the scan on an incomplete candidate
+    // record (i.e. a corrupt sync word, with a length field running far past
+    // the data received), before it's treated as invalid.
+    constexpr int pendingTimeoutMs = 1000;
+
+    int64_t NowMs()
+    {
+        struct timespec stNow;
+        clock_gettime(CLOCK_MONOTONIC, &stNow);
+        return ((int64_t)stNow.tv_sec * 1000) + (stNow.tv_nsec / 1000000);
+    }
+
+    inline uint16_t ReadU16(const uint8_t* pu8Data_)
+    {
+        return (uint16_t)(pu8Data_[0] | (pu8Data_[1] << 8));
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+LogStream::LogStream(const char* szPath_)
+: m_szPath{szPath_}
+, m_fd{-1}
+, m_bInit{false}
+, m_bEof{false}
+, m_pu8Buf{nullptr}
+, m_bOwnBuf{true}
+, m_uHead{0}
+, m_uTail{0}
+, m_u64Skipped{0}
+, m_u64Total{0}
+, m_u8Shard{0}
+, m_bRequireCrc{false}
+, m_u64CrcErrors{0}
+, m_u64Lost{0}
+, m_pclDecompressor{nullptr}
+, m_pu8Compressed{nullptr}
+, m_uCompressed{0}
+, m_bWaiting{false}
+, m_i64WaitStartMs{0}
+{
+    memset(m_ai32Sequence, 0xFF, sizeof(m_ai32Sequence));
+}
+
+//---------------------------------------------------------------------------
+LogStream::LogStream(const uint8_t* pu8Data_, size_t uLen_)
+: m_szPath{nullptr}
+, m_fd{-1}
+, m_bInit{true}
+, m_bEof{true}
+, m_pu8Buf{const_cast<uint8_t*>(pu8Data_)}
+, m_bOwnBuf{false}
+, m_uHead{0}
+, m_uTail{uLen_}
+, m_u64Skipped{0}
+, m_u64Total{uLen_}
+, m_u8Shard{0}
+, m_bRequireCrc{false}
+, m_u64CrcErrors{0}
+, m_u64Lost{0}
+, m_pclDecompressor{nullptr}
+, m_pu8Compressed{nullptr}
+, m_uCompressed{0}
+, m_bWaiting{false}
+, m_i64WaitStartMs{0}
+{
+    memset(m_ai32Sequence, 0xFF, sizeof(m_ai32Sequence));
+}
+
+//---------------------------------------------------------------------------
+LogStream::~LogStream()
+{
+    if (m_fd > STDIN_FILENO) {
+        close(m_fd);
+    }
+    if (m_bOwnBuf) {
+        free(m_pu8Buf);
+    }
+    free(m_pu8Compressed);
+}
+
+//---------------------------------------------------------------------------
+bool LogStream::Init()
+{
+    if (m_bInit) {
+        return true;
+    }
+
+    if (!strcmp(m_szPath, "-")) {
+        m_fd = STDIN_FILENO;
+    } else {
+        m_fd = open(m_szPath, O_RDONLY);
+    }
+    if (m_fd < 0) {
+        return false;
+    }
+
+    m_pu8Buf = (uint8_t*)malloc(m_uBufferSize);
+    if (!m_pu8Buf) {
+        return false;
+    }
+    if (m_pclDecompressor) {
+        m_pu8Compressed = (uint8_t*)malloc(m_uBufferSize);
+        if (!m_pu8Compressed) {
+            return false;
+        }
+    }
+
+    m_bInit = true;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool LogStream::Fill()
+{
+    if (m_bEof) {
+        return false;
+    }
+
+    // Move any partial record to the front of the buffer, then top it up
+    if (m_uHead) {
+        memmove(m_pu8Buf, &m_pu8Buf[m_uHead], m_uTail - m_uHead);
+        m_uTail -= m_uHead;
+        m_uHead = 0;
+    }
+    if (m_pclDecompressor) {
+        return FillCompressed();
+    }
+
+    // A single read per fill, so data arriving on a pipe is processed as soon
+    // as it's available rather than once the buffer is full.
+    auto nr = read(m_fd, &m_pu8Buf[m_uTail], m_uBufferSize - m_uTail);
+    if (nr <= 0) {
+        m_bEof = true;
+        return true;
+    }
+    m_uTail += nr;
+    m_u64Total += nr;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool LogStream::FillCompressed()
+{
+    ssize_t nr = 0;
+    if (m_uCompressed < m_uBufferSize) {
+        nr = read(m_fd, &m_pu8Compressed[m_uCompressed], m_uBufferSize - m_uCompressed);
+        if (nr > 0) {
+            m_uCompressed += nr;
+            m_u64Total += nr;
+        }
+    }
+
+    // Blocks are decompressed whole; a partial block waits for the next read
+    size_t uConsumed;
+    auto uOut = m_pclDecompressor->Decompress(m_pu8Compressed, m_uCompressed, &uConsumed, &m_pu8Buf[m_uTail],
+                                              m_uBufferSize - m_uTail);
+    memmove(m_pu8Compressed, &m_pu8Compressed[uConsumed], m_uCompressed - uConsumed);
+    m_uCompressed -= uConsumed;
+    m_uTail += uOut;
+    if ((nr <= 0) && !uOut) {
+        m_bEof = true;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool LogStream::WaitForData()
+{
+    if (!m_bWaiting) {
+        m_bWaiting = true;
+        m_i64WaitStartMs = NowMs();
+    }
+    auto i64Remaining = pendingTimeoutMs - (NowMs() - m_i64WaitStartMs);
+    if (i64Remaining <= 0) {
+        return false;
+    }
+    // Errors and hang-ups are left for the read to report
+    struct pollfd stPoll = { m_fd, POLLIN, 0 };
+    return poll(&stPoll, 1, (int)i64Remaining) != 0;
+}
+
+//---------------------------------------------------------------------------
+int LogStream::Decode(const uint8_t* pu8Data_, size_t uLen_, LogRecord* pstRecord_)
+{
+    if (uLen_ < RECORD_MIN_SIZE) {
+        return 0;
+    }
+    if (ReadU16(pu8Data_) != TOKEN_RECORD_START) {
+        return -1;
+    }
+
+    LogHeader_t header;
+    memcpy(&header, &pu8Data_[sizeof(uint16_t)], sizeof(header));
+    auto flags = (uint8_t)(header.log_count & ~log_count_mask);
+    header.log_count &= log_count_mask;
+
+    auto idx = sizeof(uint16_t) + sizeof(LogHeader_t);
+    uint16_t sequence = 0;
+    if (flags & log_flag_sequence) {
+        if ((idx + sizeof(uint16_t)) > uLen_) {
+            return 0;
+        }
+        sequence = ReadU16(&pu8Data_[idx]);
+        idx += sizeof(uint16_t);
+    }
+    auto argStart = idx;
+    auto lastArg = idx;
+
+    // Walk the TLV headers to find the end of the record
+    for (auto i = 0; i < header.log_count; i++) {
+        if (idx >= uLen_) {
+            return 0;
+        }
+        lastArg = idx;
+        auto tag = pu8Data_[idx] & ((1 << tag_bits) - 1);
+        auto length = pu8Data_[idx] >> tag_bits;
+        if ((tag > (int)LogTag::LogTagBlob) || (length == 0) || (length > maxValueSize)) {
+            return -1;
+        }
+        if (tag == (int)LogTag::LogTagStrcopy) {
+            // The TLV carries a length byte, followed by that many characters
+            if (length != sizeof(uint8_t)) {
+                return -1;
+            }
+            if ((idx + 1) >= uLen_) {
+                return 0;
+            }
+            length += pu8Data_[idx + 1];
+        } else if (tag == (int)LogTag::LogTagBlob) {
+            // The TLV carries a 16-bit length, followed by that many bytes
+            if (length != sizeof(uint16_t)) {
+                return -1;
+            }
+            if ((idx + 2) >= uLen_) {
+                return 0;
+            }
+            length += ReadU16(&pu8Data_[idx + 1]);
+        }
+        idx += sizeof(uint8_t) + length;
+    }
+
+    auto end = idx + ((flags & log_flag_crc) ? sizeof(uint16_t) : 0);
+    if ((end + sizeof(uint16_t)) > uLen_) {
+        return 0;
+    }
+    if (ReadU16(&pu8Data_[end]) != TOKEN_RECORD_END) {
+        return -1;
+    }
+    if ((flags & log_flag_crc)
+        && (crc16_update(crc16_init, &pu8Data_[sizeof(uint16_t)], idx - sizeof(uint16_t)) != ReadU16(&pu8Data_[idx]))) {
+        return -2;
+    }
+
+    // A suppressed-call count is carried as the last argument, which isn't
+    // part of the site's format
+    auto argEnd = idx;
+    uint32_t suppressed = 0;
+    if (flags & log_flag_suppressed) {
+        if (!header.log_count
+            || (pu8Data_[lastArg] != tlv_byte(LogTag::LogTagUint32, SizeTag::LogTagUint32))) {
+            return -1;
+        }
+        memcpy(&suppressed, &pu8Data_[lastArg + 1], sizeof(suppressed));
+        header.log_count--;
+        argEnd = lastArg;
+    }
+
+    pstRecord_->header = header;
+    pstRecord_->timestamp = header.timestamp;
+    pstRecord_->args = &pu8Data_[argStart];
+    pstRecord_->argBytes = argEnd - argStart;
+    pstRecord_->wireBytes = end + sizeof(uint16_t);
+    pstRecord_->shard = 0;
+    pstRecord_->flags = flags;
+    pstRecord_->sequence = sequence;
+    pstRecord_->suppressed = suppressed;
+    return 1;
+}
+
+//---------------------------------------------------------------------------
+void LogStream::HandleSystemRecord(LogRecord* pstRecord_)
+{
+    LogArgReader clReader(*pstRecord_);
+    LogArg stArg;
+    switch ((LogSystemRecord)pstRecord_->header.line) {
+        case LogSystemRecord::ClockSync: {
+            if (clReader.Next(&stArg)) {
+                m_clClock.Sync(pstRecord_->timestamp, stArg.AsUnsigned());
+            }
+        } break;
+        case LogSystemRecord::Shard: {
+            if (clReader.Next(&stArg)) {
+                m_u8Shard = (uint8_t)stArg.AsUnsigned();
+            }
+        } break;
+        case LogSystemRecord::ClockRate: {
+            if (clReader.Next(&stArg) && stArg.AsUnsigned()) {
+                m_clClock.SetUsPerTick(1e6 / stArg.AsUnsigned());
+            }
+            if (clReader.Next(&stArg)) {
+                pstRecord_->timestamp = stArg.AsUnsigned();
+                m_clClock.Rebase(pstRecord_->timestamp);
+            }
+        } break;
+        case LogSystemRecord::PostMortem: {
+            // Records recovered from before a reset have a timeline (and
+            // sequence) of their own
+            m_clClock.Restart();
+            m_ai32Sequence[m_u8Shard] = -1;
+        } break;
+        default:
+            break;
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogStream::CheckSequence(const LogRecord& stRecord_)
+{
+    auto& i32Expected = m_ai32Sequence[stRecord_.shard];
+    if (i32Expected >= 0) {
+        auto u16Gap = (uint16_t)(stRecord_.sequence - i32Expected);
+        if (u16Gap < 0x8000) {
+            m_u64Lost += u16Gap;
+        }
+    }
+    i32Expected = (uint16_t)(stRecord_.sequence + 1);
+}
+
+//---------------------------------------------------------------------------
+const char* LogSystemRecordName(uint16_t u16Type_)
+{
+    switch ((LogSystemRecord)u16Type_) {
+        case LogSystemRecord::ClockSync: return "clock-sync";
+        case LogSystemRecord::ClockRate: return "clock-rate";
+        case LogSystemRecord::Shard: return "shard";
+        case LogSystemRecord::PostMortem: return "post-mortem";
+        case LogSystemRecord::Trigger: return "trigger";
+        case LogSystemRecord::Repeat: return "repeat";
+        case LogSystemRecord::ScopeBegin: return "scope-begin";
+        case LogSystemRecord::ScopeEnd: return "scope-end";
+        case LogSystemRecord::Metric: return "metric";
+        case LogSystemRecord::Stats: return "stats";
+        case LogSystemRecord::SiteFilter: return "site-filter";
+        default: return "unknown";
+    }
+}
+
+//---------------------------------------------------------------------------
+bool LogStream::Next(LogRecord* pstRecord_)
+{
+    if (!m_bInit) {
+        return false;
+    }
+
+    while (true) {
+        auto rc = Decode(&m_pu8Buf[m_uHead], m_uTail - m_uHead, pstRecord_);
+        if (rc > 0) {
+            // In a framed stream, a record without a CRC is most likely garbage
+            // that happens to look like one.
+            if (pstRecord_->flags & log_flag_crc) {
+                m_bRequireCrc = true;
+            } else if (m_bRequireCrc) {
+                rc = -1;
+            }
+        }
+        if (rc == -2) {
+            m_u64CrcErrors++;
+        }
+        if ((rc == 0) && (m_uHead == m_uTail)) {
+            if (!Fill()) {
+                return false;
+            }
+            continue;
+        }
+        if ((rc == 0) && (m_bEof || !WaitForData())) {
+            // A candidate still incomplete at the end of the capture (or after
+            // waiting too long on a live stream) can't be a record: resync past
+            // it, rather than discarding everything that follows it.
+            rc = -1;
+        }
+        if (rc > 0) {
+            m_bWaiting = false;
+            m_uHead += pstRecord_->wireBytes;
+            pstRecord_->timestamp = m_clClock.Unwrap(pstRecord_->header.timestamp);
+            if (pstRecord_->header.file_id == system_file_id) {
+                HandleSystemRecord(pstRecord_);
+            }
+            pstRecord_->shard = m_u8Shard;
+            if (pstRecord_->flags & log_flag_sequence) {
+                CheckSequence(*pstRecord_);
+            }
+            return true;
+        }
+        if (rc < 0) {
+            // Skip ahead to the next candidate sync word
+            auto* pu8Start = &m_pu8Buf[m_uHead + 1];
+            auto* pu8Sync = (const uint8_t*)memchr(pu8Start, TOKEN_RECORD_START & 0xFF, m_uTail - (m_uHead + 1));
+            auto skip = 1 + (pu8Sync ? (pu8Sync - pu8Start) : (m_uTail - (m_uHead + 1)));
+            m_bWaiting = false;
+            m_uHead += skip;
+            m_u64Skipped += skip;
+            continue;
+        }
+        Fill();
+    }
+}
+
+//---------------------------------------------------------------------------
+uint64_t LogArg::AsUnsigned() const
+{
+    uint64_t u64Value = 0;
+    memcpy(&u64Value, value, (length < sizeof(u64Value)) ? length : sizeof(u64Value));
+    return u64Value;
+}
+
+//---------------------------------------------------------------------------
+int64_t LogArg::AsSigned() const
+{
+    auto u64Value = AsUnsigned();
+    if ((length < sizeof(u64Value)) && (u64Value & (1ULL << ((length * 8) - 1)))) {
+        u64Value |= ~0ULL << (length * 8);
+    }
+    return (int64_t)u64Value;
+}
+
+//---------------------------------------------------------------------------
+double LogArg::AsDouble() const
+{
+    switch (tag) {
+        case LogTag::LogTagFloat:
+        case LogTag::LogTagDouble: {
+            // Some targets (i.e. AVR) implement double as a 32-bit float
+            if (length == sizeof(float)) {
+                float fValue;
+                memcpy(&fValue, value, sizeof(fValue));
+                return fValue;
+            }
+            double dValue = 0;
+            memcpy(&dValue, value, (length < sizeof(dValue)) ? length : sizeof(dValue));
+            return dValue;
+        }
+        case LogTag::LogTagInt8:
+        case LogTag::LogTagInt16:
+        case LogTag::LogTagInt32:
+        case LogTag::LogTagInt64:
+        case LogTag::LogTagChar:
+            return (double)AsSigned();
+        default:
+            return (double)AsUnsigned();
+    }
+}
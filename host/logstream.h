@@ -0,0 +1,282 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logstream.h Raw record scanner for binary captures read from a target
+ */
+#pragma once
+
+#include "logdecompress.h"
+#include "logtypes.h"
+#include "tickclock.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+// Sync words framing each record written by LogBuf on the target
+constexpr uint16_t TOKEN_RECORD_START = 0xCAFE;
+constexpr uint16_t TOKEN_RECORD_END = 0xF00D;
+
+//---------------------------------------------------------------------------
+// Wire overhead of a record carrying no arguments: sync words + header
+constexpr size_t RECORD_MIN_SIZE = (2 * sizeof(uint16_t)) + sizeof(LogHeader_t);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogRecord struct
+ *
+ * View of a single record found in a capture.  The header is copied out of
+ * the stream, while the argument data points directly into the scanner's
+ * buffer, and is only valid until the next call to LogStream::Next().
+ */
+struct LogRecord {
+    LogHeader_t     header;     //!< Record header, with flags cleared from log_count (and the suppressed-call count excluded)
+    uint64_t        timestamp;  //!< header.timestamp, unwrapped onto a monotonic 64-bit timeline
+    const uint8_t*  args;       //!< TLV-encoded argument data
+    uint32_t        argBytes;   //!< Length of the TLV-encoded argument data
+    uint32_t        wireBytes;  //!< Length of the record on the wire, including sync words
+    uint8_t         shard;      //!< Target buffer (shard) the record was flushed from
+    uint8_t         flags;      //!< Flags (log_flag_suppressed, log_flag_sequence, log_flag_crc) from the wire log_count
+    uint16_t        sequence;   //!< Sequence number, if flagged by log_flag_sequence
+    uint32_t        suppressed; //!< Calls to the site suppressed since its previous record, if flagged by log_flag_suppressed
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogArg struct
+ *
+ * View of a single TLV-encoded argument within a record.  For TagStrcopy and
+ * TagBlob arguments, value and length describe the copied characters or bytes
+ * (strings are not nul-terminated).
+ */
+struct LogArg {
+    LogTag          tag;
+    uint16_t        length;
+    const uint8_t*  value;
+
+    uint64_t AsUnsigned() const;    //!< Value zero-extended to 64 bits
+    int64_t AsSigned() const;       //!< Value sign-extended to 64 bits
+    double AsDouble() const;        //!< Value converted to double, based on its tag
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogArgReader class
+ *
+ * Iterates over the arguments of a record previously validated by LogStream.
+ */
+class LogArgReader {
+public:
+    LogArgReader(const LogRecord& stRecord_)
+    : m_pu8Data{stRecord_.args}
+    , m_iRemaining{stRecord_.header.log_count}
+    {}
+
+    /**
+     * @brief Next
+     * @param pstArg_ Argument view to populate
+     * @return true if an argument was returned, false if none remain
+     */
+    bool Next(LogArg* pstArg_)
+    {
+        if (!m_iRemaining) {
+            return false;
+        }
+        m_iRemaining--;
+        pstArg_->tag = (LogTag)(*m_pu8Data & ((1 << tag_bits) - 1));
+        if (pstArg_->tag == LogTag::LogTagStrcopy) {
+            // Copied strings carry their own length byte, ahead of the characters
+            pstArg_->length = m_pu8Data[1];
+            pstArg_->value = m_pu8Data + 2;
+            m_pu8Data += 2 + pstArg_->length;
+            return true;
+        }
+        if (pstArg_->tag == LogTag::LogTagBlob) {
+            // Blobs carry a 16-bit (little-endian) length, ahead of the bytes
+            pstArg_->length = (uint16_t)(m_pu8Data[1] | (m_pu8Data[2] << 8));
+            pstArg_->value = m_pu8Data + 3;
+            m_pu8Data += 3 + pstArg_->length;
+            return true;
+        }
+        pstArg_->length = *m_pu8Data >> tag_bits;
+        pstArg_->value = m_pu8Data + 1;
+        m_pu8Data += 1 + pstArg_->length;
+        return true;
+    }
+
+private:
+    const uint8_t*  m_pu8Data;
+    int             m_iRemaining;
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogStream class
+ *
+ * Scans a binary capture (file or pipe) for framed LogBuf records without
+ * interpreting their contents beyond what is required to validate framing.
+ * Data is read in large blocks and records are validated in-place, so the
+ * scan runs at close to memory bandwidth.  Corrupt or torn data is skipped
+ * up to the next candidate sync word until a valid record is found.  A
+ * candidate that claims more data than the capture holds is skipped the same
+ * way, so a corrupt length field can't hide the records that follow it; on a
+ * live stream, a candidate still incomplete after a short timeout is skipped.
+ *
+ * Records from targets built with LOGBUF_FRAMING carry a CRC, which must
+ * match for the record to be accepted, and a per-shard sequence number, used
+ * to count the records lost between those accepted.  Once a record with a CRC
+ * has been seen, records without one are rejected.
+ */
+class LogStream {
+public:
+    /**
+     * @brief LogStream
+     * @param szPath_ Path to the capture to read, or "-" to read from stdin
+     */
+    LogStream(const char* szPath_);
+
+    /**
+     * @brief LogStream
+     *
+     * Scan a capture that's already in memory, without copying it.
+     *
+     * @param pu8Data_ Capture data (must outlive the LogStream object)
+     * @param uLen_ Length of the capture data
+     */
+    LogStream(const uint8_t* pu8Data_, size_t uLen_);
+    ~LogStream();
+
+    /**
+     * @brief SetDecompressor
+     *
+     * Read a capture written through a LogCompressor, decompressing it with
+     * the given decompressor.  Must be called before Init().
+     *
+     * @param pclDecompressor_ Decompressor to use (must outlive the LogStream
+     *        object)
+     */
+    void SetDecompressor(LogDecompressor* pclDecompressor_) { m_pclDecompressor = pclDecompressor_; }
+
+    /**
+     * @brief Init
+     *
+     * Open the capture and allocate the scan buffer.
+     *
+     * @return true on success
+     */
+    bool Init();
+
+    /**
+     * @brief Next
+     *
+     * Find and return the next valid record in the stream.
+     *
+     * @param pstRecord_ Record view to populate
+     * @return true if a record was returned, false at end-of-stream
+     */
+    bool Next(LogRecord* pstRecord_);
+
+    /**
+     * @brief GetSkippedBytes
+     * @return Number of bytes discarded while searching for valid records
+     */
+    uint64_t GetSkippedBytes() const { return m_u64Skipped; }
+
+    /**
+     * @brief GetTotalBytes
+     * @return Number of bytes read from the capture so far (before decompression)
+     */
+    uint64_t GetTotalBytes() const { return m_u64Total; }
+
+    /**
+     * @brief GetCrcErrors
+     * @return Number of otherwise well-formed records rejected for a CRC mismatch
+     */
+    uint64_t GetCrcErrors() const { return m_u64CrcErrors; }
+
+    /**
+     * @brief GetLostRecords
+     *
+     * Return the number of records missing from the capture, as counted from
+     * gaps in the sequence numbers of the records accepted.  A sequence number
+     * lower than expected (i.e. following a target reset) is treated as a
+     * restart of the sequence, rather than a loss.
+     *
+     * @return Number of records lost
+     */
+    uint64_t GetLostRecords() const { return m_u64Lost; }
+
+    /**
+     * @brief GetClock
+     *
+     * Clock used to unwrap record timestamps, synchronized using any clock-sync
+     * records found in the capture.
+     *
+     * @return Reference to the stream's clock
+     */
+    TickClock& GetClock() { return m_clClock; }
+
+    /**
+     * @brief Decode
+     *
+     * Validate the framing of a record at the start of a block of memory.
+     *
+     * @param pu8Data_ Data to validate
+     * @param uLen_ Number of bytes available
+     * @param pstRecord_ Record view to populate on success
+     * @return 1 on success, 0 if more data is required, -1 if the data at this
+     *         location is not a valid record, -2 if it's a well-formed record
+     *         whose CRC doesn't match
+     */
+    static int Decode(const uint8_t* pu8Data_, size_t uLen_, LogRecord* pstRecord_);
+
+private:
+    bool Fill();
+    bool FillCompressed();
+    bool WaitForData();
+    void HandleSystemRecord(LogRecord* pstRecord_);
+    void CheckSequence(const LogRecord& stRecord_);
+
+    static constexpr size_t m_uBufferSize = (1024 * 1024);
+
+    const char* m_szPath;
+    int         m_fd;
+    bool        m_bInit;
+    bool        m_bEof;
+    uint8_t*    m_pu8Buf;
+    bool        m_bOwnBuf;
+    size_t      m_uHead;
+    size_t      m_uTail;
+    uint64_t    m_u64Skipped;
+    uint64_t    m_u64Total;
+    TickClock   m_clClock;
+    uint8_t     m_u8Shard;
+    bool        m_bRequireCrc;
+    uint64_t    m_u64CrcErrors;
+    uint64_t    m_u64Lost;
+    LogDecompressor* m_pclDecompressor;
+    uint8_t*    m_pu8Compressed;        //!< Compressed data read, but not yet decompressed
+    size_t      m_uCompressed;
+    int32_t     m_ai32Sequence[UINT8_MAX + 1];  //!< Next sequence number expected from each shard (-1: unknown)
+    bool        m_bWaiting;             //!< Waiting for the rest of the candidate record at m_uHead
+    int64_t     m_i64WaitStartMs;
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief LogSystemRecordName
+ * @param u16Type_ Type of system record (the line field of a record from system_file_id)
+ * @return Printable name of the record type
+ */
+const char* LogSystemRecordName(uint16_t u16Type_);
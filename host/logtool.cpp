@@ -0,0 +1,668 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logtool.cpp Host-side tool for processing binary captures from a target
+
+  Usage: logtool <mode> [options] <logger.bin> <capture.bin|->
+
+  Modes:
+    decode  Render records as human-readable text
+    stats   Per-site traffic statistics ("top talkers") from a raw capture
+    gen     Synthetic target-stream generator (takes only <logger.bin>)
+    trace   Chrome Trace / Perfetto JSON export of decoded records
+    scopes  Duration histograms of scopes traced with TRACE_SCOPE()
+    metrics CSV time series of metric summaries (LOG_COUNTER() etc.)
+    sites   List, enable or disable the target's log sites at runtime (LOGBUF_SITE_FILTER)
+ */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <termios.h>
+
+#include "elfimage.h"
+#include "flightdump.h"
+#include "logcompress.h"
+#include "logdecoder.h"
+#include "logdecompress.h"
+#include "logmerge.h"
+#include "loggen.h"
+#include "loggerparser.h"
+#include "logstream.h"
+#include "metricseries.h"
+#include "scopestats.h"
+#include "sitefilter.h"
+#include "sitestats.h"
+#include "traceexport.h"
+
+//---------------------------------------------------------------------------
+namespace {
+    void Usage()
+    {
+        printf("usage: logtool <mode> [options] <logger.bin> <capture.bin|->\n");
+        printf("\n");
+        printf("modes:\n");
+        printf("  decode [-u us_per_tick] [-e elf] [-m] [-p [-a]] [-Z] render records as text\n");
+        printf("  stats  [-w window_ticks] [-n top] [-Z] per-site traffic statistics\n");
+        printf("  trace  [-u us_per_tick] [-s] [-e elf] [-m] [-Z] Chrome Trace JSON export (-s: one track per site)\n");
+        printf("  scopes [-u us_per_tick] [-Z]         duration histograms of traced scopes (TRACE_SCOPE())\n");
+        printf("  metrics [-u us_per_tick] [-Z]        CSV time series of metric summaries (LOG_COUNTER() etc.)\n");
+        printf("  sites  -e elf [-o output] <logger.bin> [enable|disable <selector>...]\n");
+        printf("         list the target's sites, or enable/disable them at runtime (LOGBUF_SITE_FILTER);\n");
+        printf("         selectors: all, #index, file:line, file, fmt:substring;\n");
+        printf("         -o output: the target's receive path (device, pipe or file), or stdout\n");
+        printf("  gen    [options] <logger.bin>        synthetic capture generator\n");
+        printf("         -n records  -r records/s  -u us_per_tick  -T start_tick  -S seed\n");
+        printf("         -z zipf_skew  -v uniform|small|counter  -b period_s:length_s:factor\n");
+        printf("         -c corrupt_prob  -w overwrite_prob  -s sync_period_s  -e epoch_us\n");
+        printf("         -o output (file, pipe or tty)  -P (create a pty)  -p (pace in real time)\n");
+        printf("         -F (add sequence numbers and CRCs, as LOGBUF_FRAMING)  -Z (compress, as LogCompressor)\n");
+        printf("\n");
+        printf("  -e elf: target image used to resolve strings logged with TagString, and symbolize pointers\n");
+        printf("  -m: merge records from sharded target buffers into timestamp order\n");
+        printf("  -Z: capture was written through the target's LogCompressor\n");
+        printf("  -p: capture is a RAM dump holding the target's flight recorder (LOGBUF_NOINIT);\n");
+        printf("      decode its unflushed records (-a: all records surviving in the ring)\n");
+    }
+
+    //---------------------------------------------------------------------------
+    bool OpenInputs(LoggerParser* pclDictionary_, LogStream* pclStream_, char** argv)
+    {
+        if (!pclDictionary_->Init()) {
+            fprintf(stderr, "error opening %s\n", argv[0]);
+            return false;
+        }
+        pclDictionary_->Parse();
+
+        if (!pclStream_->Init()) {
+            fprintf(stderr, "error opening %s\n", argv[1]);
+            return false;
+        }
+        return true;
+    }
+
+    //---------------------------------------------------------------------------
+    bool OpenImage(ElfImage* pclImage_, const char* szPath_)
+    {
+        if (szPath_ && !pclImage_->Init()) {
+            fprintf(stderr, "error reading %s\n", szPath_);
+            return false;
+        }
+        return true;
+    }
+
+    //---------------------------------------------------------------------------
+    bool WriteAll(int fd_, const uint8_t* pu8Data_, size_t uLen_)
+    {
+        while (uLen_) {
+            auto nw = write(fd_, pu8Data_, uLen_);
+            if (nw <= 0) {
+                return false;
+            }
+            pu8Data_ += nw;
+            uLen_ -= nw;
+        }
+        return true;
+    }
+
+    //---------------------------------------------------------------------------
+    // Generated records are compressed in flushes of the size at which the
+    // target requests a flush by default (half of its 512-byte ring).
+    constexpr size_t compressedFlushSize = 256;
+
+    int iCompressedFd = -1;
+    bool bCompressedOk = true;
+
+    void CompressedWriter(const uint8_t* pu8Data_, size_t uLen_)
+    {
+        bCompressedOk = bCompressedOk && WriteAll(iCompressedFd, pu8Data_, uLen_);
+    }
+
+    bool WriteOutput(int fd_, const uint8_t* pu8Data_, size_t uLen_, LogCompressor* pclCompressor_)
+    {
+        if (!pclCompressor_) {
+            return WriteAll(fd_, pu8Data_, uLen_);
+        }
+        iCompressedFd = fd_;
+        for (size_t uOffset = 0; uOffset < uLen_; uOffset += compressedFlushSize) {
+            auto uChunk = uLen_ - uOffset;
+            if (uChunk > compressedFlushSize) {
+                uChunk = compressedFlushSize;
+            }
+            pclCompressor_->Write(CompressedWriter, &pu8Data_[uOffset], uChunk);
+            pclCompressor_->Flush(CompressedWriter);
+        }
+        return bCompressedOk;
+    }
+
+    //---------------------------------------------------------------------------
+    double ElapsedUs(const struct timespec& stStart_)
+    {
+        struct timespec stNow;
+        clock_gettime(CLOCK_MONOTONIC, &stNow);
+        return ((stNow.tv_sec - stStart_.tv_sec) * 1e6) + ((stNow.tv_nsec - stStart_.tv_nsec) / 1e3);
+    }
+
+    //---------------------------------------------------------------------------
+    // Open a pseudo-terminal in raw mode, standing in for a target's serial port
+    int OpenPty()
+    {
+        auto fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if ((fd < 0) || grantpt(fd) || unlockpt(fd)) {
+            return -1;
+        }
+        struct termios stTermios;
+        if (!tcgetattr(fd, &stTermios)) {
+            cfmakeraw(&stTermios);
+            tcsetattr(fd, TCSANOW, &stTermios);
+        }
+        fprintf(stderr, "pty: %s\n", ptsname(fd));
+        return fd;
+    }
+
+    //---------------------------------------------------------------------------
+    int GenMode(int argc, char** argv)
+    {
+        GenConfig stConfig;
+        const char* szOutput = nullptr;
+        auto bPty = false;
+        auto bPace = false;
+        auto bCompress = false;
+        int opt;
+        while ((opt = getopt(argc, argv, "n:r:u:T:S:z:v:b:c:w:s:e:o:PpFZ")) != -1) {
+            switch (opt) {
+                case 'n': stConfig.u64Records = strtoull(optarg, nullptr, 0); break;
+                case 'r': stConfig.dRate = strtod(optarg, nullptr); break;
+                case 'u': stConfig.dUsPerTick = strtod(optarg, nullptr); break;
+                case 'T': stConfig.u32StartTick = strtoul(optarg, nullptr, 0); break;
+                case 'S': stConfig.u64Seed = strtoull(optarg, nullptr, 0); break;
+                case 'z': stConfig.dZipf = strtod(optarg, nullptr); break;
+                case 'c': stConfig.dCorrupt = strtod(optarg, nullptr); break;
+                case 'w': stConfig.dOverwrite = strtod(optarg, nullptr); break;
+                case 's': stConfig.dSyncPeriod = strtod(optarg, nullptr); break;
+                case 'e': stConfig.u64EpochUs = strtoull(optarg, nullptr, 0); break;
+                case 'o': szOutput = optarg; break;
+                case 'P': bPty = true; break;
+                case 'p': bPace = true; break;
+                case 'F': stConfig.bFramed = true; break;
+                case 'Z': bCompress = true; break;
+                case 'v': {
+                    if (!strcmp(optarg, "uniform")) {
+                        stConfig.eValues = GenValues::Uniform;
+                    } else if (!strcmp(optarg, "counter")) {
+                        stConfig.eValues = GenValues::Counter;
+                    } else {
+                        stConfig.eValues = GenValues::Small;
+                    }
+                } break;
+                case 'b': {
+                    if (sscanf(optarg, "%lf:%lf:%lf", &stConfig.dBurstPeriod, &stConfig.dBurstLength, &stConfig.dBurstFactor) < 2) {
+                        Usage();
+                        return -1;
+                    }
+                } break;
+                default: Usage(); return -1;
+            }
+        }
+        if ((argc - optind) != 1) {
+            Usage();
+            return -1;
+        }
+
+        LoggerParser clDictionary(argv[optind]);
+        if (!clDictionary.Init()) {
+            fprintf(stderr, "error opening %s\n", argv[optind]);
+            return -1;
+        }
+        clDictionary.Parse();
+
+        LogGenerator clGenerator(&clDictionary, stConfig);
+        if (!clGenerator.Init()) {
+            fprintf(stderr, "no log sites found in %s\n", argv[optind]);
+            return -1;
+        }
+
+        auto fd = STDOUT_FILENO;
+        if (bPty) {
+            fd = OpenPty();
+        } else if (szOutput) {
+            fd = open(szOutput, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644);
+        }
+        if (fd < 0) {
+            fprintf(stderr, "error opening output\n");
+            return -1;
+        }
+
+        // Records are batched into large writes, unless pacing output in real
+        // time, in which case the batch is written out before each sleep.
+        constexpr size_t uBatchSize = 64 * 1024;
+        auto* pu8Batch = (uint8_t*)malloc(uBatchSize);
+        LogCompressor clCompressor;
+        auto* pclCompressor = bCompress ? &clCompressor : nullptr;
+        size_t uBatch = 0;
+        struct timespec stStart;
+        clock_gettime(CLOCK_MONOTONIC, &stStart);
+
+        auto bOk = true;
+        while (bOk) {
+            if ((uBatch + GEN_MAX_RECORD_SIZE) > uBatchSize) {
+                bOk = WriteOutput(fd, pu8Batch, uBatch, pclCompressor);
+                uBatch = 0;
+            }
+            auto uLen = clGenerator.Next(&pu8Batch[uBatch]);
+            if (!uLen) {
+                break;
+            }
+            uBatch += uLen;
+
+            if (bPace) {
+                auto dAheadUs = clGenerator.GetTimeUs() - ElapsedUs(stStart);
+                if (dAheadUs > 1000.0) {
+                    bOk = WriteOutput(fd, pu8Batch, uBatch, pclCompressor);
+                    uBatch = 0;
+                    usleep((useconds_t)dAheadUs);
+                }
+            }
+        }
+        if (bOk) {
+            bOk = WriteOutput(fd, pu8Batch, uBatch, pclCompressor);
+        }
+        free(pu8Batch);
+
+        if (fd != STDOUT_FILENO) {
+            close(fd);
+        }
+        return bOk ? 0 : -1;
+    }
+
+    //---------------------------------------------------------------------------
+    int DecodeMode(int argc, char** argv)
+    {
+        auto dUsPerTick = 1000.0;
+        const char* szImage = nullptr;
+        auto bMerge = false;
+        auto bDump = false;
+        auto bAll = false;
+        auto bCompressed = false;
+        int opt;
+        while ((opt = getopt(argc, argv, "u:e:mpaZ")) != -1) {
+            switch (opt) {
+                case 'u': dUsPerTick = strtod(optarg, nullptr); break;
+                case 'e': szImage = optarg; break;
+                case 'm': bMerge = true; break;
+                case 'p': bDump = true; break;
+                case 'a': bAll = true; break;
+                case 'Z': bCompressed = true; break;
+                default: Usage(); return -1;
+            }
+        }
+        if (((argc - optind) != 2) || (bAll && !bDump) || (bCompressed && bDump)) {
+            Usage();
+            return -1;
+        }
+
+        // A RAM dump is reassembled into a capture in memory
+        FlightDump clDump(argv[optind + 1], bAll);
+        if (bDump) {
+            if (!clDump.Init()) {
+                fprintf(stderr, "error opening %s\n", argv[optind + 1]);
+                return -1;
+            }
+            fprintf(stderr, "%d flight recorder(s) found, %zu bytes recovered\n", clDump.GetRecorders(), clDump.GetLength());
+        }
+
+        LoggerParser clDictionary(argv[optind]);
+        LogStream clFileStream(argv[optind + 1]);
+        LogStream clDumpStream(clDump.GetData(), clDump.GetLength());
+        auto& clStream = bDump ? clDumpStream : clFileStream;
+        LogDecompressor clDecompressor;
+        if (bCompressed) {
+            clStream.SetDecompressor(&clDecompressor);
+        }
+        if (!OpenInputs(&clDictionary, &clStream, &argv[optind])) {
+            return -1;
+        }
+        clStream.GetClock().SetUsPerTick(dUsPerTick);
+
+        ElfImage clImage(szImage);
+        if (!OpenImage(&clImage, szImage)) {
+            return -1;
+        }
+
+        LogDecoder clDecoder(&clDictionary, &clStream.GetClock(), szImage ? &clImage : nullptr);
+        LogMerger clMerger(&clStream);
+        LogRecord stRecord;
+        char szLine[1024];
+        while (bMerge ? clMerger.Next(&stRecord) : clStream.Next(&stRecord)) {
+            clDecoder.Render(szLine, sizeof(szLine), stRecord);
+            puts(szLine);
+        }
+        return 0;
+    }
+
+    //---------------------------------------------------------------------------
+    int StatsMode(int argc, char** argv)
+    {
+        uint32_t u32Window = 1000;
+        int iTop = 20;
+        auto bCompressed = false;
+        int opt;
+        while ((opt = getopt(argc, argv, "w:n:Z")) != -1) {
+            switch (opt) {
+                case 'w': u32Window = strtoul(optarg, nullptr, 0); break;
+                case 'n': iTop = atoi(optarg); break;
+                case 'Z': bCompressed = true; break;
+                default: Usage(); return -1;
+            }
+        }
+        if ((argc - optind) != 2) {
+            Usage();
+            return -1;
+        }
+
+        LoggerParser clDictionary(argv[optind]);
+        LogStream clStream(argv[optind + 1]);
+        LogDecompressor clDecompressor;
+        if (bCompressed) {
+            clStream.SetDecompressor(&clDecompressor);
+        }
+        if (!OpenInputs(&clDictionary, &clStream, &argv[optind])) {
+            return -1;
+        }
+
+        SiteStats clStats(u32Window);
+        LogRecord stRecord;
+        while (clStream.Next(&stRecord)) {
+            clStats.Add(stRecord);
+        }
+
+        printf("capture: %llu bytes, %llu skipped, %llu crc errors, %llu records lost\n",
+               (unsigned long long)clStream.GetTotalBytes(),
+               (unsigned long long)clStream.GetSkippedBytes(),
+               (unsigned long long)clStream.GetCrcErrors(),
+               (unsigned long long)clStream.GetLostRecords());
+        if (bCompressed) {
+            printf("compressed: %llu blocks, %llu dropped, %llu bytes skipped, %.2f:1\n",
+                   (unsigned long long)clDecompressor.GetBlocks(),
+                   (unsigned long long)clDecompressor.GetDroppedBlocks(),
+                   (unsigned long long)clDecompressor.GetSkippedBytes(),
+                   clDecompressor.GetCompressedBytes()
+                       ? (double)clDecompressor.GetRawBytes() / clDecompressor.GetCompressedBytes() : 0.0);
+        }
+        clStats.Report(&clDictionary, iTop);
+        return 0;
+    }
+
+    //---------------------------------------------------------------------------
+    int TraceMode(int argc, char** argv)
+    {
+        auto dUsPerTick = 1000.0;
+        auto bPerSite = false;
+        const char* szImage = nullptr;
+        auto bMerge = false;
+        auto bCompressed = false;
+        int opt;
+        while ((opt = getopt(argc, argv, "u:se:mZ")) != -1) {
+            switch (opt) {
+                case 'u': dUsPerTick = strtod(optarg, nullptr); break;
+                case 's': bPerSite = true; break;
+                case 'e': szImage = optarg; break;
+                case 'm': bMerge = true; break;
+                case 'Z': bCompressed = true; break;
+                default: Usage(); return -1;
+            }
+        }
+        if ((argc - optind) != 2) {
+            Usage();
+            return -1;
+        }
+
+        LoggerParser clDictionary(argv[optind]);
+        LogStream clStream(argv[optind + 1]);
+        LogDecompressor clDecompressor;
+        if (bCompressed) {
+            clStream.SetDecompressor(&clDecompressor);
+        }
+        if (!OpenInputs(&clDictionary, &clStream, &argv[optind])) {
+            return -1;
+        }
+
+        ElfImage clImage(szImage);
+        if (!OpenImage(&clImage, szImage)) {
+            return -1;
+        }
+
+        clStream.GetClock().SetUsPerTick(dUsPerTick);
+
+        TraceExporter clExporter(&clDictionary, stdout, &clStream.GetClock(), bPerSite, szImage ? &clImage : nullptr);
+        LogRecord stRecord;
+        LogMerger clMerger(&clStream);
+        clExporter.Begin();
+        while (bMerge ? clMerger.Next(&stRecord) : clStream.Next(&stRecord)) {
+            clExporter.Add(stRecord);
+        }
+        clExporter.End();
+        return 0;
+    }
+
+    //---------------------------------------------------------------------------
+    int ScopesMode(int argc, char** argv)
+    {
+        auto dUsPerTick = 1000.0;
+        auto bCompressed = false;
+        int opt;
+        while ((opt = getopt(argc, argv, "u:Z")) != -1) {
+            switch (opt) {
+                case 'u': dUsPerTick = strtod(optarg, nullptr); break;
+                case 'Z': bCompressed = true; break;
+                default: Usage(); return -1;
+            }
+        }
+        if ((argc - optind) != 2) {
+            Usage();
+            return -1;
+        }
+
+        LoggerParser clDictionary(argv[optind]);
+        LogStream clStream(argv[optind + 1]);
+        LogDecompressor clDecompressor;
+        if (bCompressed) {
+            clStream.SetDecompressor(&clDecompressor);
+        }
+        if (!OpenInputs(&clDictionary, &clStream, &argv[optind])) {
+            return -1;
+        }
+
+        clStream.GetClock().SetUsPerTick(dUsPerTick);
+
+        // Scopes are paired per shard, so the shards needn't be merged
+        ScopeStats clStats(&clStream.GetClock());
+        LogRecord stRecord;
+        while (clStream.Next(&stRecord)) {
+            clStats.Add(stRecord);
+        }
+        clStats.Report(&clDictionary);
+        return 0;
+    }
+
+    //---------------------------------------------------------------------------
+    int MetricsMode(int argc, char** argv)
+    {
+        auto dUsPerTick = 1000.0;
+        auto bCompressed = false;
+        int opt;
+        while ((opt = getopt(argc, argv, "u:Z")) != -1) {
+            switch (opt) {
+                case 'u': dUsPerTick = strtod(optarg, nullptr); break;
+                case 'Z': bCompressed = true; break;
+                default: Usage(); return -1;
+            }
+        }
+        if ((argc - optind) != 2) {
+            Usage();
+            return -1;
+        }
+
+        LoggerParser clDictionary(argv[optind]);
+        LogStream clStream(argv[optind + 1]);
+        LogDecompressor clDecompressor;
+        if (bCompressed) {
+            clStream.SetDecompressor(&clDecompressor);
+        }
+        if (!OpenInputs(&clDictionary, &clStream, &argv[optind])) {
+            return -1;
+        }
+
+        clStream.GetClock().SetUsPerTick(dUsPerTick);
+
+        MetricExporter clExporter(&clDictionary, stdout, &clStream.GetClock());
+        LogRecord stRecord;
+        clExporter.Begin();
+        while (clStream.Next(&stRecord)) {
+            clExporter.Add(stRecord);
+        }
+        return 0;
+    }
+
+    //---------------------------------------------------------------------------
+    int SitesMode(int argc, char** argv)
+    {
+        const char* szImage = nullptr;
+        const char* szOutput = nullptr;
+        int opt;
+        while ((opt = getopt(argc, argv, "e:o:")) != -1) {
+            switch (opt) {
+                case 'e': szImage = optarg; break;
+                case 'o': szOutput = optarg; break;
+                default: Usage(); return -1;
+            }
+        }
+        if (!szImage || ((argc - optind) < 1)) {
+            Usage();
+            return -1;
+        }
+
+        LoggerParser clDictionary(argv[optind]);
+        if (!clDictionary.Init()) {
+            fprintf(stderr, "error opening %s\n", argv[optind]);
+            return -1;
+        }
+        clDictionary.Parse();
+        ElfImage clImage(szImage);
+        if (!OpenImage(&clImage, szImage)) {
+            return -1;
+        }
+        SiteFilter clFilter(&clDictionary, &clImage);
+        if (!clFilter.Init()) {
+            fprintf(stderr, "no logger_sites section in %s (built without LOGBUF_SITE_FILTER?)\n", szImage);
+            return -1;
+        }
+        if ((argc - optind) == 1) {
+            clFilter.List();
+            return 0;
+        }
+
+        auto bEnable = !strcmp(argv[optind + 1], "enable");
+        if ((!bEnable && strcmp(argv[optind + 1], "disable")) || ((argc - optind) < 3)) {
+            Usage();
+            return -1;
+        }
+        auto bAll = false;
+        std::vector<uint16_t> clIndexes;
+        for (auto i = optind + 2; i < argc; i++) {
+            if (!strcmp(argv[i], "all")) {
+                bAll = true;
+            } else if (!clFilter.Select(argv[i], &clIndexes)) {
+                fprintf(stderr, "no sites match %s\n", argv[i]);
+                return -1;
+            }
+        }
+
+        auto fd = STDOUT_FILENO;
+        if (szOutput) {
+            fd = open(szOutput, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644);
+        }
+        if (fd < 0) {
+            fprintf(stderr, "error opening %s\n", szOutput);
+            return -1;
+        }
+        uint8_t au8Frame[COMMAND_FRAME_MAX];
+        auto bOk = true;
+        if (bAll) {
+            auto uLen = SiteFilter::BuildCommand(bEnable ? LogCommand::EnableAll : LogCommand::DisableAll, nullptr, 0, au8Frame);
+            bOk = WriteAll(fd, au8Frame, uLen);
+        }
+        for (size_t uOffset = 0; bOk && !bAll && (uOffset < clIndexes.size()); uOffset += command_max_sites) {
+            auto uCount = clIndexes.size() - uOffset;
+            if (uCount > command_max_sites) {
+                uCount = command_max_sites;
+            }
+            auto uLen = SiteFilter::BuildCommand(bEnable ? LogCommand::EnableSites : LogCommand::DisableSites,
+                                                 &clIndexes[uOffset], (uint8_t)uCount, au8Frame);
+            bOk = WriteAll(fd, au8Frame, uLen);
+        }
+        if (bOk) {
+            fprintf(stderr, "%s %zu sites\n", bEnable ? "enabled" : "disabled", bAll ? clFilter.GetSiteCount() : clIndexes.size());
+        }
+
+        if (fd != STDOUT_FILENO) {
+            close(fd);
+        }
+        return bOk ? 0 : -1;
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        Usage();
+        return -1;
+    }
+
+    // Strip the mode so each handler parses its own options
+    auto* szMode = argv[1];
+    argv[1] = argv[0];
+    argc--;
+    argv++;
+
+    if (!strcmp(szMode, "decode")) {
+        return DecodeMode(argc, argv);
+    }
+    if (!strcmp(szMode, "stats")) {
+        return StatsMode(argc, argv);
+    }
+    if (!strcmp(szMode, "gen")) {
+        return GenMode(argc, argv);
+    }
+    if (!strcmp(szMode, "trace")) {
+        return TraceMode(argc, argv);
+    }
+    if (!strcmp(szMode, "scopes")) {
+        return ScopesMode(argc, argv);
+    }
+    if (!strcmp(szMode, "metrics")) {
+        return MetricsMode(argc, argv);
+    }
+    if (!strcmp(szMode, "sites")) {
+        return SitesMode(argc, argv);
+    }
+    Usage();
+    return -1;
+}
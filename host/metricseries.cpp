@@ -0,0 +1,128 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file metricseries.cpp Decoding of on-target metric summaries into time series
+ */
+#include "metricseries.h"
+
+#include <string.h>
+
+//---------------------------------------------------------------------------
+bool DecodeMetric(const LogRecord& stRecord_, MetricSummary* pstSummary_)
+{
+    if ((stRecord_.header.file_id != system_file_id) || (stRecord_.header.line != (uint16_t)LogSystemRecord::Metric)) {
+        return false;
+    }
+    LogArgReader clArgs(stRecord_);
+    LogArg astArgs[4];
+    auto iCount = 0;
+    while ((iCount < 4) && clArgs.Next(&astArgs[iCount])) {
+        iCount++;
+    }
+    if (!iCount || (astArgs[0].tag != LogTag::LogTagUint32)) {
+        return false;
+    }
+
+    pstSummary_->id = (uint32_t)astArgs[0].AsUnsigned();
+    pstSummary_->buckets.clear();
+    if ((iCount == 2) && (astArgs[1].tag == LogTag::LogTagUint32)) {
+        pstSummary_->type = LogSectionType::Counter;
+        pstSummary_->count = (uint32_t)astArgs[1].AsUnsigned();
+        return true;
+    }
+    if ((iCount == 4) && (astArgs[1].tag == LogTag::LogTagInt32)) {
+        pstSummary_->type = LogSectionType::Gauge;
+        pstSummary_->last = (int32_t)astArgs[1].AsSigned();
+        pstSummary_->min = (int32_t)astArgs[2].AsSigned();
+        pstSummary_->max = (int32_t)astArgs[3].AsSigned();
+        return true;
+    }
+    if ((iCount == 2) && (astArgs[1].tag == LogTag::LogTagBlob)) {
+        pstSummary_->type = LogSectionType::Histogram;
+        for (auto i = 0; (i + sizeof(uint32_t)) <= astArgs[1].length; i += sizeof(uint32_t)) {
+            uint32_t u32Count;
+            memcpy(&u32Count, &astArgs[1].value[i], sizeof(u32Count));
+            pstSummary_->buckets.push_back(u32Count);
+        }
+        return true;
+    }
+    return false;
+}
+
+//---------------------------------------------------------------------------
+MetricExporter::MetricExporter(LoggerParser* pclDictionary_, FILE* pstOut_, const TickClock* pclClock_)
+: m_pclDictionary{pclDictionary_}
+, m_pstOut{pstOut_}
+, m_pclClock{pclClock_}
+{}
+
+//---------------------------------------------------------------------------
+void MetricExporter::Begin()
+{
+    fprintf(m_pstOut, "time_us,metric,field,value\n");
+}
+
+//---------------------------------------------------------------------------
+void MetricExporter::WriteRow(double dUs_, const char* szMetric_, const char* szField_, double dValue_)
+{
+    fprintf(m_pstOut, "%.3f,%s,%s,%.15g\n", dUs_, szMetric_, szField_, dValue_);
+}
+
+//---------------------------------------------------------------------------
+void MetricExporter::Add(const LogRecord& stRecord_)
+{
+    MetricSummary stSummary;
+    if (!DecodeMetric(stRecord_, &stSummary)) {
+        return;
+    }
+
+    char szName[32];
+    auto* pstInfo = m_pclDictionary ? m_pclDictionary->FindMetric(stSummary.id) : nullptr;
+    auto* szMetric = pstInfo ? pstInfo->name.c_str() : szName;
+    if (!pstInfo) {
+        snprintf(szName, sizeof(szName), "%08x", stSummary.id);
+    }
+
+    auto dUs = stRecord_.timestamp * m_pclClock->GetUsPerTick();
+    switch (stSummary.type) {
+        case LogSectionType::Counter: {
+            WriteRow(dUs, szMetric, "count", stSummary.count);
+            auto it = m_clLastSummary.find(stSummary.id);
+            if ((it != m_clLastSummary.end()) && (stRecord_.timestamp > it->second)) {
+                auto dInterval = (stRecord_.timestamp - it->second) * m_pclClock->GetUsPerTick();
+                WriteRow(dUs, szMetric, "rate", (stSummary.count * 1e6) / dInterval);
+            }
+        } break;
+        case LogSectionType::Gauge: {
+            WriteRow(dUs, szMetric, "last", stSummary.last);
+            WriteRow(dUs, szMetric, "min", stSummary.min);
+            WriteRow(dUs, szMetric, "max", stSummary.max);
+        } break;
+        default: {
+            // Buckets are named by their upper bound, where known
+            for (size_t i = 0; i < stSummary.buckets.size(); i++) {
+                char szField[32];
+                if (pstInfo && (i < pstInfo->bounds.size())) {
+                    snprintf(szField, sizeof(szField), "le_%u", pstInfo->bounds[i]);
+                } else if (pstInfo && (i == pstInfo->bounds.size()) && i) {
+                    snprintf(szField, sizeof(szField), "gt_%u", pstInfo->bounds[i - 1]);
+                } else {
+                    snprintf(szField, sizeof(szField), "bucket_%u", (unsigned)i);
+                }
+                WriteRow(dUs, szMetric, szField, stSummary.buckets[i]);
+            }
+        } break;
+    }
+    m_clLastSummary[stSummary.id] = stRecord_.timestamp;
+}
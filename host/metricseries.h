@@ -0,0 +1,100 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file metricseries.h Decoding of on-target metric summaries into time series
+ */
+#pragma once
+
+#include "loggerparser.h"
+#include "logstream.h"
+#include "tickclock.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <unordered_map>
+#include <vector>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The MetricSummary struct
+ *
+ * A metric's summary for a single interval, decoded from a metric record.  The
+ * kind of metric is given by the shape of the record, so summaries can be
+ * decoded without the dictionary.
+ */
+struct MetricSummary {
+    uint32_t                id;         //!< Hash of the metric's name
+    LogSectionType          type;       //!< LogSectionType::Counter, Gauge or Histogram
+    uint32_t                count;      //!< Counter: events counted in the interval
+    int32_t                 last;       //!< Gauge: last value set
+    int32_t                 min;        //!< Gauge: minimum value in the interval
+    int32_t                 max;        //!< Gauge: maximum value in the interval
+    std::vector<uint32_t>   buckets;    //!< Histogram: values counted in each bucket in the interval
+};
+
+/**
+ * @brief DecodeMetric
+ * @param stRecord_ Record to decode
+ * @param pstSummary_ [out] Decoded summary
+ * @return true if the record is a well-formed metric record
+ */
+bool DecodeMetric(const LogRecord& stRecord_, MetricSummary* pstSummary_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The MetricExporter class
+ *
+ * Writes the metric summaries in a capture as a CSV time series, one row per
+ * value ("time_us,metric,field,value"), streamed as records are added.
+ * Counters are also reported as a rate, over the time since the metric's
+ * previous summary.
+ */
+class MetricExporter {
+public:
+    /**
+     * @brief MetricExporter
+     *
+     * @param pclDictionary_ Parsed .logger dictionary, used to name metrics and
+     *        histogram buckets
+     * @param pstOut_ Stream to write CSV to
+     * @param pclClock_ Clock used to convert timestamps to microseconds
+     */
+    MetricExporter(LoggerParser* pclDictionary_, FILE* pstOut_, const TickClock* pclClock_);
+
+    /**
+     * @brief Begin
+     *
+     * Write the CSV header
+     */
+    void Begin();
+
+    /**
+     * @brief Add
+     *
+     * Write the rows for a metric record; other records are ignored.
+     *
+     * @param stRecord_ Record to export
+     */
+    void Add(const LogRecord& stRecord_);
+
+private:
+    void WriteRow(double dUs_, const char* szMetric_, const char* szField_, double dValue_);
+
+    LoggerParser*       m_pclDictionary;
+    FILE*               m_pstOut;
+    const TickClock*    m_pclClock;
+
+    std::unordered_map<uint32_t, uint64_t> m_clLastSummary;    // Timestamp of each metric's previous summary
+};
@@ -0,0 +1,148 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file scopestats.cpp Duration statistics for scopes traced with TRACE_SCOPE()
+ */
+#include "scopestats.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    constexpr int histogramWidth = 40;
+
+    inline int Bucket(uint64_t u64Ns_)
+    {
+        auto iBucket = 0;
+        while (u64Ns_ && (iBucket < (scopeBuckets - 1))) {
+            u64Ns_ >>= 1;
+            iBucket++;
+        }
+        return iBucket;
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+ScopeStats::ScopeStats(const TickClock* pclClock_)
+: m_pclClock{pclClock_}
+, m_u64Pairs{0}
+, m_u64Unmatched{0}
+{}
+
+//---------------------------------------------------------------------------
+void ScopeStats::Add(const LogRecord& stRecord_)
+{
+    auto& header = stRecord_.header;
+    if ((header.file_id != system_file_id)
+        || ((header.line != (uint16_t)LogSystemRecord::ScopeBegin) && (header.line != (uint16_t)LogSystemRecord::ScopeEnd))) {
+        return;
+    }
+    LogArgReader clArgs(stRecord_);
+    LogArg stArg;
+    if (!clArgs.Next(&stArg)) {
+        return;
+    }
+
+    auto u32Scope = (uint32_t)stArg.AsUnsigned();
+    auto& clOpen = m_clOpen[((uint64_t)stRecord_.shard << 32) | u32Scope];
+    if (header.line == (uint16_t)LogSystemRecord::ScopeBegin) {
+        clOpen.push_back(stRecord_.timestamp);
+        return;
+    }
+    if (clOpen.empty()) {
+        m_u64Unmatched++;
+        return;
+    }
+
+    // Durations are converted as they're measured, so a change of clock rate
+    // part way through the capture applies only to the scopes following it.
+    auto u64Ticks = stRecord_.timestamp - clOpen.back();
+    clOpen.pop_back();
+    auto u64Ns = (uint64_t)(u64Ticks * m_pclClock->GetUsPerTick() * 1000.0);
+
+    auto& stScope = m_clScopes[u32Scope];
+    if (!stScope.count || (u64Ns < stScope.minNs)) {
+        stScope.minNs = u64Ns;
+    }
+    if (u64Ns > stScope.maxNs) {
+        stScope.maxNs = u64Ns;
+    }
+    stScope.count++;
+    stScope.totalNs += u64Ns;
+    stScope.buckets[Bucket(u64Ns)]++;
+    m_u64Pairs++;
+}
+
+//---------------------------------------------------------------------------
+void ScopeStats::Report(LoggerParser* pclDictionary_)
+{
+    uint64_t u64Open = 0;
+    for (auto& it : m_clOpen) {
+        u64Open += it.second.size();
+    }
+
+    printf("scopes: %u\n", (unsigned)m_clScopes.size());
+    printf("pairs: %llu\n", (unsigned long long)m_u64Pairs);
+    if (m_u64Unmatched || u64Open) {
+        printf("unmatched: %llu ends, %llu begins still open\n",
+               (unsigned long long)m_u64Unmatched, (unsigned long long)u64Open);
+    }
+
+    // Rank the scopes by the time spent within them
+    std::vector<std::pair<uint32_t, const ScopeCounters*>> clRanked;
+    for (auto& it : m_clScopes) {
+        clRanked.emplace_back(it.first, &it.second);
+    }
+    std::sort(clRanked.begin(), clRanked.end(), [](const std::pair<uint32_t, const ScopeCounters*>& a,
+                                                   const std::pair<uint32_t, const ScopeCounters*>& b) {
+        return (a.second->totalNs != b.second->totalNs) ? (a.second->totalNs > b.second->totalNs) : (a.first < b.first);
+    });
+
+    for (auto& it : clRanked) {
+        auto* pstScope = it.second;
+        auto* szName = pclDictionary_ ? pclDictionary_->FindScope(it.first) : nullptr;
+        printf("\n");
+        if (szName) {
+            printf("%s", szName);
+        } else {
+            printf("%08x", it.first);
+        }
+        printf(": %llu calls, total %.3f us, min %.3f us, avg %.3f us, max %.3f us\n",
+               (unsigned long long)pstScope->count,
+               pstScope->totalNs / 1000.0,
+               pstScope->minNs / 1000.0,
+               (double)pstScope->totalNs / pstScope->count / 1000.0,
+               pstScope->maxNs / 1000.0);
+
+        auto iFirst = Bucket(pstScope->minNs);
+        auto iLast = Bucket(pstScope->maxNs);
+        uint64_t u64Peak = 0;
+        for (auto i = iFirst; i <= iLast; i++) {
+            u64Peak = std::max(u64Peak, pstScope->buckets[i]);
+        }
+        for (auto i = iFirst; i <= iLast; i++) {
+            char szBar[histogramWidth + 1];
+            auto iWidth = (int)((pstScope->buckets[i] * histogramWidth + u64Peak - 1) / u64Peak);
+            memset(szBar, '#', iWidth);
+            szBar[iWidth] = '\0';
+            printf("  < %12.3f us %10llu %s\n",
+                   (double)(1ULL << i) / 1000.0,
+                   (unsigned long long)pstScope->buckets[i],
+                   szBar);
+        }
+    }
+}
@@ -0,0 +1,94 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file scopestats.h Duration statistics for scopes traced with TRACE_SCOPE()
+ */
+#pragma once
+
+#include "loggerparser.h"
+#include "logstream.h"
+#include "tickclock.h"
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+//---------------------------------------------------------------------------
+// Durations are binned by powers of two of nanoseconds
+constexpr int scopeBuckets = 64;
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The ScopeCounters struct
+ *
+ * Aggregated durations for a single traced scope, identified by its id (the
+ * hash of its name).
+ */
+struct ScopeCounters {
+    uint64_t    count;
+    uint64_t    totalNs;
+    uint64_t    minNs;
+    uint64_t    maxNs;
+    uint64_t    buckets[scopeBuckets];  // Count of durations in [2^(i-1), 2^i) ns (bucket 0: under 1ns)
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The ScopeStats class
+ *
+ * Pairs the begin and end records of traced scopes, and accumulates a
+ * histogram of each scope's durations.  An end record is paired with the
+ * latest unmatched begin record of the same scope from the same shard, so
+ * nested and recursive scopes are measured correctly, as long as each shard
+ * is written to by a single context (or the scope isn't entered concurrently
+ * from several contexts logging to the same shard).
+ */
+class ScopeStats {
+public:
+    /**
+     * @brief ScopeStats
+     * @param pclClock_ Clock used to convert timestamps to time (the stream's
+     *        clock, which tracks any clock-rate records in the capture)
+     */
+    ScopeStats(const TickClock* pclClock_);
+
+    /**
+     * @brief Add
+     *
+     * Account for a single record; records other than scope begin and end
+     * records are ignored.
+     *
+     * @param stRecord_ Record to account for
+     */
+    void Add(const LogRecord& stRecord_);
+
+    /**
+     * @brief Report
+     *
+     * Print a summary, and the duration histogram of each scope (ranked by the
+     * total time spent within it), resolving scope names through the dictionary.
+     *
+     * @param pclDictionary_ Parsed .logger dictionary, or nullptr
+     */
+    void Report(LoggerParser* pclDictionary_);
+
+private:
+    const TickClock*    m_pclClock;
+    uint64_t            m_u64Pairs;
+    uint64_t            m_u64Unmatched;     // End records without a matching begin record
+
+    std::unordered_map<uint32_t, ScopeCounters> m_clScopes;
+    std::unordered_map<uint64_t, std::vector<uint64_t>> m_clOpen;  // Timestamps of unmatched begins, by shard and scope
+};
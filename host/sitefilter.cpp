@@ -0,0 +1,153 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file sitefilter.cpp Resolution of log sites to the indexes used by the target's site filter
+ */
+#include "sitefilter.h"
+#include "crc16.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    bool EndsWith(const char* szString_, const char* szSuffix_, size_t uSuffixLen_)
+    {
+        auto uLen = strlen(szString_);
+        return (uLen >= uSuffixLen_) && !strncmp(&szString_[uLen - uSuffixLen_], szSuffix_, uSuffixLen_);
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+SiteFilter::SiteFilter(LoggerParser* pclDictionary_, const ElfImage* pclImage_)
+: m_pclDictionary{pclDictionary_}
+, m_pclImage{pclImage_}
+{}
+
+//---------------------------------------------------------------------------
+bool SiteFilter::Init()
+{
+    auto* pstSection = m_pclImage->FindSection("logger_sites");
+    if (!pstSection) {
+        return false;
+    }
+    auto uCount = pstSection->size / sizeof(LogSiteKey_t);
+    for (size_t i = 0; (i < uCount) && (i <= UINT16_MAX); i++) {
+        LogSiteKey_t stKey;
+        memcpy(&stKey, &pstSection->data[i * sizeof(stKey)], sizeof(stKey));
+
+        FilterSite stSite;
+        stSite.index = (uint16_t)i;
+        stSite.fileId = stKey.file_id;
+        stSite.line = stKey.line;
+        auto* pclFile = m_pclDictionary->FindFile(stKey.file_id);
+        stSite.filename = pclFile ? pclFile->filename : nullptr;
+        auto* pclLine = m_pclDictionary->FindLogLine(stKey.file_id, stKey.line);
+        stSite.format = pclLine ? pclLine->m_szFormatString : nullptr;
+        m_clSites.push_back(stSite);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void SiteFilter::List() const
+{
+    for (auto& stSite : m_clSites) {
+        if (stSite.filename) {
+            printf("#%-5u %s:%u", stSite.index, stSite.filename, stSite.line);
+        } else {
+            printf("#%-5u %08x:%u", stSite.index, stSite.fileId, stSite.line);
+        }
+        if (stSite.format) {
+            // Format strings usually end with a newline
+            auto iLen = (int)strlen(stSite.format);
+            while (iLen && ((stSite.format[iLen - 1] == '\n') || (stSite.format[iLen - 1] == '\r'))) {
+                iLen--;
+            }
+            printf(" \"%.*s\"", iLen, stSite.format);
+        }
+        printf("\n");
+    }
+}
+
+//---------------------------------------------------------------------------
+size_t SiteFilter::Select(const char* szSelector_, std::vector<uint16_t>* pclIndexes_) const
+{
+    size_t uMatched = 0;
+    auto Add = [&](const FilterSite& stSite_) {
+        pclIndexes_->push_back(stSite_.index);
+        uMatched++;
+    };
+
+    if (!strcmp(szSelector_, "all")) {
+        for (auto& stSite : m_clSites) {
+            Add(stSite);
+        }
+        return uMatched;
+    }
+    if (szSelector_[0] == '#') {
+        char* szEnd;
+        auto ulIndex = strtoul(&szSelector_[1], &szEnd, 0);
+        if (!*szEnd && (ulIndex < m_clSites.size())) {
+            Add(m_clSites[ulIndex]);
+        }
+        return uMatched;
+    }
+    if (!strncmp(szSelector_, "fmt:", 4)) {
+        for (auto& stSite : m_clSites) {
+            if (stSite.format && strstr(stSite.format, &szSelector_[4])) {
+                Add(stSite);
+            }
+        }
+        return uMatched;
+    }
+
+    // file[:line]
+    auto* szColon = strrchr(szSelector_, ':');
+    auto uFileLen = szColon ? (size_t)(szColon - szSelector_) : strlen(szSelector_);
+    long lLine = -1;
+    if (szColon) {
+        char* szEnd;
+        lLine = strtol(&szColon[1], &szEnd, 10);
+        if (!szColon[1] || *szEnd) {
+            return 0;
+        }
+    }
+    for (auto& stSite : m_clSites) {
+        if (stSite.filename && EndsWith(stSite.filename, szSelector_, uFileLen) && ((lLine < 0) || (stSite.line == lLine))) {
+            Add(stSite);
+        }
+    }
+    return uMatched;
+}
+
+//---------------------------------------------------------------------------
+size_t SiteFilter::BuildCommand(LogCommand eCommand_, const uint16_t* pu16Indexes_, uint8_t u8Count_, uint8_t* pu8Frame_)
+{
+    LogCommandHeader_t stHeader = {
+        .sync = command_sync,
+        .command = (uint8_t)eCommand_,
+        .count = u8Count_,
+    };
+    memcpy(pu8Frame_, &stHeader, sizeof(stHeader));
+    auto uLen = sizeof(stHeader);
+    if (u8Count_) {
+        memcpy(&pu8Frame_[uLen], pu16Indexes_, u8Count_ * sizeof(uint16_t));
+        uLen += u8Count_ * sizeof(uint16_t);
+    }
+    auto u16Crc = crc16_update(crc16_init, pu8Frame_, uLen);
+    memcpy(&pu8Frame_[uLen], &u16Crc, sizeof(u16Crc));
+    return uLen + sizeof(u16Crc);
+}
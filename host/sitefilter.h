@@ -0,0 +1,116 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file sitefilter.h Resolution of log sites to the indexes used by the target's site filter
+ */
+#pragma once
+
+#include "elfimage.h"
+#include "loggerparser.h"
+#include "logtypes.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+//---------------------------------------------------------------------------
+// Largest command frame built by SiteFilter::BuildCommand()
+constexpr size_t COMMAND_FRAME_MAX = sizeof(LogCommandHeader_t) + (command_max_sites * sizeof(uint16_t)) + sizeof(uint16_t);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The FilterSite struct
+ *
+ * A site that can be enabled or disabled at runtime (see LOGBUF_SITE_FILTER)
+ */
+struct FilterSite {
+    uint16_t        index;      //!< Index of the site's key in the "logger_sites" section
+    uint32_t        fileId;     //!< Hash of the site's file
+    uint16_t        line;       //!< Line number of the site
+    const char*     filename;   //!< Name of the site's file, or nullptr if not in the dictionary
+    const char*     format;     //!< Format string of the site, or nullptr if not in the dictionary
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The SiteFilter class
+ *
+ * Reads the keys of a target's filterable sites from the "logger_sites"
+ * section of its .elf file, in the order of the target's enable bitmap, and
+ * resolves selectors (by file, line, or format string, via the .logger
+ * dictionary) to the site indexes carried by LogCommand frames.
+ *
+ * Selectors are one of:
+ *   all             every site
+ *   #index          a single site, by index
+ *   file:line       the site at the given line of a file
+ *   file            every site in a file
+ *   fmt:substring   every site whose format string contains the substring
+ * Files match on the end of their name, so "uart.cpp" selects "drivers/uart.cpp".
+ */
+class SiteFilter {
+public:
+    /**
+     * @brief SiteFilter
+     * @param pclDictionary_ Parsed .logger dictionary
+     * @param pclImage_ Target's .elf file (initialized)
+     */
+    SiteFilter(LoggerParser* pclDictionary_, const ElfImage* pclImage_);
+
+    /**
+     * @brief Init
+     * @return true if the image holds a "logger_sites" section (i.e. was built
+     *         with LOGBUF_SITE_FILTER)
+     */
+    bool Init();
+
+    /**
+     * @brief List
+     *
+     * Print each site's index, file and line, and format string.
+     */
+    void List() const;
+
+    /**
+     * @brief Select
+     *
+     * Append the indexes of the sites matching a selector.
+     *
+     * @param szSelector_ Selector (see above)
+     * @param pclIndexes_ [out] Indexes of matching sites
+     * @return Number of sites matched
+     */
+    size_t Select(const char* szSelector_, std::vector<uint16_t>* pclIndexes_) const;
+
+    /**
+     * @brief BuildCommand
+     *
+     * Build a single command frame, as parsed by the target's LogCommandReader.
+     *
+     * @param eCommand_ Command to send
+     * @param pu16Indexes_ Indexes of the sites it applies to
+     * @param u8Count_ Number of indexes (at most command_max_sites)
+     * @param pu8Frame_ [out] Frame (at least COMMAND_FRAME_MAX bytes)
+     * @return Length of the frame, in bytes
+     */
+    static size_t BuildCommand(LogCommand eCommand_, const uint16_t* pu16Indexes_, uint8_t u8Count_, uint8_t* pu8Frame_);
+
+    size_t GetSiteCount() const { return m_clSites.size(); }
+
+private:
+    LoggerParser*           m_pclDictionary;
+    const ElfImage*         m_pclImage;
+    std::vector<FilterSite> m_clSites;
+};
@@ -0,0 +1,290 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file sitestats.cpp Per-site traffic statistics ("top talkers") for captures
+ */
+#include "sitestats.h"
+
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    constexpr uint32_t initialCapacity = 1024;
+
+    inline uint32_t HashSite(uint32_t fileHash_, uint16_t line_)
+    {
+        auto u32Hash = (fileHash_ ^ (line_ * 0x9E3779B1u));
+        return u32Hash ^ (u32Hash >> 16);
+    }
+
+    // Print a format string on a single line, escaping control characters
+    void PrintEscaped(const char* szString_)
+    {
+        for (; szString_ && *szString_; szString_++) {
+            switch (*szString_) {
+                case '\n': fputs("\\n", stdout); break;
+                case '\r': fputs("\\r", stdout); break;
+                case '\t': fputs("\\t", stdout); break;
+                default: putchar(*szString_); break;
+            }
+        }
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+bool DecodeTargetStats(const LogRecord& stRecord_, TargetStats* pstStats_)
+{
+    if ((stRecord_.header.file_id != system_file_id) || (stRecord_.header.line != (uint16_t)LogSystemRecord::Stats)) {
+        return false;
+    }
+    uint32_t* apu32Fields[] = {
+        &pstStats_->records,  &pstStats_->bytes,   &pstStats_->recordsFlushed, &pstStats_->bytesFlushed,
+        &pstStats_->overruns, &pstStats_->highWater, &pstStats_->lockMax,      &pstStats_->lockMean,
+        &pstStats_->flushMax, &pstStats_->flushMean, &pstStats_->clockHz,
+    };
+    LogArgReader clArgs(stRecord_);
+    LogArg stArg;
+    for (auto* pu32Field : apu32Fields) {
+        if (!clArgs.Next(&stArg) || (stArg.tag != LogTag::LogTagUint32)) {
+            return false;
+        }
+        *pu32Field = (uint32_t)stArg.AsUnsigned();
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+SiteStats::SiteStats(uint32_t u32WindowTicks_)
+: m_u32WindowTicks{u32WindowTicks_ ? u32WindowTicks_ : 1}
+, m_pstSites{nullptr}
+, m_u32Capacity{0}
+, m_u32Used{0}
+, m_u64Records{0}
+, m_u64Bytes{0}
+, m_u64Suppressed{0}
+, m_u64Repeats{0}
+, m_au32LastFile{}
+, m_au16LastLine{}
+, m_astTarget{}
+, m_abTarget{}
+, m_u64FirstWindow{0}
+, m_u64LastWindow{0}
+, m_stWindow{}
+{
+    m_u32Capacity = initialCapacity;
+    m_pstSites = (SiteCounters*)calloc(m_u32Capacity, sizeof(SiteCounters));
+}
+
+//---------------------------------------------------------------------------
+SiteStats::~SiteStats()
+{
+    free(m_pstSites);
+}
+
+//---------------------------------------------------------------------------
+SiteCounters* SiteStats::Lookup(uint32_t fileHash_, uint16_t line_)
+{
+    auto u32Mask = m_u32Capacity - 1;
+    auto u32Idx = HashSite(fileHash_, line_) & u32Mask;
+    while (true) {
+        auto* pstSite = &m_pstSites[u32Idx];
+        if (!pstSite->used) {
+            // Keep the table at most half full so probe sequences stay short
+            if ((m_u32Used + 1) > (m_u32Capacity / 2)) {
+                Grow();
+                return Lookup(fileHash_, line_);
+            }
+            pstSite->used = true;
+            pstSite->fileHash = fileHash_;
+            pstSite->line = line_;
+            m_u32Used++;
+            return pstSite;
+        }
+        if ((pstSite->fileHash == fileHash_) && (pstSite->line == line_)) {
+            return pstSite;
+        }
+        u32Idx = (u32Idx + 1) & u32Mask;
+    }
+}
+
+//---------------------------------------------------------------------------
+void SiteStats::Grow()
+{
+    auto* pstOld = m_pstSites;
+    auto u32OldCapacity = m_u32Capacity;
+
+    m_u32Capacity *= 2;
+    m_pstSites = (SiteCounters*)calloc(m_u32Capacity, sizeof(SiteCounters));
+
+    auto u32Mask = m_u32Capacity - 1;
+    for (uint32_t i = 0; i < u32OldCapacity; i++) {
+        if (!pstOld[i].used) {
+            continue;
+        }
+        auto u32Idx = HashSite(pstOld[i].fileHash, pstOld[i].line) & u32Mask;
+        while (m_pstSites[u32Idx].used) {
+            u32Idx = (u32Idx + 1) & u32Mask;
+        }
+        m_pstSites[u32Idx] = pstOld[i];
+    }
+    free(pstOld);
+}
+
+//---------------------------------------------------------------------------
+void SiteStats::Add(const LogRecord& stRecord_)
+{
+    auto u64Window = stRecord_.timestamp / m_u32WindowTicks;
+    if (!m_u64Records) {
+        m_u64FirstWindow = u64Window;
+        m_stWindow.current = u64Window;
+        m_stWindow.peakWindow = u64Window;
+    }
+    if (u64Window > m_u64LastWindow) {
+        m_u64LastWindow = u64Window;
+    }
+    m_u64Records++;
+    m_u64Bytes += stRecord_.wireBytes;
+    m_u64Suppressed += stRecord_.suppressed;
+    m_stWindow.Add(u64Window);
+
+    auto* pstSite = Lookup(stRecord_.header.file_id, stRecord_.header.line);
+    if (!pstSite->records) {
+        pstSite->window.current = u64Window;
+        pstSite->window.peakWindow = u64Window;
+    }
+    pstSite->records++;
+    pstSite->bytes += stRecord_.wireBytes;
+    pstSite->args += stRecord_.header.log_count;
+    pstSite->suppressed += stRecord_.suppressed;
+    pstSite->window.Add(u64Window);
+
+    // Duplicates coalesced by the target are credited to the record they repeat
+    if (stRecord_.header.file_id != system_file_id) {
+        m_au32LastFile[stRecord_.shard] = stRecord_.header.file_id;
+        m_au16LastLine[stRecord_.shard] = stRecord_.header.line;
+        return;
+    }
+    // Only the latest of a shard's stats records is reported, as they're cumulative
+    TargetStats stTarget;
+    if (DecodeTargetStats(stRecord_, &stTarget)) {
+        m_astTarget[stRecord_.shard] = stTarget;
+        m_abTarget[stRecord_.shard] = true;
+        return;
+    }
+    LogArgReader clArgs(stRecord_);
+    LogArg stArg;
+    if ((stRecord_.header.line != (uint16_t)LogSystemRecord::Repeat) || !clArgs.Next(&stArg)) {
+        return;
+    }
+    m_u64Repeats += stArg.AsUnsigned();
+    if (m_au32LastFile[stRecord_.shard] != system_file_id) {
+        Lookup(m_au32LastFile[stRecord_.shard], m_au16LastLine[stRecord_.shard])->repeats += stArg.AsUnsigned();
+    }
+}
+
+//---------------------------------------------------------------------------
+void SiteStats::Report(LoggerParser* pclDictionary_, int iTop_)
+{
+    auto u64Windows = (m_u64Records ? (m_u64LastWindow - m_u64FirstWindow + 1) : 0);
+
+    printf("records: %llu\n", (unsigned long long)m_u64Records);
+    printf("bytes: %llu\n", (unsigned long long)m_u64Bytes);
+    printf("sites: %u\n", m_u32Used);
+    printf("window: %u ticks, %llu windows\n", m_u32WindowTicks, (unsigned long long)u64Windows);
+    if (u64Windows) {
+        printf("rate: %.2f records/window avg, %u records/window peak (at tick %llu)\n",
+               (double)m_u64Records / u64Windows,
+               m_stWindow.peak,
+               (unsigned long long)m_stWindow.peakWindow * m_u32WindowTicks);
+    }
+    if (m_u64Suppressed) {
+        printf("suppressed: %llu calls\n", (unsigned long long)m_u64Suppressed);
+    }
+    if (m_u64Repeats) {
+        printf("repeated: %llu records coalesced\n", (unsigned long long)m_u64Repeats);
+    }
+    for (auto i = 0; i < 256; i++) {
+        if (!m_abTarget[i]) {
+            continue;
+        }
+        auto& stTarget = m_astTarget[i];
+        printf("target shard %d: %u records, %u bytes committed; %u records, %u bytes flushed; %u overruns\n", i,
+               stTarget.records, stTarget.bytes, stTarget.recordsFlushed, stTarget.bytesFlushed, stTarget.overruns);
+        printf("target shard %d: high-water %u bytes; critical section %.2f us max, %.2f us mean; "
+               "flush %.2f us max, %.2f us mean\n",
+               i, stTarget.highWater, stTarget.ToUs(stTarget.lockMax), stTarget.ToUs(stTarget.lockMean),
+               stTarget.ToUs(stTarget.flushMax), stTarget.ToUs(stTarget.flushMean));
+    }
+    printf("\n");
+
+    // Rank the sites by the bandwidth they consume
+    auto** ppstRanked = (SiteCounters**)malloc(sizeof(SiteCounters*) * (m_u32Used + 1));
+    uint32_t u32Count = 0;
+    for (uint32_t i = 0; i < m_u32Capacity; i++) {
+        if (m_pstSites[i].used) {
+            ppstRanked[u32Count++] = &m_pstSites[i];
+        }
+    }
+    std::sort(ppstRanked, ppstRanked + u32Count, [](const SiteCounters* a, const SiteCounters* b) {
+        return (a->bytes != b->bytes) ? (a->bytes > b->bytes) : (a->records > b->records);
+    });
+
+    if ((iTop_ > 0) && ((uint32_t)iTop_ < u32Count)) {
+        u32Count = iTop_;
+    }
+
+    printf("%4s %10s %12s %6s %6s %9s %6s  %s\n",
+           "rank", "records", "bytes", "bw%", "args", "rate/win", "peak", "site");
+    for (uint32_t i = 0; i < u32Count; i++) {
+        auto* pstSite = ppstRanked[i];
+        const FileMap* pclFile = nullptr;
+        const LogLine* pclLine = nullptr;
+        if (pclDictionary_) {
+            pclFile = pclDictionary_->FindFile(pstSite->fileHash);
+            pclLine = pclDictionary_->FindLogLine(pstSite->fileHash, pstSite->line);
+        }
+
+        printf("%4u %10llu %12llu %6.2f %6.2f %9.2f %6u  ",
+               i + 1,
+               (unsigned long long)pstSite->records,
+               (unsigned long long)pstSite->bytes,
+               (100.0 * pstSite->bytes) / m_u64Bytes,
+               (double)pstSite->args / pstSite->records,
+               (double)pstSite->records / u64Windows,
+               pstSite->window.peak);
+        if (pstSite->fileHash == system_file_id) {
+            printf("<%s>", LogSystemRecordName(pstSite->line));
+        } else if (pclFile) {
+            printf("%s:%u", pclFile->filename, pstSite->line);
+        } else {
+            printf("%08x:%u", pstSite->fileHash, pstSite->line);
+        }
+        if (pclLine) {
+            printf(" \"");
+            PrintEscaped(pclLine->m_szFormatString);
+            printf("\"");
+        }
+        if (pstSite->suppressed) {
+            printf(" [%llu suppressed]", (unsigned long long)pstSite->suppressed);
+        }
+        if (pstSite->repeats) {
+            printf(" [%llu repeated]", (unsigned long long)pstSite->repeats);
+        }
+        printf("\n");
+    }
+    free(ppstRanked);
+}
@@ -0,0 +1,159 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file sitestats.h Per-site traffic statistics ("top talkers") for captures
+ */
+#pragma once
+
+#include "loggerparser.h"
+#include "logstream.h"
+
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The WindowCounter struct
+ *
+ * Tracks the number of records seen within fixed-size timestamp windows, and
+ * the busiest window seen so far.
+ */
+struct WindowCounter {
+    uint64_t    current;    //!< Index of the window currently being counted
+    uint32_t    count;      //!< Records counted in the current window
+    uint32_t    peak;       //!< Most records seen in any one window
+    uint64_t    peakWindow; //!< Index of the busiest window
+
+    void Add(uint64_t window_)
+    {
+        if (window_ > current) {
+            current = window_;
+            count = 0;
+        }
+        if (++count > peak) {
+            peak = count;
+            peakWindow = current;
+        }
+    }
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The SiteCounters struct
+ *
+ * Aggregated traffic for a single DEBUG_LOG() site, identified by its
+ * file hash and line.
+ */
+struct SiteCounters {
+    uint32_t        fileHash;
+    uint16_t        line;
+    bool            used;
+    uint64_t        records;
+    uint64_t        bytes;
+    uint64_t        args;
+    uint64_t        suppressed;     // Calls suppressed by a sampled or rate-limited site
+    uint64_t        repeats;        // Duplicate records coalesced by the target
+    WindowCounter   window;
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The TargetStats struct
+ *
+ * A shard's statistics on its own operation, from a stats record (see
+ * LOGBUF_STATS).  Counts are since the target started, or its stats were
+ * reset; times are in ticks of a clock running at clockHz.
+ */
+struct TargetStats {
+    uint32_t        records;
+    uint32_t        bytes;
+    uint32_t        recordsFlushed;
+    uint32_t        bytesFlushed;
+    uint32_t        overruns;
+    uint32_t        highWater;      // Largest backlog of unflushed data, in bytes
+    uint32_t        lockMax;        // Longest critical section
+    uint32_t        lockMean;
+    uint32_t        flushMax;       // Longest flush
+    uint32_t        flushMean;
+    uint32_t        clockHz;
+
+    double ToUs(uint32_t u32Ticks_) const { return clockHz ? ((u32Ticks_ * 1e6) / clockHz) : u32Ticks_; }
+};
+
+/**
+ * @brief DecodeTargetStats
+ * @param stRecord_ Record to decode
+ * @param pstStats_ [out] Statistics held by the record
+ * @return true if the record is a well-formed stats record
+ */
+bool DecodeTargetStats(const LogRecord& stRecord_, TargetStats* pstStats_);
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The SiteStats class
+ *
+ * Accumulates per-site counters from raw records without formatting them.
+ * Sites are kept in an open-addressed hash table, so the per-record cost is a
+ * hash, a probe, and a handful of increments.
+ */
+class SiteStats {
+public:
+    /**
+     * @brief SiteStats
+     * @param u32WindowTicks_ Width (in timestamp ticks) of the windows used
+     *        to compute rates and burst peaks
+     */
+    SiteStats(uint32_t u32WindowTicks_);
+    ~SiteStats();
+
+    /**
+     * @brief Add
+     *
+     * Account for a single record
+     *
+     * @param stRecord_ Record to account for
+     */
+    void Add(const LogRecord& stRecord_);
+
+    /**
+     * @brief Report
+     *
+     * Print a summary and a table of the busiest sites (ranked by bytes on the
+     * wire), resolving file names and format strings through the dictionary.
+     *
+     * @param pclDictionary_ Parsed .logger dictionary, or nullptr
+     * @param iTop_ Maximum number of sites to list (0 == all)
+     */
+    void Report(LoggerParser* pclDictionary_, int iTop_);
+
+private:
+    SiteCounters* Lookup(uint32_t fileHash_, uint16_t line_);
+    void Grow();
+
+    uint32_t        m_u32WindowTicks;
+    SiteCounters*   m_pstSites;
+    uint32_t        m_u32Capacity;
+    uint32_t        m_u32Used;
+
+    uint64_t        m_u64Records;
+    uint64_t        m_u64Bytes;
+    uint64_t        m_u64Suppressed;
+    uint64_t        m_u64Repeats;
+    uint32_t        m_au32LastFile[256];    // Last site seen from each shard, which repeat records refer to
+    uint16_t        m_au16LastLine[256];
+    TargetStats     m_astTarget[256];       // Last stats record from each shard
+    bool            m_abTarget[256];
+    uint64_t        m_u64FirstWindow;
+    uint64_t        m_u64LastWindow;
+    WindowCounter   m_stWindow;
+};
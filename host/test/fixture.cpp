@@ -0,0 +1,56 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file fixture.cpp Log sites compiled into the dictionary used by logbench's golden checks
+
+  The .logger section of this file's object is committed as golden/logger.bin,
+  so the golden output doesn't depend on the compiler used to run the checks.
+  To change the sites, rebuild the dictionary and re-record the golden files:
+
+    g++ -std=gnu++11 -c -I. -I../../src/public -D__FILENAME__=fixture.cpp fixture.cpp -o fixture.o
+    objcopy -O binary --only-section=.logger fixture.o golden/logger.bin
+    ../logbench -R -F golden golden/logger.bin
+
+  The sites cover each argument type that host tools derive from a format
+  string (see LogGenerator), from zero to five arguments.
+ */
+#include "mark3.h"
+#include "logbuf.h"
+#include "logmacro.h"
+
+EMIT_DBG_HEADER();
+
+//---------------------------------------------------------------------------
+struct Registers {
+    uint32_t ctrl;
+    uint32_t status;
+    uint16_t count;
+} __attribute__((packed));
+
+//---------------------------------------------------------------------------
+void Fixture(uint32_t u32Value_, const char* szName_, const Registers& stRegs_)
+{
+    DEBUG_LOG("boot\n");
+    DEBUG_LOG("tick %u\n", TagUint32, u32Value_);
+    DEBUG_LOG("state %hhu -> %hhu\n", TagUint8, (uint8_t)u32Value_, TagUint8, (uint8_t)(u32Value_ + 1));
+    DEBUG_LOG("adc ch%hu = %hd\n", TagUint16, (uint16_t)u32Value_, TagInt16, (int16_t)u32Value_);
+    DEBUG_LOG("offset %d, delta %hhd\n", TagInt32, (int32_t)u32Value_, TagInt8, (int8_t)u32Value_);
+    DEBUG_LOG("uptime %llu us, drift %lld\n", TagUint64, (uint64_t)u32Value_, TagInt64, (int64_t)u32Value_);
+    DEBUG_LOG("temp %f, vref %lf\n", TagFloat, (float)u32Value_, TagDouble, (double)u32Value_);
+    DEBUG_LOG("key '%c' at %p\n", TagChar, (char)u32Value_, TagVoidptr, (void*)&stRegs_);
+    DEBUG_LOG("thread %s started\n", TagStrcopy, szName_);
+    DEBUG_LOG("regs %{ctrl:x32,status:x32,count:u16}\n", TagBlob, LogBlob_t(&stRegs_, sizeof(stRegs_)));
+    DEBUG_LOG("rx %x %x %x %x %x\n", TagUint8, (uint8_t)u32Value_, TagUint8, (uint8_t)(u32Value_ >> 8),
+              TagUint8, (uint8_t)(u32Value_ >> 16), TagUint8, (uint8_t)(u32Value_ >> 24), TagUint16, (uint16_t)u32Value_);
+}
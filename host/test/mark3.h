@@ -0,0 +1,36 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file mark3.h Host stand-in for the kernel services used by the logger
+
+  Lets the target-side logger sources (../../src) be built into host test
+  programs and fixtures: kernel ticks come from the test program, and critical
+  sections are no-ops, as host tests are single-threaded.
+ */
+#pragma once
+
+#include <stdint.h>
+
+namespace Mark3 {
+//---------------------------------------------------------------------------
+struct Kernel {
+    static uint32_t GetTicks();     //!< Defined by the test program
+};
+
+//---------------------------------------------------------------------------
+struct CriticalSection {
+    static void Enter() {}
+    static void Exit() {}
+};
+} // namespace Mark3
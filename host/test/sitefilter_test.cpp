@@ -0,0 +1,242 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file sitefilter_test.cpp Round trip of site filter commands, from host tools to the target
+
+  Frames built by SiteFilter::BuildCommand() (as sent by "logtool sites -o")
+  are written to a pty, standing in for the target's serial port as in
+  "logtool gen -P", and the bytes read back from it are presented to a
+  LogCommandReader one at a time.  The test checks the resulting site enable
+  state, the frames rejected, and the SiteFilter records acknowledging each
+  command, decoded from the logger's output with LogStream.  Build and run it
+  from this directory:
+
+    g++ -std=gnu++11 -I. -I.. -I../../src/public -DLOGBUF_SITE_FILTER -D__FILENAME__=sitefilter_test.cpp \
+        sitefilter_test.cpp ../sitefilter.cpp ../elfimage.cpp ../loggerparser.cpp ../ll.cpp ../logstream.cpp \
+        ../logdecompress.cpp ../tickclock.cpp ../../src/logbuf.cpp ../../src/logcommand.cpp ../../src/logcompress.cpp \
+        ../../src/logmetric.cpp -o sitefilter_test
+    ./sitefilter_test
+ */
+#include "mark3.h"
+#include "logbuf.h"
+#include "logcommand.h"
+#include "logmacro.h"
+#include "logstream.h"
+#include "sitefilter.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <vector>
+
+EMIT_DBG_HEADER();
+
+using namespace Mark3;
+
+namespace {
+//---------------------------------------------------------------------------
+constexpr int readTimeoutMs = 1000;
+constexpr int rounds = 4;
+constexpr int siteCount = 3;
+
+uint32_t u32Ticks = 0;
+std::vector<uint8_t> clCapture;
+int iFailures = 0;
+
+//---------------------------------------------------------------------------
+void CaptureWriter(const uint8_t* pu8Data_, size_t uLen_)
+{
+    clCapture.insert(clCapture.end(), pu8Data_, pu8Data_ + uLen_);
+}
+
+//---------------------------------------------------------------------------
+void Check(bool bOk_, const char* szWhat_)
+{
+    if (!bOk_) {
+        printf("FAIL: %s\n", szWhat_);
+        iFailures++;
+    }
+}
+
+//---------------------------------------------------------------------------
+// The only filterable sites in the test, one record each per round
+void LogRound(int iRound_)
+{
+    u32Ticks++;
+    DEBUG_LOG("alpha %d\n", TagInt32, iRound_);
+    DEBUG_LOG("beta %d\n", TagInt32, iRound_);
+    DEBUG_LOG("gamma %d\n", TagInt32, iRound_);
+    LogBuf::Instance().FlushData();
+}
+
+//---------------------------------------------------------------------------
+// Open a pseudo-terminal in raw mode, as "logtool gen -P" does; the master
+// side is the target's end.
+int OpenPty()
+{
+    auto fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) || grantpt(fd) || unlockpt(fd)) {
+        return -1;
+    }
+    struct termios stTermios;
+    if (!tcgetattr(fd, &stTermios)) {
+        cfmakeraw(&stTermios);
+        tcsetattr(fd, TCSANOW, &stTermios);
+    }
+    return fd;
+}
+
+//---------------------------------------------------------------------------
+// Write bytes to the host's end of the pty, and present the bytes arriving at
+// the target's end to the reader, a byte at a time.
+bool Send(int iHostFd_, int iTargetFd_, const uint8_t* pu8Data_, size_t uLen_, LogCommandReader* pclReader_)
+{
+    if (write(iHostFd_, pu8Data_, uLen_) != (ssize_t)uLen_) {
+        return false;
+    }
+    while (uLen_) {
+        struct pollfd stPoll = { iTargetFd_, POLLIN, 0 };
+        if (poll(&stPoll, 1, readTimeoutMs) <= 0) {
+            return false;
+        }
+        uint8_t au8Buf[64];
+        auto nr = read(iTargetFd_, au8Buf, sizeof(au8Buf));
+        if (nr <= 0) {
+            return false;
+        }
+        for (auto i = 0; i < nr; i++) {
+            pclReader_->Receive(&au8Buf[i], 1);
+        }
+        uLen_ -= nr;
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool SendCommand(int iHostFd_, int iTargetFd_, LogCommand eCommand_, const uint16_t* pu16Indexes_, uint8_t u8Count_,
+                 LogCommandReader* pclReader_)
+{
+    uint8_t au8Frame[COMMAND_FRAME_MAX];
+    auto uLen = SiteFilter::BuildCommand(eCommand_, pu16Indexes_, u8Count_, au8Frame);
+    return Send(iHostFd_, iTargetFd_, au8Frame, uLen, pclReader_);
+}
+
+//---------------------------------------------------------------------------
+int EnabledSites()
+{
+    auto iEnabled = 0;
+    for (auto i = 0; i < LogBuf::GetSiteCount(); i++) {
+        iEnabled += LogBuf::SiteEnabled(&__start_logger_sites[i]) ? 1 : 0;
+    }
+    return iEnabled;
+}
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+uint32_t Mark3::Kernel::GetTicks()
+{
+    return u32Ticks;
+}
+
+//---------------------------------------------------------------------------
+int main()
+{
+    LogBuf::Instance().SetLogWriter(CaptureWriter);
+    Check(LogBuf::GetSiteCount() == siteCount, "site count");
+
+    auto iTargetFd = OpenPty();
+    auto iHostFd = (iTargetFd < 0) ? -1 : open(ptsname(iTargetFd), O_WRONLY | O_NOCTTY);
+    if (iHostFd < 0) {
+        printf("FAIL: opening pty\n");
+        return 1;
+    }
+
+    LogCommandReader clReader;
+    LogRound(0);
+
+    // Round 1: two of the three sites disabled
+    uint16_t au16Disable[] = { 0, 2 };
+    Check(SendCommand(iHostFd, iTargetFd, LogCommand::DisableSites, au16Disable, 2, &clReader), "sending disable");
+    Check(!LogBuf::SiteEnabled(&__start_logger_sites[0]) && LogBuf::SiteEnabled(&__start_logger_sites[1])
+          && !LogBuf::SiteEnabled(&__start_logger_sites[2]), "sites disabled");
+    LogRound(1);
+
+    // Round 2: garbage, a frame with a bad CRC, a frame with too many sites,
+    // and an unknown command change nothing; disabling a disabled site is
+    // acknowledged, but changes nothing either.
+    const uint8_t au8Garbage[] = { 0x00, 0x73, 0xAA, 0x51, 0x55 };
+    Check(Send(iHostFd, iTargetFd, au8Garbage, sizeof(au8Garbage), &clReader), "sending garbage");
+    uint8_t au8Frame[COMMAND_FRAME_MAX];
+    auto uLen = SiteFilter::BuildCommand(LogCommand::EnableAll, nullptr, 0, au8Frame);
+    au8Frame[uLen - 1] ^= 0x01;
+    Check(Send(iHostFd, iTargetFd, au8Frame, uLen, &clReader), "sending bad CRC");
+    LogCommandHeader_t stOversized = { command_sync, (uint8_t)LogCommand::EnableSites, command_max_sites + 1 };
+    Check(Send(iHostFd, iTargetFd, (const uint8_t*)&stOversized, sizeof(stOversized), &clReader), "sending oversized");
+    Check(SendCommand(iHostFd, iTargetFd, (LogCommand)0x7F, nullptr, 0, &clReader), "sending unknown command");
+    Check(clReader.GetRejected() == 3, "frames rejected");
+    Check(SendCommand(iHostFd, iTargetFd, LogCommand::DisableSites, au16Disable, 1, &clReader), "sending disable again");
+    Check(EnabledSites() == 1, "sites unchanged");
+    LogRound(2);
+
+    // Round 3: everything enabled again
+    Check(SendCommand(iHostFd, iTargetFd, LogCommand::EnableAll, nullptr, 0, &clReader), "sending enable all");
+    Check(EnabledSites() == siteCount, "sites enabled");
+    Check(clReader.GetRejected() == 3, "frames rejected");
+    LogRound(3);
+
+    close(iHostFd);
+    close(iTargetFd);
+
+    // Records logged by the enabled sites, and the acknowledgements of the
+    // commands executed, in order
+    const int aiExpected[rounds] = { 3, 1, 1, 3 };
+    const uint32_t au32Acks[][2] = {
+        { (uint32_t)LogCommand::DisableSites, 2 },
+        { (uint32_t)LogCommand::DisableSites, 0 },
+        { (uint32_t)LogCommand::EnableAll, 2 },
+    };
+    int aiRecords[rounds] = {};
+    size_t uAcks = 0;
+    LogStream clStream(clCapture.data(), clCapture.size());
+    LogRecord stRecord;
+    while (clStream.Next(&stRecord)) {
+        LogArgReader clArgs(stRecord);
+        LogArg stArg;
+        if (stRecord.header.file_id != system_file_id) {
+            if (clArgs.Next(&stArg) && (stArg.AsUnsigned() < rounds)) {
+                aiRecords[stArg.AsUnsigned()]++;
+            }
+            continue;
+        }
+        if (stRecord.header.line != (uint16_t)LogSystemRecord::SiteFilter) {
+            continue;
+        }
+        auto bMatch = (uAcks < (sizeof(au32Acks) / sizeof(au32Acks[0])));
+        bMatch = bMatch && clArgs.Next(&stArg) && (stArg.AsUnsigned() == au32Acks[uAcks][0]);
+        bMatch = bMatch && clArgs.Next(&stArg) && (stArg.AsUnsigned() == au32Acks[uAcks][1]);
+        Check(bMatch, "acknowledgement");
+        uAcks++;
+    }
+    Check(uAcks == (sizeof(au32Acks) / sizeof(au32Acks[0])), "acknowledgement count");
+    for (auto i = 0; i < rounds; i++) {
+        Check(aiRecords[i] == aiExpected[i], "records logged by enabled sites");
+    }
+
+    printf("%s\n", iFailures ? "site filter test failed" : "site filter test passed");
+    return iFailures ? 1 : 0;
+}
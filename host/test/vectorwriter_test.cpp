@@ -0,0 +1,189 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file vectorwriter_test.cpp Flushing through a vectored writer that accepts partial writes
+
+  Two shards, with duplicate coalescing, stats and metrics enabled, are
+  flushed through a vectored writer that accepts a random number of bytes per
+  call (often none), as a non-blocking driver with a nearly full queue would.
+  The capture must decode without a byte skipped: each call logged appears
+  as a record or in a repeat count, and the counter's summaries add up to the
+  events counted.  Build and run it from this directory:
+
+    g++ -std=gnu++11 -I. -I.. -I../../src/public -DLOGBUF_STATS -DLOGBUF_SHARD_COUNT=2 \
+        -D__FILENAME__=vectorwriter_test.cpp vectorwriter_test.cpp ../logstream.cpp ../logdecompress.cpp \
+        ../tickclock.cpp ../metricseries.cpp ../sitestats.cpp ../../src/logbuf.cpp ../../src/logcompress.cpp \
+        ../../src/logmetric.cpp -o vectorwriter_test
+    ./vectorwriter_test
+ */
+#include "mark3.h"
+#include "logbuf.h"
+#include "logmacro.h"
+#include "logstream.h"
+#include "metricseries.h"
+#include "sitestats.h"
+
+#include <stdio.h>
+
+#include <vector>
+
+EMIT_DBG_HEADER();
+
+using namespace Mark3;
+
+LOG_COUNTER(clEvents, "events");
+
+namespace {
+//---------------------------------------------------------------------------
+constexpr int calls = 4000;
+constexpr int flushesPerCall = 3;
+constexpr size_t maxAccepted = 24;      // Most bytes accepted by a single write
+constexpr uint32_t intervalMs = 20;     // Stats and metric interval
+
+uint32_t u32Ticks = 0;
+uint8_t u8Context = 0;
+uint32_t u32Seed = 1;
+bool bLimited = true;
+uint32_t u32ShortWrites = 0;
+std::vector<uint8_t> clCapture;
+int iFailures = 0;
+
+//---------------------------------------------------------------------------
+// Accept a pseudo-random number of bytes, from none to maxAccepted
+size_t PartialWriter(const LogIoVec_t* pstVec_, int iCount_)
+{
+    u32Seed = (u32Seed * 1103515245) + 12345;
+    auto uBudget = bLimited ? ((u32Seed >> 16) % (maxAccepted + 1)) : (size_t)-1;
+    size_t uWritten = 0;
+    for (auto i = 0; i < iCount_; i++) {
+        auto uLen = (pstVec_[i].length < uBudget) ? pstVec_[i].length : uBudget;
+        auto* pu8Data = (const uint8_t*)pstVec_[i].data;
+        clCapture.insert(clCapture.end(), pu8Data, pu8Data + uLen);
+        uWritten += uLen;
+        uBudget -= uLen;
+        if (uLen < pstVec_[i].length) {
+            u32ShortWrites++;
+            break;
+        }
+    }
+    return uWritten;
+}
+
+//---------------------------------------------------------------------------
+uint8_t SelectShard()
+{
+    return u8Context;
+}
+
+//---------------------------------------------------------------------------
+void Check(bool bOk_, const char* szWhat_)
+{
+    if (!bOk_) {
+        printf("FAIL: %s\n", szWhat_);
+        iFailures++;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Runs of identical records (coalesced into repeat counts) alternate with
+// records that differ, from each context in turn.
+void LogCall(int iCall_)
+{
+    u32Ticks++;
+    u8Context = (uint8_t)((iCall_ / 50) % LOGBUF_SHARD_COUNT);
+    if (((iCall_ / 7) % 3) == 0) {
+        DEBUG_LOG("steady %d\n", TagInt32, 5);
+    } else {
+        DEBUG_LOG("value %d\n", TagInt32, iCall_);
+    }
+    clEvents.Add();
+}
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+uint32_t Mark3::Kernel::GetTicks()
+{
+    return u32Ticks;
+}
+
+//---------------------------------------------------------------------------
+int main()
+{
+    LogBuf::Instance().SetVectorWriter(PartialWriter);
+    LogBuf::SetShardSelector(SelectShard);
+    LogBuf::SetMetricInterval(intervalMs);
+    for (auto i = 0; i < LOGBUF_SHARD_COUNT; i++) {
+        LogBuf::Shard(i).SetCoalescing(true);
+        LogBuf::Shard(i).SetStatsInterval(intervalMs);
+    }
+
+    for (auto i = 0; i < calls; i++) {
+        LogCall(i);
+        for (auto j = 0; j < flushesPerCall; j++) {
+            LogBuf::FlushAll();
+        }
+    }
+
+    // Drain what's left, with a final round of stats and metrics
+    bLimited = false;
+    u32Ticks += intervalMs;
+    for (auto j = 0; j < flushesPerCall; j++) {
+        LogBuf::FlushAll();
+    }
+    Check(u32ShortWrites > (calls / 10), "writer accepted partial writes");
+
+    uint32_t u32Logged = 0;
+    uint32_t u32Counted = 0;
+    uint32_t u32StatsRecords = 0;
+    uint32_t u32Overruns = 0;
+    LogStream clStream(clCapture.data(), clCapture.size());
+    LogRecord stRecord;
+    while (clStream.Next(&stRecord)) {
+        if (stRecord.header.file_id != system_file_id) {
+            u32Logged++;
+            continue;
+        }
+        LogArgReader clArgs(stRecord);
+        LogArg stArg;
+        MetricSummary stSummary;
+        TargetStats stStats;
+        switch ((LogSystemRecord)stRecord.header.line) {
+            case LogSystemRecord::Repeat:
+                if (clArgs.Next(&stArg)) {
+                    u32Logged += (uint32_t)stArg.AsUnsigned();
+                }
+                break;
+            case LogSystemRecord::Metric:
+                if (DecodeMetric(stRecord, &stSummary)) {
+                    u32Counted += stSummary.count;
+                }
+                break;
+            case LogSystemRecord::Stats:
+                if (DecodeTargetStats(stRecord, &stStats)) {
+                    u32StatsRecords++;
+                    u32Overruns += stStats.overruns;
+                }
+                break;
+            default: break;
+        }
+    }
+    Check(clStream.GetSkippedBytes() == 0, "no bytes skipped");
+    Check(u32Overruns == 0, "no overruns");
+    Check(u32Logged == calls, "calls logged, as records or repeat counts");
+    Check(u32Counted == calls, "events in counter summaries");
+    Check(u32StatsRecords >= (calls / intervalMs), "stats records");
+
+    printf("%s\n", iFailures ? "vectored writer test failed" : "vectored writer test passed");
+    return iFailures ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file textbuf.h Bounded formatting into fixed-size text buffers, shared by the renderers
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+//---------------------------------------------------------------------------
+// Clamp snprintf()'s return value to what was actually written
+inline size_t Written(int iRc_, size_t uLen_)
+{
+    if (iRc_ < 0 || !uLen_) {
+        return 0;
+    }
+    return ((size_t)iRc_ >= uLen_) ? (uLen_ - 1) : (size_t)iRc_;
+}
+
+//---------------------------------------------------------------------------
+// snprintf() wrapper that keeps a running offset into the output buffer
+template <typename... Args>
+void Append(char* szOut_, size_t uLen_, size_t* puOut_, const char* szFormat_, Args... args_)
+{
+    if (*puOut_ < uLen_) {
+        *puOut_ += Written(snprintf(&szOut_[*puOut_], uLen_ - *puOut_, szFormat_, args_...), uLen_ - *puOut_);
+    }
+}
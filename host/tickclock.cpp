@@ -0,0 +1,31 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file tickclock.cpp 32-bit tick unwrapping and tick-to-wall-clock correlation
+ */
+#include "tickclock.h"
+
+//---------------------------------------------------------------------------
+void TickClock::Sync(uint64_t u64Ticks_, uint64_t u64EpochUs_)
+{
+    if (m_iSyncCount && (u64Ticks_ > m_u64SyncTicks) && (u64EpochUs_ > m_u64SyncEpochUs)) {
+        m_dUsPerTick = (double)(u64EpochUs_ - m_u64SyncEpochUs) / (double)(u64Ticks_ - m_u64SyncTicks);
+    } else if (m_iSyncCount) {
+        // Wall-clock stepped backwards (i.e. RTC was set) - can't measure a rate
+        m_dUsPerTick = m_dNominalUsPerTick;
+    }
+    m_u64SyncTicks = u64Ticks_;
+    m_u64SyncEpochUs = u64EpochUs_;
+    m_iSyncCount++;
+}
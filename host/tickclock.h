@@ -0,0 +1,147 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file tickclock.h 32-bit tick unwrapping and tick-to-wall-clock correlation
+ */
+#pragma once
+
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The TickClock class
+ *
+ * Extends the 32-bit kernel tick timestamps carried by each record into a
+ * monotonic 64-bit timeline, and maps that timeline onto wall-clock time using
+ * the clock-sync records written by LogBuf::WriteClockSync().
+ *
+ * Unwrapping uses serial-number arithmetic relative to the previous timestamp,
+ * so records that arrive slightly out of order (i.e. from a pre-empted writer)
+ * are placed correctly on either side of a wrap.  Wall-clock time is computed
+ * relative to the most recent sync point, at a rate measured between the two
+ * most recent sync points (or the nominal rate until two have been seen).
+ */
+class TickClock {
+public:
+    /**
+     * @brief TickClock
+     * @param dUsPerTick_ Nominal duration of a tick, in microseconds
+     */
+    TickClock(double dUsPerTick_ = 1000.0)
+    : m_dUsPerTick{dUsPerTick_}
+    , m_dNominalUsPerTick{dUsPerTick_}
+    {}
+
+    /**
+     * @brief SetUsPerTick
+     * @param dUsPerTick_ Nominal duration of a tick, in microseconds
+     */
+    void SetUsPerTick(double dUsPerTick_)
+    {
+        m_dNominalUsPerTick = dUsPerTick_;
+        if (m_iSyncCount < 2) {
+            m_dUsPerTick = dUsPerTick_;
+        }
+    }
+
+    /**
+     * @brief Unwrap
+     * @param u32Ticks_ Raw 32-bit timestamp from a record header
+     * @return Timestamp on the unwrapped 64-bit timeline
+     */
+    uint64_t Unwrap(uint32_t u32Ticks_)
+    {
+        if (!m_bStarted) {
+            m_bStarted = true;
+            m_u64Last = u32Ticks_;
+            return m_u64Last;
+        }
+        auto i32Delta = (int32_t)(u32Ticks_ - (uint32_t)m_u64Last);
+        if ((i32Delta < 0) && ((uint64_t)(-(int64_t)i32Delta) > m_u64Last)) {
+            // Can't step back before the start of the timeline
+            return u32Ticks_;
+        }
+        m_u64Last += i32Delta;
+        return m_u64Last;
+    }
+
+    /**
+     * @brief Rebase
+     *
+     * Re-anchor the unwrapped timeline at a full 64-bit timestamp extended by
+     * the target (i.e. from a clock-rate record), so that gaps longer than the
+     * 32-bit timestamp's period don't leave the timeline behind.
+     *
+     * @param u64Ticks_ Timestamp extended to 64 bits by the target
+     */
+    void Rebase(uint64_t u64Ticks_)
+    {
+        m_bStarted = true;
+        m_u64Last = u64Ticks_;
+    }
+
+    /**
+     * @brief Restart
+     *
+     * Start a new timeline at the next timestamp, i.e. for records logged
+     * before or after a reset of the target.
+     */
+    void Restart()
+    {
+        m_bStarted = false;
+    }
+
+    /**
+     * @brief Sync
+     *
+     * Register a correlation point between the tick timeline and wall-clock time
+     *
+     * @param u64Ticks_ Unwrapped timestamp of the clock-sync record
+     * @param u64EpochUs_ Wall-clock time of the record, in microseconds since the epoch
+     */
+    void Sync(uint64_t u64Ticks_, uint64_t u64EpochUs_);
+
+    /**
+     * @brief IsSynced
+     * @return true once at least one clock-sync record has been seen
+     */
+    bool IsSynced() const { return m_iSyncCount > 0; }
+
+    /**
+     * @brief GetUsPerTick
+     * @return Current estimate of the duration of a tick, in microseconds
+     */
+    double GetUsPerTick() const { return m_dUsPerTick; }
+
+    /**
+     * @brief ToEpochUs
+     * @param u64Ticks_ Unwrapped timestamp
+     * @return Wall-clock time in microseconds since the epoch (only meaningful
+     *         once IsSynced() returns true)
+     */
+    int64_t ToEpochUs(uint64_t u64Ticks_) const
+    {
+        auto dDelta = ((double)u64Ticks_ - (double)m_u64SyncTicks) * m_dUsPerTick;
+        return (int64_t)m_u64SyncEpochUs + (int64_t)dDelta;
+    }
+
+private:
+    bool        m_bStarted = false;
+    uint64_t    m_u64Last = 0;
+    double      m_dUsPerTick;
+    double      m_dNominalUsPerTick;
+    int         m_iSyncCount = 0;
+    uint64_t    m_u64SyncTicks = 0;
+    uint64_t    m_u64SyncEpochUs = 0;
+};
@@ -0,0 +1,185 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file traceexport.cpp Chrome Trace / Perfetto JSON export of decoded records
+ */
+#include "traceexport.h"
+#include "logformat.h"
+
+#include <string.h>
+
+//---------------------------------------------------------------------------
+namespace {
+    constexpr auto maxMessageLength = 1024;
+
+    // Track keys use a line number outside the uint16_t range to denote the
+    // per-file track
+    constexpr uint32_t fileTrackLine = 0x10000;
+
+    // ...and lines above it to denote the per-shard track holding traced scopes
+    constexpr uint32_t scopeTrackLine = 0x20000;
+
+    void WriteJsonString(FILE* pstOut_, const char* szString_)
+    {
+        fputc('"', pstOut_);
+        for (; *szString_; szString_++) {
+            auto c = (unsigned char)*szString_;
+            switch (c) {
+                case '"': fputs("\\\"", pstOut_); break;
+                case '\\': fputs("\\\\", pstOut_); break;
+                case '\n': fputs("\\n", pstOut_); break;
+                case '\r': fputs("\\r", pstOut_); break;
+                case '\t': fputs("\\t", pstOut_); break;
+                default:
+                    if (c < 0x20) {
+                        fprintf(pstOut_, "\\u%04x", c);
+                    } else {
+                        fputc(c, pstOut_);
+                    }
+                    break;
+            }
+        }
+        fputc('"', pstOut_);
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+TraceExporter::TraceExporter(LoggerParser* pclDictionary_, FILE* pstOut_, const TickClock* pclClock_, bool bPerSite_,
+                             const ElfImage* pclImage_)
+: m_pclDictionary{pclDictionary_}
+, m_pclImage{pclImage_}
+, m_pstOut{pstOut_}
+, m_pclClock{pclClock_}
+, m_bPerSite{bPerSite_}
+, m_bFirst{true}
+, m_u32NextTrack{1}
+{}
+
+//---------------------------------------------------------------------------
+void TraceExporter::Begin()
+{
+    fprintf(m_pstOut, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    m_bFirst = true;
+}
+
+//---------------------------------------------------------------------------
+void TraceExporter::End()
+{
+    fprintf(m_pstOut, "\n]}\n");
+    fflush(m_pstOut);
+}
+
+//---------------------------------------------------------------------------
+uint32_t TraceExporter::Track(uint32_t fileHash_, uint32_t line_)
+{
+    auto u64Key = ((uint64_t)fileHash_ << 32) | line_;
+    auto it = m_clTracks.find(u64Key);
+    if (it != m_clTracks.end()) {
+        return it->second;
+    }
+
+    auto u32Track = m_u32NextTrack++;
+    m_clTracks[u64Key] = u32Track;
+
+    // Name the new track after its file (and line, for per-site tracks)
+    char szName[maxMessageLength];
+    auto* pclFile = m_pclDictionary ? m_pclDictionary->FindFile(fileHash_) : nullptr;
+    if ((fileHash_ == system_file_id) && (line_ >= scopeTrackLine)) {
+        snprintf(szName, sizeof(szName), "scopes:%u", line_ - scopeTrackLine);
+        line_ = fileTrackLine;
+    } else if (fileHash_ == system_file_id) {
+        snprintf(szName, sizeof(szName), "logger");
+    } else if (pclFile) {
+        snprintf(szName, sizeof(szName), "%s", pclFile->filename);
+    } else {
+        snprintf(szName, sizeof(szName), "%08x", fileHash_);
+    }
+    if (line_ != fileTrackLine) {
+        auto len = strlen(szName);
+        snprintf(&szName[len], sizeof(szName) - len, ":%u", line_);
+    }
+
+    fprintf(m_pstOut, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+            m_bFirst ? "" : ",\n", u32Track);
+    WriteJsonString(m_pstOut, szName);
+    fprintf(m_pstOut, "}}");
+    m_bFirst = false;
+    return u32Track;
+}
+
+//---------------------------------------------------------------------------
+void TraceExporter::WriteEvent(const char* szName_, char cPhase_, uint64_t u64Timestamp_, uint32_t u32Track_, uint16_t u16Line_)
+{
+    fprintf(m_pstOut, "%s{\"name\":", m_bFirst ? "" : ",\n");
+    WriteJsonString(m_pstOut, szName_);
+    fprintf(m_pstOut, ",\"ph\":\"%c\",%s\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"line\":%u}}",
+            cPhase_,
+            (cPhase_ == 'i') ? "\"s\":\"t\"," : "",
+            u64Timestamp_ * m_pclClock->GetUsPerTick(),
+            u32Track_,
+            u16Line_);
+    m_bFirst = false;
+}
+
+//---------------------------------------------------------------------------
+void TraceExporter::Add(const LogRecord& stRecord_)
+{
+    auto& header = stRecord_.header;
+    auto* pclLine = m_pclDictionary ? m_pclDictionary->FindLogLine(header.file_id, header.line) : nullptr;
+
+    // Traced scopes open and close slices on a track per shard, as scopes
+    // only nest within the context that traced them
+    if ((header.file_id == system_file_id)
+        && ((header.line == (uint16_t)LogSystemRecord::ScopeBegin) || (header.line == (uint16_t)LogSystemRecord::ScopeEnd))) {
+        LogArgReader clArgs(stRecord_);
+        LogArg stArg;
+        if (clArgs.Next(&stArg)) {
+            char szScope[16];
+            auto* szName = m_pclDictionary ? m_pclDictionary->FindScope((uint32_t)stArg.AsUnsigned()) : nullptr;
+            if (!szName) {
+                snprintf(szScope, sizeof(szScope), "%08x", (uint32_t)stArg.AsUnsigned());
+                szName = szScope;
+            }
+            auto u32Track = Track(system_file_id, scopeTrackLine + stRecord_.shard);
+            WriteEvent(szName, (header.line == (uint16_t)LogSystemRecord::ScopeBegin) ? 'B' : 'E',
+                       stRecord_.timestamp, u32Track, header.line);
+            return;
+        }
+    }
+
+    char szMessage[maxMessageLength];
+    if (header.file_id == system_file_id) {
+        snprintf(szMessage, sizeof(szMessage), "%s", LogSystemRecordName(header.line));
+    } else if (pclLine) {
+        LogFormatter::Format(szMessage, sizeof(szMessage), pclLine->m_szFormatString, stRecord_, m_pclImage);
+    } else {
+        snprintf(szMessage, sizeof(szMessage), "%08x:%u", header.file_id, header.line);
+    }
+
+    // Trailing newlines are meaningless in a trace viewer
+    auto len = strlen(szMessage);
+    while (len && (szMessage[len - 1] == '\n' || szMessage[len - 1] == '\r')) {
+        szMessage[--len] = '\0';
+    }
+
+    // Opt-in duration slices: "B|name" opens, "E|name" closes
+    if ((szMessage[0] == 'B' || szMessage[0] == 'E') && szMessage[1] == '|') {
+        auto u32Track = Track(header.file_id, fileTrackLine);
+        WriteEvent(&szMessage[2], szMessage[0], stRecord_.timestamp, u32Track, header.line);
+        return;
+    }
+
+    auto u32Track = Track(header.file_id, m_bPerSite ? header.line : fileTrackLine);
+    WriteEvent(szMessage, 'i', stRecord_.timestamp, u32Track, header.line);
+}
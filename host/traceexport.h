@@ -0,0 +1,104 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file traceexport.h Chrome Trace / Perfetto JSON export of decoded records
+
+  Each record is written as an instant event, on a track per source file (or
+  per log site).  Records whose format string starts with "B|" or "E|" open and
+  close a duration slice, named by the rest of the formatted message:
+
+  @code
+    DEBUG_LOG("B|dispatch %d", TagUint8, id);
+    ...
+    DEBUG_LOG("E|dispatch");
+  @endcode
+
+  Slices are always placed on the per-file track, so a begin/end pair in the
+  same file nests correctly regardless of the track mode.
+
+  Scopes traced with TRACE_SCOPE(), TRACE_BEGIN() and TRACE_END() are written
+  as slices on a track per shard, named from the .logger dictionary.
+ */
+#pragma once
+
+#include "elfimage.h"
+#include "loggerparser.h"
+#include "logstream.h"
+#include "tickclock.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <unordered_map>
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The TraceExporter class
+ *
+ * Streams trace events as records are added, so memory use is independent of
+ * the size of the capture.
+ */
+class TraceExporter {
+public:
+    /**
+     * @brief TraceExporter
+     *
+     * @param pclDictionary_ Parsed .logger dictionary
+     * @param pstOut_ Stream to write JSON to
+     * @param pclClock_ Clock used to convert timestamps to microseconds (the
+     *        stream's clock, which tracks any clock-rate records in the capture)
+     * @param bPerSite_ true to place each log site on its own track, false to
+     *        use one track per source file
+     * @param pclImage_ Target image used to resolve constant strings and symbolize pointers, or nullptr
+     */
+    TraceExporter(LoggerParser* pclDictionary_, FILE* pstOut_, const TickClock* pclClock_, bool bPerSite_,
+                  const ElfImage* pclImage_ = nullptr);
+
+    /**
+     * @brief Begin
+     *
+     * Write the start of the JSON document
+     */
+    void Begin();
+
+    /**
+     * @brief Add
+     *
+     * Write the trace event(s) corresponding to a record
+     *
+     * @param stRecord_ Record to export
+     */
+    void Add(const LogRecord& stRecord_);
+
+    /**
+     * @brief End
+     *
+     * Terminate the JSON document
+     */
+    void End();
+
+private:
+    uint32_t Track(uint32_t fileHash_, uint32_t line_);
+    void WriteEvent(const char* szName_, char cPhase_, uint64_t u64Timestamp_, uint32_t u32Track_, uint16_t u16Line_);
+
+    LoggerParser*   m_pclDictionary;
+    const ElfImage* m_pclImage;
+    FILE*           m_pstOut;
+    const TickClock* m_pclClock;
+    bool            m_bPerSite;
+    bool            m_bFirst;
+    uint32_t        m_u32NextTrack;
+
+    std::unordered_map<uint64_t, uint32_t> m_clTracks;
+};
@@ -16,21 +16,161 @@ See license.txt for more information
  */
 #include "logbuf.h"
 
+#include "crc16.h"
+#include "crc32.h"
+#include "logcompress.h"
+#include "logmetric.h"
 #include "mark3.h"
 
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#if defined(LOGBUF_NOINIT)
+#include <new>
+#endif
+
 using namespace Mark3;
 
 //---------------------------------------------------------------------------
 namespace {
     constexpr auto syncBegin = 0xCAFE;
     constexpr auto syncEnd = 0xF00D;
-    LogBuf clLogBuf;
+#if defined(LOGBUF_FRAMING)
+    // Records carry a sequence number following the header, and a CRC ahead
+    // of the end sync word.
+    constexpr uint8_t recordFlags = log_flag_sequence | log_flag_crc;
+    constexpr int framingLength = 2 * sizeof(uint16_t);
+#else
+    constexpr uint8_t recordFlags = 0;
+    constexpr int framingLength = 0;
+#endif
+    // Length of a repeat record written to the ring, including its sync words
+    constexpr int repeatLength = (2 * sizeof(uint16_t)) + sizeof(LogHeader_t) + sizeof(uint8_t) + sizeof(uint32_t)
+                                 + framingLength;
+#if defined(LOGBUF_NOINIT)
+    LogBuf aclLogBuf[LOGBUF_SHARD_COUNT] __attribute__((section(".noinit")));
+#else
+    LogBuf aclLogBuf[LOGBUF_SHARD_COUNT];
+#endif
 } // anonymous namespace
 
+//---------------------------------------------------------------------------
+LogTimestamp_t LogBuf::m_pfTimestamp = LogBuf::KernelTimestamp;
+uint32_t LogBuf::m_u32TimestampHz = 1000;  // Kernel ticks are 1ms
+LogShardSelect_t LogBuf::m_pfShardSelect = nullptr;
+LogInIsr_t LogBuf::m_pfInIsr = nullptr;
+uint32_t LogBuf::m_u32TriggerFile = system_file_id;
+uint16_t LogBuf::m_u16TriggerLine = 0;
+uint32_t LogBuf::m_u32MetricInterval = 1000;
+uint32_t LogBuf::m_u32MetricTimestamp = 0;
+#if defined(LOGBUF_STATS)
+LogTimestamp_t LogBuf::m_pfStatsClock = nullptr;
+uint32_t LogBuf::m_u32StatsClockHz = 0;
+#endif
+#if defined(LOGBUF_SITE_FILTER)
+uint32_t LogBuf::m_au32SiteDisabled[(LOGBUF_MAX_SITES + 31) / 32] = {};
+#endif
+
 //---------------------------------------------------------------------------
 LogBuf& LogBuf::Instance()
 {
-    return clLogBuf;
+    return aclLogBuf[0];
+}
+
+//---------------------------------------------------------------------------
+LogBuf& LogBuf::Shard(uint8_t u8Shard_)
+{
+    return aclLogBuf[(u8Shard_ < LOGBUF_SHARD_COUNT) ? u8Shard_ : 0];
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::Recover()
+{
+#if defined(LOGBUF_NOINIT)
+    auto bRecovered = false;
+    for (auto i = 0; i < LOGBUF_SHARD_COUNT; i++) {
+        auto& clShard = aclLogBuf[i];
+        auto stFlight = clShard.m_stFlight;
+
+        // The buffers aren't initialized at startup, so construct them in place,
+        // leaving the flight recorder header and ring untouched.
+        new (&clShard) LogBuf;
+
+        auto bValid = (stFlight.magic == flight_recorder_magic)
+                      && (stFlight.crc == crc32_nibble(&stFlight, offsetof(LogFlightHeader_t, crc)))
+                      && (stFlight.size == m_uBufferSize)
+                      && (stFlight.read_idx <= m_uBufferSize)
+                      && (stFlight.last_read_idx <= m_uBufferSize);
+        if (bValid && (stFlight.read_idx != stFlight.last_read_idx)) {
+            // Records that were still being written at the time are discarded
+            clShard.m_iWriteIdx = stFlight.read_idx;
+            clShard.m_iReadIdx = stFlight.read_idx;
+            clShard.m_iLastReadIdx = stFlight.last_read_idx;
+            clShard.m_iPostMortemEnd = stFlight.read_idx;
+            clShard.m_bPending = true;
+            clShard.m_bPostMortem = true;
+            bRecovered = true;
+        }
+
+        clShard.m_stFlight.magic = flight_recorder_magic;
+        clShard.m_stFlight.shard = i;
+        clShard.m_stFlight.shard_count = LOGBUF_SHARD_COUNT;
+        clShard.m_stFlight.size = m_uBufferSize;
+        clShard.UpdateFlightHeader();
+    }
+    return bRecovered;
+#else
+    return false;
+#endif
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::UpdateFlightHeader()
+{
+#if defined(LOGBUF_NOINIT)
+    m_stFlight.read_idx = m_iReadIdx;
+    m_stFlight.last_read_idx = m_iLastReadIdx;
+    m_stFlight.crc = crc32_nibble(&m_stFlight, offsetof(LogFlightHeader_t, crc));
+#endif
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetShardSelector(LogShardSelect_t pfShardSelect_)
+{
+    m_pfShardSelect = pfShardSelect_;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::FlushAll()
+{
+    // Shards share the writer, so nothing may be written between the head of
+    // a record it only partly accepted and the tail. A shard left retaining
+    // such a tail is flushed first on the next call, and the others wait
+    // until it has been completed.
+    static auto iFirst = 0;
+    for (auto i = 0; i < LOGBUF_SHARD_COUNT; i++) {
+        auto iShard = (iFirst + i) % LOGBUF_SHARD_COUNT;
+        aclLogBuf[iShard].FlushData();
+        if (aclLogBuf[iShard].m_bRetained) {
+            iFirst = iShard;
+            return;
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetSingleProducer(bool bSingleProducer_)
+{
+    m_bSingleProducer = bSingleProducer_;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetCoalescing(bool bEnable_)
+{
+    CriticalSection::Enter();
+    m_bCoalesce = bEnable_;
+    m_iLastRecord = -1;
+    CriticalSection::Exit();
 }
 
 //---------------------------------------------------------------------------
@@ -40,55 +180,586 @@ void LogBuf::SetNotifyCallback(LogNotification_t pfHandler_)
 }
 
 //---------------------------------------------------------------------------
-void LogBuf::SetLogWriter(LogWrite_t pfLogWriter_)
+void LogBuf::SetNotifyThresholds(uint16_t u16HighWatermark_, uint16_t u16LowWatermark_, uint16_t u16RecordCount_)
+{
+    CriticalSection::Enter();
+    m_u16HighWatermark = u16HighWatermark_;
+    m_u16LowWatermark = u16LowWatermark_;
+    m_u16RecordTrigger = u16RecordCount_;
+    m_u16Records = 0;
+    CriticalSection::Exit();
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetNotifyInterval(uint32_t u32MinInterval_)
+{
+    m_u32NotifyInterval = u32MinInterval_;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetNotifyDeferral(LogInIsr_t pfInIsr_)
+{
+    m_pfInIsr = pfInIsr_;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::ServiceNotify()
+{
+    for (auto& clShard : aclLogBuf) {
+        if (clShard.m_bNotifyDeferred) {
+            clShard.NotifyFlush();
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetSnapshotMode(bool bEnable_, uint16_t u16PostTrigger_)
+{
+    FlushData();
+
+    CriticalSection::Enter();
+    m_bSnapshot = bEnable_;
+    m_u16PostTrigger = u16PostTrigger_;
+    m_bSnapshotWrapped = false;
+    m_bTriggered = false;
+    m_bFrozen = false;
+    m_bPending = false;
+    __atomic_store_n(&m_iLastReadIdx, __atomic_load_n(&m_iReadIdx, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+#if defined(LOGBUF_NOINIT)
+    UpdateFlightHeader();
+#endif
+    CriticalSection::Exit();
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::TriggerSnapshot(bool bFreeze_)
+{
+    for (auto& clShard : aclLogBuf) {
+        clShard.Trigger(bFreeze_);
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetTriggerSite(uint32_t u32FileId_, uint16_t u16Line_)
+{
+    CriticalSection::Enter();
+    m_u32TriggerFile = u32FileId_;
+    m_u16TriggerLine = u16Line_;
+    CriticalSection::Exit();
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::Trigger(bool bFreeze_)
+{
+    auto doNotify = false;
+
+    CriticalSection::Enter();
+    if (m_bSnapshot && !m_bTriggered) {
+        m_bTriggered = true;
+        m_u32TriggerTimestamp = GetTimestamp();
+        // The trigger record goes after the last record reserved before the
+        // trigger -- or with a single producer, which may have been pre-empted
+        // part way through reserving a record, the last record committed.
+        m_iTriggerIdx = m_bSingleProducer ? __atomic_load_n(&m_iReadIdx, __ATOMIC_ACQUIRE) : m_iWriteIdx;
+        m_iTriggerFill = 0;
+        m_u16PostRemaining = m_u16PostTrigger;
+    }
+    if (m_bTriggered && !m_bFrozen && (bFreeze_ || !m_u16PostRemaining)) {
+        m_bFrozen = true;
+        // Records still being written signal the flushing context once committed
+        if (m_iCount) {
+            m_bDoNotify = true;
+        } else {
+            doNotify = true;
+        }
+    }
+    CriticalSection::Exit();
+
+    if (doNotify) {
+        NotifyFlush();
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetLogWriter(LogWrite_t pfLogWriter_, LogCompressor* pclCompressor_)
 {
     m_pfLogWriter = pfLogWriter_;
+    m_pfVectorWriter = nullptr;
+    m_pclCompressor = pclCompressor_;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetVectorWriter(LogWriteV_t pfVectorWriter_)
+{
+    m_pfVectorWriter = pfVectorWriter_;
+    m_pfLogWriter = nullptr;
+    m_pclCompressor = nullptr;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::SetTimestampSource(LogTimestamp_t pfTimestamp_, uint32_t u32FrequencyHz_)
+{
+    CriticalSection::Enter();
+    m_pfTimestamp = pfTimestamp_ ? pfTimestamp_ : KernelTimestamp;
+    m_u32TimestampHz = u32FrequencyHz_;
+    auto timestamp = m_pfTimestamp();
+    for (auto& clShard : aclLogBuf) {
+        clShard.m_u32LastTimestamp = timestamp;
+        clShard.m_u32TimestampHigh = 0;
+    }
+    CriticalSection::Exit();
+
+    Current().WriteClockRate();
+}
+
+#if defined(LOGBUF_STATS)
+//---------------------------------------------------------------------------
+void LogBuf::SetStatsClock(LogTimestamp_t pfClock_, uint32_t u32FrequencyHz_)
+{
+    CriticalSection::Enter();
+    m_pfStatsClock = pfClock_;
+    m_u32StatsClockHz = pfClock_ ? u32FrequencyHz_ : 0;
+    CriticalSection::Exit();
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::GetStats(LogStats_t* pstStats_)
+{
+    CriticalSection::Enter();
+    *pstStats_ = m_stStats;
+    CriticalSection::Exit();
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::ResetStats()
+{
+    CriticalSection::Enter();
+    m_stStats = {};
+    CriticalSection::Exit();
+}
+#endif
+
+//---------------------------------------------------------------------------
+uint32_t LogBuf::KernelTimestamp()
+{
+    return Kernel::GetTicks();
+}
+
+//---------------------------------------------------------------------------
+uint64_t LogBuf::ExtendTimestamp(uint32_t timestamp_)
+{
+    // Serial-number arithmetic, so timestamps read by writers that were
+    // pre-empted before reaching this point don't count as a wrap.
+    if ((int32_t)(timestamp_ - m_u32LastTimestamp) > 0) {
+        if (timestamp_ < m_u32LastTimestamp) {
+            m_u32TimestampHigh++;
+        }
+        m_u32LastTimestamp = timestamp_;
+    }
+    auto high = m_u32TimestampHigh;
+    if ((timestamp_ > m_u32LastTimestamp) && (high > 0)) {
+        // A late timestamp from before the most recent wrap
+        high--;
+    }
+    return ((uint64_t)high << 32) | timestamp_;
+}
+
+//---------------------------------------------------------------------------
+uint64_t LogBuf::GetTimestamp64()
+{
+    CriticalSection::Enter();
+    auto timestamp = ExtendTimestamp(m_pfTimestamp());
+    CriticalSection::Exit();
+    return timestamp;
 }
 
 //---------------------------------------------------------------------------
 void LogBuf::WriteLog(int length_, const LogHeader_t* header_, const Tlv_t data_[])
 {
-    auto idx_ = BeginWrite(length_);
-    idx_ = Write(idx_, header_, sizeof(LogHeader_t));
+    // Copied strings and blobs are variable-length, so their contents aren't
+    // included in the length computed by the caller.
+    for (auto i = 0; i < header_->log_count; i++) {
+        if (data_[i].tag == (unsigned int)LogTag::LogTagStrcopy) {
+            length_ += ArgLength(data_[i].value.v_TagStrcopy);
+        } else if (data_[i].tag == (unsigned int)LogTag::LogTagBlob) {
+            length_ += ArgLength(data_[i].value.v_TagBlob);
+        }
+    }
+
+    auto start = BeginLog(length_, header_->file_id, header_->line, header_->log_count, header_->timestamp);
+    if (start < 0) {
+        return;
+    }
+    auto idx_ = start;
     for (auto i = 0; i < header_->log_count; i++) {
-        idx_ = Write(idx_, &data_[i], sizeof(uint8_t) + data_[i].length);
+        auto tlv = *(const uint8_t*)&data_[i];
+        if (data_[i].tag == (unsigned int)LogTag::LogTagStrcopy) {
+            idx_ = WriteArg(idx_, tlv, data_[i].value.v_TagStrcopy);
+        } else if (data_[i].tag == (unsigned int)LogTag::LogTagBlob) {
+            idx_ = WriteArg(idx_, tlv, data_[i].value.v_TagBlob);
+        } else {
+            idx_ = Write(idx_, &data_[i], sizeof(uint8_t) + data_[i].length);
+        }
+    }
+    EndLog(start, idx_);
+}
+
+//---------------------------------------------------------------------------
+int LogBuf::BeginLog(int length_, uint32_t u32FileId_, uint16_t u16Line_, uint8_t u8Count_, uint32_t u32Timestamp_)
+{
+    if ((u32FileId_ == m_u32TriggerFile) && (u16Line_ == m_u16TriggerLine) && (u32FileId_ != system_file_id)) {
+        TriggerSnapshot();
+    }
+    uint16_t u16Sequence;
+    auto idx = BeginWrite(length_ + framingLength, u32Timestamp_, &u16Sequence);
+    if (idx < 0) {
+        return idx;
+    }
+    return PutHeader(idx, u32FileId_, u16Line_, u8Count_, u32Timestamp_, u16Sequence);
+}
+
+//---------------------------------------------------------------------------
+int LogBuf::PutHeader(int idx_, uint32_t u32FileId_, uint16_t u16Line_, uint8_t u8Count_, uint32_t u32Timestamp_,
+                      uint16_t u16Sequence_)
+{
+    struct __attribute__((packed)) {
+        uint16_t sync;
+        LogHeader_t header;
+#if defined(LOGBUF_FRAMING)
+        uint16_t sequence;
+#endif
+    } start = {
+        syncBegin,
+        {
+            .file_id = u32FileId_,
+            .timestamp = u32Timestamp_,
+            .line = u16Line_,
+            .log_count = (uint8_t)(u8Count_ | recordFlags),
+        },
+#if defined(LOGBUF_FRAMING)
+        u16Sequence_,
+#endif
+    };
+    (void)u16Sequence_;
+    return Put(idx_, start);
+}
+
+//---------------------------------------------------------------------------
+int LogBuf::WriteArg(int idx_, uint8_t u8Tlv_, const LogStrcopy_t& value_)
+{
+    struct __attribute__((packed)) {
+        uint8_t tlv;
+        uint8_t length;
+    } prefix = { u8Tlv_, value_.length };
+    idx_ = Put(idx_, prefix);
+    return Write(idx_, value_.str, value_.length);
+}
+
+//---------------------------------------------------------------------------
+int LogBuf::WriteArg(int idx_, uint8_t u8Tlv_, const LogBlob_t& value_)
+{
+    struct __attribute__((packed)) {
+        uint8_t tlv;
+        uint16_t length;
+    } prefix = { u8Tlv_, value_.length };
+    idx_ = Put(idx_, prefix);
+    return Write(idx_, value_.data, value_.length);
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::LogSite(const LogSite_t* pstSite_, ...)
+{
+    va_list args;
+    va_start(args, pstSite_);
+    LogSiteArgs(pstSite_, 0, args);
+    va_end(args);
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::LogSite(LogLimit_t* pstLimit_, const LogSite_t* pstSite_, ...)
+{
+    va_list args;
+    va_start(args, pstSite_);
+    LogSiteArgs(pstSite_, TakeSuppressed(pstLimit_), args);
+    va_end(args);
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::LogSiteArgs(const LogSite_t* pstSite_, uint32_t u32Suppressed_, va_list args_)
+{
+    // Copied strings and blobs add to the length of the record, so a first pass
+    // over a copy of the arguments reads their lengths, stepping over the rest.
+    // Arguments narrower than int (and floats) are promoted when passed
+    // through "...".
+    int length = pstSite_->length + SuppressedLength(u32Suppressed_);
+    va_list lengths;
+    va_copy(lengths, args_);
+    for (auto i = 0; i < pstSite_->log_count; i++) {
+        switch ((LogTag)(pstSite_->tlv[i] & ((1 << tag_bits) - 1))) {
+            case LogTag::LogTagStrcopy: length += va_arg(lengths, LogStrcopy_t).length; break;
+            case LogTag::LogTagBlob: length += va_arg(lengths, LogBlob_t).length; break;
+            case LogTag::LogTagUint64: (void)va_arg(lengths, uint64_t); break;
+            case LogTag::LogTagInt64: (void)va_arg(lengths, int64_t); break;
+            case LogTag::LogTagFloat:
+            case LogTag::LogTagDouble: (void)va_arg(lengths, double); break;
+            case LogTag::LogTagVoidptr:
+            case LogTag::LogTagString: (void)va_arg(lengths, const void*); break;
+            default: (void)va_arg(lengths, int); break;
+        }
+    }
+    va_end(lengths);
+
+    auto& clBuf = Current();
+    auto start = clBuf.BeginLog(length, pstSite_->file_id, pstSite_->line,
+                                pstSite_->log_count + SuppressedFlag(u32Suppressed_), GetTimestamp());
+    if (start < 0) {
+        return;
+    }
+
+    // Each argument is then serialized straight into the record, as at an
+    // inline site.
+    auto idx = start;
+    for (auto i = 0; i < pstSite_->log_count; i++) {
+        auto tlv = pstSite_->tlv[i];
+        switch ((LogTag)(tlv & ((1 << tag_bits) - 1))) {
+            case LogTag::LogTagUint8: idx = clBuf.WriteArg(idx, tlv, (uint8_t)va_arg(args_, int)); break;
+            case LogTag::LogTagUint16: idx = clBuf.WriteArg(idx, tlv, (uint16_t)va_arg(args_, unsigned int)); break;
+            case LogTag::LogTagUint32: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, uint32_t)); break;
+            case LogTag::LogTagUint64: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, uint64_t)); break;
+            case LogTag::LogTagInt8: idx = clBuf.WriteArg(idx, tlv, (int8_t)va_arg(args_, int)); break;
+            case LogTag::LogTagInt16: idx = clBuf.WriteArg(idx, tlv, (int16_t)va_arg(args_, int)); break;
+            case LogTag::LogTagInt32: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, int32_t)); break;
+            case LogTag::LogTagInt64: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, int64_t)); break;
+            case LogTag::LogTagVoidptr: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, void*)); break;
+            case LogTag::LogTagFloat: idx = clBuf.WriteArg(idx, tlv, (float)va_arg(args_, double)); break;
+            case LogTag::LogTagDouble: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, double)); break;
+            case LogTag::LogTagChar: idx = clBuf.WriteArg(idx, tlv, (char)va_arg(args_, int)); break;
+            case LogTag::LogTagString: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, const char*)); break;
+            case LogTag::LogTagStrcopy: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, LogStrcopy_t)); break;
+            case LogTag::LogTagBlob: idx = clBuf.WriteArg(idx, tlv, va_arg(args_, LogBlob_t)); break;
+        }
+    }
+    idx = clBuf.WriteSuppressed(idx, u32Suppressed_);
+    clBuf.EndLog(start, idx);
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::LimitRateWindow(LogLimit_t* pstLimit_, uint32_t u32Ms_)
+{
+    auto u32Now = GetTimestamp();
+    if (pstLimit_->count && ((u32Now - pstLimit_->window) < pstLimit_->period)) {
+        pstLimit_->suppressed++;
+        return false;
+    }
+    // The period is computed as each interval starts, following any change
+    // to the timestamp source.
+    pstLimit_->window = u32Now;
+    pstLimit_->period = (uint32_t)(((uint64_t)u32Ms_ * m_u32TimestampHz) / 1000);
+    pstLimit_->count = 1;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::LogScope(LogSystemRecord eType_, uint32_t u32Scope_)
+{
+    auto& clBuf = Current();
+    auto length = sizeof(LogHeader_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    auto start = clBuf.BeginLog(length, system_file_id, (uint16_t)eType_, 1, GetTimestamp());
+    if (start < 0) {
+        return;
+    }
+    auto idx = clBuf.WriteArg(start, tlv_byte(LogTag::LogTagUint32, SizeTag::LogTagUint32), u32Scope_);
+    clBuf.EndLog(start, idx);
+}
+
+#if defined(LOGBUF_SITE_FILTER)
+//---------------------------------------------------------------------------
+bool LogBuf::EnableSite(uint16_t u16Index_, bool bEnable_)
+{
+    if (u16Index_ >= LOGBUF_MAX_SITES) {
+        return false;
+    }
+    auto u32Bit = 1u << (u16Index_ % 32);
+    auto* pu32Word = &m_au32SiteDisabled[u16Index_ / 32];
+    auto u32Old = bEnable_ ? __atomic_fetch_and(pu32Word, ~u32Bit, __ATOMIC_RELAXED)
+                           : __atomic_fetch_or(pu32Word, u32Bit, __ATOMIC_RELAXED);
+    return ((u32Old & u32Bit) != 0) == bEnable_;
+}
+
+//---------------------------------------------------------------------------
+uint16_t LogBuf::EnableAllSites(bool bEnable_)
+{
+    uint16_t u16Changed = 0;
+    auto u16Count = GetSiteCount();
+    for (uint16_t i = 0; (i < u16Count) && (i < LOGBUF_MAX_SITES); i++) {
+        u16Changed += EnableSite(i, bEnable_) ? 1 : 0;
     }
-    EndWrite(idx_);
+    return u16Changed;
 }
 
 //---------------------------------------------------------------------------
-int LogBuf::BeginWrite(int length_)
+void LogBuf::LogSiteFilter(LogCommand eCommand_, uint16_t u16Sites_)
+{
+    auto& clBuf = Current();
+    auto length = sizeof(LogHeader_t) + (2 * sizeof(uint8_t)) + sizeof(uint8_t) + sizeof(uint16_t);
+    auto start = clBuf.BeginLog(length, system_file_id, (uint16_t)LogSystemRecord::SiteFilter, 2, GetTimestamp());
+    if (start < 0) {
+        return;
+    }
+    auto idx = clBuf.WriteArg(start, tlv_byte(LogTag::LogTagUint8, SizeTag::LogTagUint8), (uint8_t)eCommand_);
+    idx = clBuf.WriteArg(idx, tlv_byte(LogTag::LogTagUint16, SizeTag::LogTagUint16), u16Sites_);
+    clBuf.EndLog(start, idx);
+}
+#endif
+
+//---------------------------------------------------------------------------
+void LogBuf::WriteClockSync(uint64_t u64EpochUs_)
+{
+    auto length = sizeof(LogHeader_t) + sizeof(uint8_t) + sizeof(uint64_t);
+    auto start = BeginLog(length, system_file_id, (uint16_t)LogSystemRecord::ClockSync, 1, GetTimestamp());
+    if (start < 0) {
+        return;
+    }
+    auto idx = WriteArg(start, tlv_byte(LogTag::LogTagUint64, SizeTag::LogTagUint64), u64EpochUs_);
+    EndLog(start, idx);
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::WriteClockRate()
+{
+    auto timestamp = GetTimestamp64();
+    auto length = sizeof(LogHeader_t) + (sizeof(uint8_t) * 2) + sizeof(uint32_t) + sizeof(uint64_t);
+    auto start = BeginLog(length, system_file_id, (uint16_t)LogSystemRecord::ClockRate, 2, (uint32_t)timestamp);
+    if (start < 0) {
+        return;
+    }
+    auto idx = WriteArg(start, tlv_byte(LogTag::LogTagUint32, SizeTag::LogTagUint32), m_u32TimestampHz);
+    idx = WriteArg(idx, tlv_byte(LogTag::LogTagUint64, SizeTag::LogTagUint64), timestamp);
+    EndLog(start, idx);
+}
+
+//---------------------------------------------------------------------------
+int LogBuf::BeginWrite(int length_, uint32_t timestamp_, uint16_t* pu16Sequence_)
 {
     int writeIdx;
-    CriticalSection::Enter();
+    if (!m_bSingleProducer) {
+        CriticalSection::Enter();
+    }
+#if defined(LOGBUF_STATS)
+    auto u32LockStart = m_bSingleProducer ? 0 : StatsClock();
+#endif
+    if (m_bFrozen) {
+        // The ring holds a snapshot waiting to be flushed
+        if (!m_bSingleProducer) {
+            CriticalSection::Exit();
+        }
+        return -1;
+    }
+    ExtendTimestamp(timestamp_);
     writeIdx = m_iWriteIdx;
-    m_iWriteIdx += length_ + (2 * sizeof(uint16_t));
+    length_ += (2 * sizeof(uint16_t));
+
+    // A run of duplicates (see SetCoalescing()) is ended by a repeat record
+    // ahead of the next record.  The reservation is noted, so that it can be
+    // released if this record turns out to be a duplicate as well.
+    auto u32Repeats = __atomic_exchange_n(&m_u32Repeats, 0, __ATOMIC_ACQUIRE);
+    auto u32RepeatTimestamp = m_u32RepeatTimestamp;
+    auto u16RepeatSequence = m_u16Sequence;
+    m_iReserveStart = writeIdx;
+    m_u32ReserveRepeats = u32Repeats;
+    m_u32ReserveTimestamp = timestamp_;
+    m_u16ReserveSequence = m_u16Sequence;
+    if (u32Repeats) {
+        m_u16Sequence++;
+        length_ += repeatLength;
+    }
+    *pu16Sequence_ = m_u16Sequence++;
+
+    m_iWriteIdx += length_;
     if (m_iWriteIdx > m_uBufferSize) {
         m_iWriteIdx -= m_uBufferSize;
-        m_bDoNotify = true;
-    } else if ((writeIdx < (m_uBufferSize / 2)) && (m_iWriteIdx >= (m_uBufferSize / 2))) {
-        m_bDoNotify = true;
     }
-    m_iCount++;
-    CriticalSection::Exit();
+    m_iReserveRecord = writeIdx + (u32Repeats ? repeatLength : 0);
+    if (m_iReserveRecord >= m_uBufferSize) {
+        m_iReserveRecord -= m_uBufferSize;
+    }
+    auto backlog = m_iWriteIdx - __atomic_load_n(&m_iLastReadIdx, __ATOMIC_ACQUIRE);
+    if (backlog < 0) {
+        backlog += m_uBufferSize;
+    }
+    if (m_bSnapshot) {
+        UpdateSnapshot(backlog, length_);
+    } else {
+        UpdateNotify(backlog, length_, timestamp_);
+#if defined(LOGBUF_STATS)
+        // A backlog shorter than the record means the write index has passed
+        // the start of the unflushed data.
+        if (backlog < length_) {
+            m_stStats.overruns++;
+            m_stStats.high_water = m_uBufferSize;
+        } else if (backlog > m_stStats.high_water) {
+            m_stStats.high_water = backlog;
+        }
+#endif
+    }
+    if (!m_bSingleProducer) {
+        m_iCount++;
+#if defined(LOGBUF_STATS)
+        LockStats(u32LockStart);
+#endif
+        CriticalSection::Exit();
+    }
+    if (u32Repeats) {
+        writeIdx = WriteRepeat(writeIdx, u32Repeats, u32RepeatTimestamp, u16RepeatSequence);
+    }
+    return writeIdx;
+}
 
-    uint16_t sync = syncBegin;
-    return Write(writeIdx, &sync, sizeof(sync));
+//---------------------------------------------------------------------------
+int LogBuf::WriteRepeat(int idx_, uint32_t u32Repeats_, uint32_t u32Timestamp_, uint16_t u16Sequence_)
+{
+    auto start = PutHeader(idx_, system_file_id, (uint16_t)LogSystemRecord::Repeat, 1, u32Timestamp_, u16Sequence_);
+    auto idx = WriteArg(start, tlv_byte(LogTag::LogTagUint32, SizeTag::LogTagUint32), u32Repeats_);
+#if defined(LOGBUF_FRAMING)
+    idx = WriteCrc(start, idx);
+#endif
+    uint16_t sync = syncEnd;
+    return Put(idx, sync);
 }
 
 //---------------------------------------------------------------------------
-int LogBuf::Write(int idx_, const void* data, uint8_t length)
+int LogBuf::Write(int idx_, const void* data_, int length_)
 {
-    auto src = (uint8_t*)data;
-    auto dst = &m_buf[idx_];
-    for (auto i = 0; i < length; i++, idx_++) {
-        if (idx_ == m_uBufferSize) {
-            idx_ = 0;
-            dst = m_buf;
-        }
-        *dst++ = *src++;
+    // Copy the payload with at most one split, where it crosses the end of the
+    // ring and continues at the start.
+    auto src = (const uint8_t*)data_;
+    auto contiguous = m_uBufferSize - idx_;
+    if (length_ <= contiguous) {
+        memcpy(&m_buf[idx_], src, length_);
+        return idx_ + length_;
     }
-    return idx_;
+    memcpy(&m_buf[idx_], src, contiguous);
+    memcpy(m_buf, &src[contiguous], length_ - contiguous);
+    return length_ - contiguous;
+}
+
+//---------------------------------------------------------------------------
+int LogBuf::WriteCrc(int start_, int idx_)
+{
+    // The CRC covers the header, sequence number and arguments, which may have
+    // wrapped around the end of the ring.
+    auto begin = start_ - (int)(sizeof(LogHeader_t) + sizeof(uint16_t));
+    if (begin < 0) {
+        begin += m_uBufferSize;
+    }
+    uint16_t u16Crc;
+    if (idx_ < begin) {
+        u16Crc = crc16_update(crc16_init, &m_buf[begin], m_uBufferSize - begin);
+        u16Crc = crc16_update(u16Crc, m_buf, idx_);
+    } else {
+        u16Crc = crc16_update(crc16_init, &m_buf[begin], idx_ - begin);
+    }
+    return Put(idx_, u16Crc);
 }
 
 //---------------------------------------------------------------------------
@@ -97,50 +768,678 @@ void LogBuf::EndWrite(int idx_)
     bool doNotify = false;
 
     uint16_t sync = syncEnd;
-    idx_ = Write(idx_, &sync, sizeof(sync));
+    auto end = Put(idx_, sync);
+
+    if (m_bSingleProducer) {
+#if defined(LOGBUF_STATS)
+        m_u32StatsPending++;
+#endif
+        if (m_bCoalesce && Coalesce(true)) {
+            return;
+        }
+        // Publish the completed record to the flushing context; the write index
+        // and notification flag are only ever touched by the producer.
+#if defined(LOGBUF_STATS)
+        auto iPublished = m_iWriteIdx - m_iReadIdx;
+        __atomic_store_n(&m_iReadIdx, m_iWriteIdx, __ATOMIC_RELEASE);
+        PublishStats(iPublished);
+#else
+        __atomic_store_n(&m_iReadIdx, m_iWriteIdx, __ATOMIC_RELEASE);
+#endif
+#if defined(LOGBUF_NOINIT)
+        CriticalSection::Enter();
+        UpdateFlightHeader();
+        CriticalSection::Exit();
+#endif
+        doNotify = m_bDoNotify || m_bNotifyDeferred;
+        m_bDoNotify = false;
+        if (doNotify) {
+            NotifyFlush();
+        }
+        return;
+    }
 
     CriticalSection::Enter();
+#if defined(LOGBUF_STATS)
+    auto u32LockStart = StatsClock();
+#endif
     if (m_iCount > 0) {
+#if defined(LOGBUF_STATS)
+        m_u32StatsPending++;
+#endif
+        // A record can only be released if it's the last reserved, and no
+        // others are still being written ahead of it.
+        if (m_bCoalesce) {
+            Coalesce((m_iCount == 1) && (m_iWriteIdx == end));
+        }
         m_iCount--;
         if (!m_iCount) {
+#if defined(LOGBUF_STATS)
+            PublishStats(m_iWriteIdx - m_iReadIdx);
+#endif
             m_iReadIdx = m_iWriteIdx;
             m_bPending = true;
-            if (m_bDoNotify) {
-                doNotify = true;
+#if defined(LOGBUF_NOINIT)
+            UpdateFlightHeader();
+#endif
+            doNotify = m_bDoNotify || m_bNotifyDeferred;
+            m_bDoNotify = false;
+        }
+    }
+#if defined(LOGBUF_STATS)
+    LockStats(u32LockStart);
+#endif
+    CriticalSection::Exit();
+
+    if (doNotify) {
+        NotifyFlush();
+    }
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::Coalesce(bool bLatest_)
+{
+    auto length = m_iWriteIdx - m_iReserveRecord;
+    if (length <= 0) {
+        length += m_uBufferSize;
+    }
+    // Records from the logger itself (i.e. clock-sync records) end a run, as
+    // do records that can't be released, and all records in snapshot mode.
+    uint8_t au8FileId[sizeof(uint32_t)];
+    for (auto i = 0; i < (int)sizeof(au8FileId); i++) {
+        au8FileId[i] = m_buf[(m_iReserveRecord + sizeof(uint16_t) + i) % m_uBufferSize];
+    }
+    uint32_t u32FileId;
+    memcpy(&u32FileId, au8FileId, sizeof(u32FileId));
+    if (!bLatest_ || m_bSnapshot || (u32FileId == system_file_id)) {
+        m_iLastRecord = -1;
+        return false;
+    }
+    if ((m_iLastRecord < 0) || (length != m_iLastLength) || !SameRecord(m_iLastRecord, m_iReserveRecord, length)) {
+        m_iLastRecord = m_iReserveRecord;
+        m_iLastLength = length;
+        return false;
+    }
+
+    // Release the duplicate's reservation (and the repeat record ahead of it,
+    // if any), counting it against the run instead.
+    m_iWriteIdx = m_iReserveStart;
+    m_u16Sequence = m_u16ReserveSequence;
+    m_u32RepeatTimestamp = m_u32ReserveTimestamp;
+    __atomic_store_n(&m_u32Repeats, m_u32ReserveRepeats + 1, __ATOMIC_RELEASE);
+#if defined(LOGBUF_STATS)
+    m_u32StatsPending--;
+#endif
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::SameRecord(int iFirst_, int iSecond_, int iLength_) const
+{
+    auto same = [&](int iFrom_, int iTo_) {
+        for (auto i = iFrom_; i < iTo_; i++) {
+            if (m_buf[(iFirst_ + i) % m_uBufferSize] != m_buf[(iSecond_ + i) % m_uBufferSize]) {
+                return false;
             }
         }
+        return true;
+    };
+
+    // Compare everything but the timestamp, and the framing fields (sequence
+    // number and CRC) that depend on it.
+    constexpr int timestampStart = sizeof(uint16_t) + offsetof(LogHeader_t, timestamp);
+    constexpr int timestampEnd = timestampStart + sizeof(uint32_t);
+    constexpr int headerEnd = sizeof(uint16_t) + sizeof(LogHeader_t);
+    constexpr int argsStart = headerEnd + (framingLength / 2);
+    auto argsEnd = iLength_ - (int)sizeof(uint16_t) - (framingLength / 2);
+    return same(0, timestampStart) && same(timestampEnd, headerEnd) && same(argsStart, argsEnd);
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::UpdateNotify(int backlog_, int length_, uint32_t timestamp_)
+{
+    // Re-arm once the flushing context has drained the buffer far enough
+    if ((backlog_ - length_) <= m_u16LowWatermark) {
+        if (!m_bNotifyArmed) {
+            m_u16Records = 0;
+        }
+        m_bNotifyArmed = true;
+        m_bOverrunArmed = true;
+    }
+
+    // The buffer is in danger of being overrun - signal once more, even if the
+    // flushing context has already been notified, or was notified recently.
+    if (m_bOverrunArmed && (backlog_ >= (m_uBufferSize - (m_uBufferSize / 4)))) {
+        m_bOverrunArmed = false;
+        m_bNotifyArmed = false;
+        m_u32LastNotify = timestamp_;
+        m_bDoNotify = true;
+        return;
+    }
+
+    if (!m_bNotifyArmed) {
+        return;
+    }
+    m_u16Records++;
+    if (!(m_u16HighWatermark && (backlog_ >= m_u16HighWatermark))
+        && !(m_u16RecordTrigger && (m_u16Records >= m_u16RecordTrigger))) {
+        return;
+    }
+    if (m_u32NotifyInterval && ((timestamp_ - m_u32LastNotify) < m_u32NotifyInterval)) {
+        return;
+    }
+    m_bNotifyArmed = false;
+    m_u16Records = 0;
+    m_u32LastNotify = timestamp_;
+    m_bDoNotify = true;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::UpdateSnapshot(int backlog_, int length_)
+{
+    // Once the ring wraps, the oldest data (the tail of a partly-overwritten
+    // record, which host tools resynchronize past) begins at the write index.
+    if (m_bSnapshotWrapped || (backlog_ < length_)) {
+        m_bSnapshotWrapped = true;
+        __atomic_store_n(&m_iLastReadIdx, m_iWriteIdx, __ATOMIC_RELEASE);
+    }
+    if (!m_bTriggered) {
+        return;
+    }
+    m_iTriggerFill += length_;
+    if (m_u16PostRemaining && !--m_u16PostRemaining) {
+        m_bFrozen = true;
+        m_bDoNotify = true;
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::NotifyFlush()
+{
+    // Signalling from interrupt context is left to the next writer in thread
+    // context, or to ServiceNotify()
+    if (m_pfInIsr && m_pfInIsr()) {
+        m_bNotifyDeferred = true;
+        return;
+    }
+    m_bNotifyDeferred = false;
+
+    auto pfHandler = m_pfNotificationHandler ? m_pfNotificationHandler : Instance().m_pfNotificationHandler;
+    if (pfHandler) {
+        pfHandler();
+    }
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::WriteSystemRecord(LogWrite_t pfLogWriter_, LogSystemRecord eType_, const uint8_t* pu8Args_, uint8_t u8Count_,
+                               uint32_t u32Timestamp_)
+{
+    uint8_t au8Args[site_max_args * 2];
+    auto idx = 0;
+    for (auto i = 0; i < u8Count_; i++) {
+        au8Args[idx++] = tlv_byte(LogTag::LogTagUint8, SizeTag::LogTagUint8);
+        au8Args[idx++] = pu8Args_[i];
+    }
+    return WriteSystemRecord(pfLogWriter_, eType_, au8Args, idx, u8Count_, u32Timestamp_);
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::WriteSystemRecord(LogWrite_t pfLogWriter_, LogSystemRecord eType_, uint32_t u32Arg_, uint32_t u32Timestamp_)
+{
+    struct __attribute__((packed)) {
+        uint8_t tlv;
+        uint32_t value;
+    } arg = { tlv_byte(LogTag::LogTagUint32, SizeTag::LogTagUint32), u32Arg_ };
+    return WriteSystemRecord(pfLogWriter_, eType_, (const uint8_t*)&arg, sizeof(arg), 1, u32Timestamp_);
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::WriteSystemRecord(LogWrite_t pfLogWriter_, LogSystemRecord eType_, const uint8_t* pu8Tlv_, int iLength_,
+                               uint8_t u8Count_, uint32_t u32Timestamp_)
+{
+    // Written straight to the debug interface (rather than to the ring), as
+    // part of the data being flushed from this shard.
+    struct __attribute__((packed)) {
+        uint16_t sync;
+        LogHeader_t header;
+        uint8_t args[metric_summary_max + (2 * sizeof(uint16_t))];
+    } record = {
+        syncBegin,
+        {
+            .file_id = system_file_id,
+            .timestamp = u32Timestamp_,
+            .line = (uint16_t)eType_,
+            .log_count = (uint8_t)(u8Count_ | (recordFlags & log_flag_crc)),
+        },
+        {},
+    };
+    memcpy(record.args, pu8Tlv_, iLength_);
+    auto idx = iLength_;
+#if defined(LOGBUF_FRAMING)
+    // Records written directly aren't part of the ring's sequence, so carry a
+    // CRC only.
+    auto u16Crc = crc16_update(crc16_init, &record.header, sizeof(LogHeader_t) + idx);
+    memcpy(&record.args[idx], &u16Crc, sizeof(u16Crc));
+    idx += sizeof(u16Crc);
+#endif
+    uint16_t sync = syncEnd;
+    memcpy(&record.args[idx], &sync, sizeof(sync));
+    idx += sizeof(sync);
+    return Output(pfLogWriter_, (const uint8_t*)&record, sizeof(uint16_t) + sizeof(LogHeader_t) + idx);
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::WriteMetrics(LogWrite_t pfLogWriter_)
+{
+    auto u32Now = GetTimestamp();
+    auto u32Period = (uint32_t)(((uint64_t)m_u32MetricInterval * m_u32TimestampHz) / 1000);
+    if (!LogMetric::First() || ((u32Now - m_u32MetricTimestamp) < u32Period)) {
+        return true;
+    }
+    m_u32MetricTimestamp = u32Now;
+    for (auto* pclMetric = LogMetric::First(); pclMetric; pclMetric = pclMetric->Next()) {
+        uint8_t au8Tlv[metric_summary_max];
+        uint8_t u8Count;
+        auto iLength = pclMetric->Summarize(au8Tlv, &u8Count);
+        if (!WriteSystemRecord(pfLogWriter_, LogSystemRecord::Metric, au8Tlv, iLength, u8Count, u32Now)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(LOGBUF_STATS)
+//---------------------------------------------------------------------------
+bool LogBuf::WriteStats(LogWrite_t pfLogWriter_)
+{
+    auto u32Now = GetTimestamp();
+    auto u32Period = (uint32_t)(((uint64_t)m_u32StatsInterval * m_u32TimestampHz) / 1000);
+    if (!m_u32StatsInterval || ((u32Now - m_u32StatsTimestamp) < u32Period)) {
+        return true;
+    }
+    m_u32StatsTimestamp = u32Now;
+
+    LogStats_t stStats;
+    GetStats(&stStats);
+    uint32_t au32Values[] = {
+        stStats.records,
+        stStats.bytes,
+        stStats.records_flushed,
+        stStats.bytes_flushed,
+        stStats.overruns,
+        stStats.high_water,
+        stStats.lock_max,
+        stStats.lock_count ? (stStats.lock_total / stStats.lock_count) : 0,
+        stStats.flush_max,
+        stStats.flush_count ? (stStats.flush_total / stStats.flush_count) : 0,
+        m_pfStatsClock ? m_u32StatsClockHz : m_u32TimestampHz,
+    };
+    uint8_t au8Tlv[sizeof(au32Values) / sizeof(uint32_t) * (sizeof(uint8_t) + sizeof(uint32_t))];
+    auto idx = 0;
+    for (auto u32Value : au32Values) {
+        au8Tlv[idx++] = tlv_byte(LogTag::LogTagUint32, SizeTag::LogTagUint32);
+        memcpy(&au8Tlv[idx], &u32Value, sizeof(u32Value));
+        idx += sizeof(u32Value);
+    }
+    return WriteSystemRecord(pfLogWriter_, LogSystemRecord::Stats, au8Tlv, idx, sizeof(au32Values) / sizeof(uint32_t), u32Now);
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::PublishStats(int iBytes_)
+{
+    if (iBytes_ < 0) {
+        iBytes_ += m_uBufferSize;
+    }
+    m_stStats.bytes += iBytes_;
+    __atomic_store_n(&m_stStats.records, m_stStats.records + m_u32StatsPending, __ATOMIC_RELEASE);
+    m_u32StatsPending = 0;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::LockStats(uint32_t u32Start_)
+{
+    auto u32Elapsed = StatsClock() - u32Start_;
+    if (u32Elapsed > m_stStats.lock_max) {
+        m_stStats.lock_max = u32Elapsed;
+    }
+    m_stStats.lock_total += u32Elapsed;
+    m_stStats.lock_count++;
+}
+#endif
+
+//---------------------------------------------------------------------------
+int LogBuf::WriteSpan(LogWrite_t pfLogWriter_, int iStart_, int iLength_)
+{
+    if (iStart_ >= m_uBufferSize) {
+        iStart_ -= m_uBufferSize;
+    }
+    if (iLength_ <= 0) {
+        return 0;
+    }
+    auto contiguous = m_uBufferSize - iStart_;
+    auto pfVectorWriter = WriterOwner().m_pfVectorWriter;
+    if (pfVectorWriter) {
+        // Both segments of a wrapped span go to the writer in a single call
+        LogIoVec_t astVec[2] = {
+            { &m_buf[iStart_], (size_t)((iLength_ > contiguous) ? contiguous : iLength_) },
+            { m_buf, (size_t)((iLength_ > contiguous) ? (iLength_ - contiguous) : 0) },
+        };
+        auto uWritten = pfVectorWriter(astVec, (iLength_ > contiguous) ? 2 : 1);
+        if (uWritten < (size_t)iLength_) {
+            iLength_ = (int)uWritten;
+        }
+    } else if (iLength_ > contiguous) {
+        Output(pfLogWriter_, &m_buf[iStart_], contiguous);
+        Output(pfLogWriter_, m_buf, iLength_ - contiguous);
+    } else {
+        Output(pfLogWriter_, &m_buf[iStart_], iLength_);
+    }
+#if defined(LOGBUF_STATS)
+    m_stStats.bytes_flushed += iLength_;
+#endif
+    return iLength_;
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::WritePending(LogWrite_t pfLogWriter_, int* piStart_, int iEnd_)
+{
+    auto iLength = iEnd_ - *piStart_;
+    if (iLength < 0) {
+        iLength += m_uBufferSize;
+    }
+    auto iWritten = WriteSpan(pfLogWriter_, *piStart_, iLength);
+    *piStart_ += iWritten;
+    if (*piStart_ > m_uBufferSize) {
+        *piStart_ -= m_uBufferSize;
+    }
+    return (iWritten == iLength);
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::Output(LogWrite_t pfLogWriter_, const uint8_t* pu8Data_, size_t uLength_)
+{
+    // The writer and compressor belong to this shard, or the primary
+    auto& clOwner = WriterOwner();
+    if (clOwner.m_pfVectorWriter) {
+        LogIoVec_t stVec = { pu8Data_, uLength_ };
+        auto uWritten = clOwner.m_pfVectorWriter(&stVec, 1);
+        if (uWritten < uLength_) {
+            clOwner.m_uUnsent = uLength_ - uWritten;
+            memcpy(clOwner.m_au8Unsent, &pu8Data_[uWritten], clOwner.m_uUnsent);
+            return false;
+        }
+    } else if (clOwner.m_pclCompressor) {
+        clOwner.m_pclCompressor->Write(pfLogWriter_, pu8Data_, uLength_);
+    } else {
+        pfLogWriter_(pu8Data_, uLength_);
+    }
+    return true;
+}
+
+//---------------------------------------------------------------------------
+bool LogBuf::WriteUnsent()
+{
+    if (!m_uUnsent) {
+        return true;
+    }
+    if (!m_pfVectorWriter) {
+        // The writer has since been replaced by a blocking one
+        if (m_pfLogWriter) {
+            Output(m_pfLogWriter, m_au8Unsent, m_uUnsent);
+        }
+        m_uUnsent = 0;
+        return true;
+    }
+    LogIoVec_t stVec = { m_au8Unsent, m_uUnsent };
+    auto uWritten = m_pfVectorWriter(&stVec, 1);
+    if (uWritten < m_uUnsent) {
+        m_uUnsent -= uWritten;
+        memmove(m_au8Unsent, &m_au8Unsent[uWritten], m_uUnsent);
+        return false;
+    }
+    m_uUnsent = 0;
+    return true;
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::EndOutput(LogWrite_t pfLogWriter_)
+{
+    auto* pclCompressor = WriterOwner().m_pclCompressor;
+    if (pclCompressor) {
+        pclCompressor->Flush(pfLogWriter_);
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::FlushSnapshot()
+{
+    // The window is written once the writer has taken any record it held back
+    if (!WriterOwner().WriteUnsent()) {
+        return;
+    }
+    CriticalSection::Enter();
+    if (!m_bFrozen || m_iCount) {
+        // Still recording, or records in the snapshot are still being written
+        CriticalSection::Exit();
+        return;
+    }
+    auto iEnd = __atomic_load_n(&m_iReadIdx, __ATOMIC_ACQUIRE);
+    auto iLength = m_uBufferSize;
+    if (!m_bSnapshotWrapped) {
+        iLength = iEnd - m_iLastReadIdx;
+        if (iLength < 0) {
+            iLength += m_uBufferSize;
+        }
     }
+    auto iPost = iEnd - m_iTriggerIdx;
+    if (iPost < 0) {
+        iPost += m_uBufferSize;
+    }
+    if ((m_iTriggerFill >= iLength) || (iPost > iLength)) {
+        // The records preceding the trigger have all been overwritten
+        iPost = iLength;
+    }
+    auto u32Timestamp = m_u32TriggerTimestamp;
     CriticalSection::Exit();
 
-    if (doNotify && m_pfNotificationHandler) {        
-        m_pfNotificationHandler();
+    // The shard is frozen, so the window can be written without interference
+    auto& clOwner = WriterOwner();
+    auto pfLogWriter = clOwner.m_pfLogWriter;
+    if (pfLogWriter || clOwner.m_pfVectorWriter) {
+        auto bWritten = true;
+        if (m_pfShardSelect) {
+            uint8_t au8Shard[2] = { (uint8_t)(this - aclLogBuf), (uint8_t)LOGBUF_SHARD_COUNT };
+            bWritten = WriteSystemRecord(pfLogWriter, LogSystemRecord::Shard, au8Shard, 2, GetTimestamp());
+        }
+        auto iStart = iEnd - iLength;
+        if (iStart < 0) {
+            iStart += m_uBufferSize;
+        }
+        bWritten = bWritten && (WriteSpan(pfLogWriter, iStart, iLength - iPost) == (iLength - iPost));
+        bWritten = bWritten && WriteSystemRecord(pfLogWriter, LogSystemRecord::Trigger, nullptr, 0, u32Timestamp);
+        if (bWritten) {
+            WriteSpan(pfLogWriter, iStart + (iLength - iPost), iPost);
+        }
+        EndOutput(pfLogWriter);
     }
+
+    // Resume recording, discarding the snapshot
+    CriticalSection::Enter();
+    __atomic_store_n(&m_iLastReadIdx, iEnd, __ATOMIC_RELEASE);
+    m_bPending = false;
+    m_bSnapshotWrapped = false;
+    m_bTriggered = false;
+    m_bFrozen = false;
+#if defined(LOGBUF_NOINIT)
+    UpdateFlightHeader();
+#endif
+    CriticalSection::Exit();
 }
 
 //---------------------------------------------------------------------------
 void LogBuf::FlushData()
 {
+#if defined(LOGBUF_STATS)
+    auto u32Start = StatsClock();
+#endif
+    if (m_bSnapshot) {
+        FlushSnapshot();
+    } else {
+        FlushRing();
+    }
+#if defined(LOGBUF_STATS)
+    auto u32Elapsed = StatsClock() - u32Start;
+    if (u32Elapsed > m_stStats.flush_max) {
+        m_stStats.flush_max = u32Elapsed;
+    }
+    m_stStats.flush_total += u32Elapsed;
+    m_stStats.flush_count++;
+#endif
+}
+
+//---------------------------------------------------------------------------
+void LogBuf::FlushRing()
+{
+    // Nothing is written (or taken from the ring) until the writer has taken
+    // any record it held back, which other data mustn't overtake.
+    if (!WriterOwner().WriteUnsent()) {
+        return;
+    }
+
     int iReadIdx;
     int iLastReadIdx;
     bool bPending;
+    uint32_t u32Repeats;
+#if defined(LOGBUF_STATS)
+    uint32_t u32Records;
+#endif
 
-    CriticalSection::Enter();
-    bPending = m_bPending;
-    m_bDoNotify = false;
-    m_bPending = false;
-    iReadIdx = m_iReadIdx;
-    iLastReadIdx = m_iLastReadIdx;
-    m_iLastReadIdx = m_iReadIdx;
-    CriticalSection::Exit();
+    if (m_bSingleProducer) {
+        // The read indexes are only written by the flushing context; the last
+        // read index is read by the producer to track the unflushed backlog.
+        // A run of duplicates is only counted once the record it repeats has
+        // been published, so is taken first (unless a run is still held back
+        // by a partial flush, in which case it's left to the producer).
+        u32Repeats = m_u32HeldRepeats ? 0 : __atomic_exchange_n(&m_u32Repeats, 0, __ATOMIC_ACQUIRE);
+#if defined(LOGBUF_STATS)
+        // Records are counted after they're published, so none counted here
+        // are missing from the data about to be read.
+        u32Records = __atomic_load_n(&m_stStats.records, __ATOMIC_ACQUIRE);
+#endif
+        iReadIdx = __atomic_load_n(&m_iReadIdx, __ATOMIC_ACQUIRE);
+        iLastReadIdx = m_iLastReadIdx;
+        __atomic_store_n(&m_iLastReadIdx, iReadIdx, __ATOMIC_RELEASE);
+        bPending = (iReadIdx != iLastReadIdx);
+#if defined(LOGBUF_NOINIT)
+        CriticalSection::Enter();
+        UpdateFlightHeader();
+        CriticalSection::Exit();
+#endif
+    } else {
+        CriticalSection::Enter();
+        u32Repeats = m_u32HeldRepeats ? 0 : m_u32Repeats;
+        m_u32Repeats -= u32Repeats;
+        bPending = m_bPending;
+        m_bPending = false;
+#if defined(LOGBUF_STATS)
+        u32Records = m_stStats.records;
+#endif
+        iReadIdx = m_iReadIdx;
+        iLastReadIdx = m_iLastReadIdx;
+        m_iLastReadIdx = m_iReadIdx;
+#if defined(LOGBUF_NOINIT)
+        UpdateFlightHeader();
+#endif
+        CriticalSection::Exit();
+    }
 
-    if (!m_pfLogWriter && !bPending) {
+    auto& clOwner = WriterOwner();
+    auto pfLogWriter = clOwner.m_pfLogWriter;
+    if (!pfLogWriter && !clOwner.m_pfVectorWriter) {
         return;
     }
 
-    if (iReadIdx < iLastReadIdx) {
-        m_pfLogWriter(&m_buf[iLastReadIdx], m_uBufferSize - iLastReadIdx);
-        m_pfLogWriter(m_buf, iReadIdx);
-    } else {
-        m_pfLogWriter(&m_buf[iLastReadIdx], iReadIdx - iLastReadIdx);
+    // Shard records are written on every flush, even with no data pending, so
+    // host tools know that nothing older is still to come from this shard.
+    // While the tail of a record the writer only partly accepted is retained,
+    // the flush doesn't start at a record boundary, and the shard record from
+    // the flush that wrote its head still applies.
+    // Once a vectored writer holds back part of a record written directly,
+    // the flush ends there, as it does for ring data.
+    auto bComplete = true;
+    if (m_pfShardSelect && !m_bRetained) {
+        uint8_t au8Shard[2] = { (uint8_t)(this - aclLogBuf), (uint8_t)LOGBUF_SHARD_COUNT };
+        bComplete = WriteSystemRecord(pfLogWriter, LogSystemRecord::Shard, au8Shard, 2, GetTimestamp());
+    }
+    if (bPending) {
+        // Records recovered from before a reset are flushed first, marked as
+        // such. The opening marker is written once, however many flushes the
+        // range takes.
+        if (bComplete && m_bPostMortem) {
+            uint8_t u8Marker = 1;
+            if (!m_bPostMortemOpen) {
+                m_bPostMortemOpen = true;
+                bComplete = WriteSystemRecord(pfLogWriter, LogSystemRecord::PostMortem, &u8Marker, 1, GetTimestamp());
+            }
+            bComplete = bComplete && WritePending(pfLogWriter, &iLastReadIdx, m_iPostMortemEnd);
+            if (bComplete) {
+                m_bPostMortem = false;
+                u8Marker = 0;
+                bComplete = WriteSystemRecord(pfLogWriter, LogSystemRecord::PostMortem, &u8Marker, 1, GetTimestamp());
+            }
+        }
+        // A run held back by a partial flush follows the record it repeats
+        if (bComplete && m_u32HeldRepeats) {
+            bComplete = WritePending(pfLogWriter, &iLastReadIdx, m_iHeldIdx);
+            if (bComplete) {
+                auto u32Held = m_u32HeldRepeats;
+                m_u32HeldRepeats = 0;
+                bComplete = WriteSystemRecord(pfLogWriter, LogSystemRecord::Repeat, u32Held, m_u32HeldTimestamp);
+            }
+        }
+        bComplete = bComplete && WritePending(pfLogWriter, &iLastReadIdx, iReadIdx);
+    }
+
+    m_bRetained = !bComplete;
+    if (!bComplete) {
+        // Data the writer didn't accept stays in the ring for the next flush,
+        // along with the run of duplicates (if any) that follows it.
+        if (u32Repeats) {
+            m_u32HeldRepeats = u32Repeats;
+            m_u32HeldTimestamp = m_u32RepeatTimestamp;
+            m_iHeldIdx = iReadIdx;
+        }
+        if (m_bSingleProducer) {
+            __atomic_store_n(&m_iLastReadIdx, iLastReadIdx, __ATOMIC_RELEASE);
+#if defined(LOGBUF_NOINIT)
+            CriticalSection::Enter();
+            UpdateFlightHeader();
+            CriticalSection::Exit();
+#endif
+        } else {
+            CriticalSection::Enter();
+            m_iLastReadIdx = iLastReadIdx;
+            m_bPending = true;
+#if defined(LOGBUF_NOINIT)
+            UpdateFlightHeader();
+#endif
+            CriticalSection::Exit();
+        }
+        EndOutput(pfLogWriter);
+        return;
+    }
+
+    // A run of duplicates still in progress is reported with each flush.
+    // Stats and metrics held up by the writer are written by a later flush.
+    if (u32Repeats) {
+        bComplete = WriteSystemRecord(pfLogWriter, LogSystemRecord::Repeat, u32Repeats, m_u32RepeatTimestamp);
+    }
+#if defined(LOGBUF_STATS)
+    m_stStats.records_flushed = u32Records;
+    bComplete = bComplete && WriteStats(pfLogWriter);
+#endif
+    if (bComplete && (this == aclLogBuf)) {
+        WriteMetrics(pfLogWriter);
     }
+    EndOutput(pfLogWriter);
 }
@@ -0,0 +1,85 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logcommand.cpp Reader for site filter commands sent by the host
+ */
+#include "logcommand.h"
+#include "crc16.h"
+
+#include <string.h>
+
+#if defined(LOGBUF_SITE_FILTER)
+//---------------------------------------------------------------------------
+void LogCommandReader::Receive(const uint8_t* pu8Data_, size_t uLength_)
+{
+    while (uLength_--) {
+        m_au8Frame[m_uLength++] = *pu8Data_++;
+
+        // Hunt for the sync word, a byte at a time
+        if ((m_uLength == sizeof(uint16_t)) && (m_au8Frame[0] | (m_au8Frame[1] << 8)) != command_sync) {
+            m_au8Frame[0] = m_au8Frame[1];
+            m_uLength = 1;
+            continue;
+        }
+        if (m_uLength < sizeof(LogCommandHeader_t)) {
+            continue;
+        }
+
+        LogCommandHeader_t stHeader;
+        memcpy(&stHeader, m_au8Frame, sizeof(stHeader));
+        if (stHeader.count > command_max_sites) {
+            m_u32Rejected++;
+            m_uLength = 0;
+            continue;
+        }
+        auto uFrame = sizeof(stHeader) + (stHeader.count * sizeof(uint16_t)) + sizeof(uint16_t);
+        if (m_uLength < uFrame) {
+            continue;
+        }
+
+        uint16_t u16Crc;
+        memcpy(&u16Crc, &m_au8Frame[uFrame - sizeof(u16Crc)], sizeof(u16Crc));
+        if (crc16_update(crc16_init, m_au8Frame, uFrame - sizeof(u16Crc)) == u16Crc) {
+            Execute();
+        } else {
+            m_u32Rejected++;
+        }
+        m_uLength = 0;
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogCommandReader::Execute()
+{
+    LogCommandHeader_t stHeader;
+    memcpy(&stHeader, m_au8Frame, sizeof(stHeader));
+    auto eCommand = (LogCommand)stHeader.command;
+
+    uint16_t u16Changed = 0;
+    switch (eCommand) {
+        case LogCommand::EnableSites:
+        case LogCommand::DisableSites:
+            for (auto i = 0; i < stHeader.count; i++) {
+                uint16_t u16Index;
+                memcpy(&u16Index, &m_au8Frame[sizeof(stHeader) + (i * sizeof(u16Index))], sizeof(u16Index));
+                u16Changed += LogBuf::EnableSite(u16Index, eCommand == LogCommand::EnableSites) ? 1 : 0;
+            }
+            break;
+        case LogCommand::EnableAll: u16Changed = LogBuf::EnableAllSites(true); break;
+        case LogCommand::DisableAll: u16Changed = LogBuf::EnableAllSites(false); break;
+        default: m_u32Rejected++; return;
+    }
+    LogBuf::LogSiteFilter(eCommand, u16Changed);
+}
+#endif
@@ -0,0 +1,178 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logcompress.cpp Fixed-memory streaming compressor for flushed log data
+ */
+#include "logcompress.h"
+
+#include <string.h>
+
+//---------------------------------------------------------------------------
+void LogCompressor::Reset()
+{
+    memset(m_au8Buf, 0, sizeof(m_au8Buf));
+    memset(m_au16Hash, 0, sizeof(m_au16Hash));
+    m_iPos = m_iWindowSize;
+    m_iEnd = m_iWindowSize;
+    m_u16Base = 0;
+    m_u32Bits = 0;
+    m_iBits = 0;
+    m_iBlockLength = 0;
+    m_u16RawLength = 0;
+    m_u8Blocks = 0;
+    m_bOpen = false;
+    m_bKeyframe = true;
+}
+
+//---------------------------------------------------------------------------
+void LogCompressor::Write(LogWrite_t pfLogWriter_, const uint8_t* pu8Data_, size_t uLength_)
+{
+    while (uLength_) {
+        if (m_iEnd == (int)sizeof(m_au8Buf)) {
+            Compress(pfLogWriter_, false);
+            Slide();
+        }
+        auto uChunk = sizeof(m_au8Buf) - m_iEnd;
+        if (uChunk > uLength_) {
+            uChunk = uLength_;
+        }
+        memcpy(&m_au8Buf[m_iEnd], pu8Data_, uChunk);
+        m_iEnd += uChunk;
+        pu8Data_ += uChunk;
+        uLength_ -= uChunk;
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogCompressor::Flush(LogWrite_t pfLogWriter_)
+{
+    Compress(pfLogWriter_, true);
+    if (m_bOpen) {
+        EndBlock(pfLogWriter_);
+    }
+    Slide();
+}
+
+//---------------------------------------------------------------------------
+void LogCompressor::Compress(LogWrite_t pfLogWriter_, bool bFinal_)
+{
+    auto iLimit = bFinal_ ? m_iEnd : (m_iEnd - m_iMaxMatch);
+    while (m_iPos < iLimit) {
+        if (!m_bOpen) {
+            BeginBlock();
+        }
+
+        auto iAvailable = m_iEnd - m_iPos;
+        if (iAvailable > m_iMaxMatch) {
+            iAvailable = m_iMaxMatch;
+        }
+        auto* pu8Data = &m_au8Buf[m_iPos];
+        auto iMatch = 0;
+        auto iDistance = 0;
+        if (iAvailable >= compressed_min_match) {
+            // Only the most recent position with the same hash is considered.
+            // Stale entries are harmless: the data at the candidate position is
+            // compared before it's used, and anything within the window (zeros,
+            // following a keyframe) matches the host's copy of it.
+            auto& u16Entry = m_au16Hash[Hash(pu8Data)];
+            auto u16Pos = (uint16_t)(m_u16Base + m_iPos);
+            iDistance = (uint16_t)(u16Pos - u16Entry);
+            u16Entry = u16Pos;
+            if (iDistance && (iDistance <= m_iWindowSize)) {
+                auto* pu8Match = pu8Data - iDistance;
+                while ((iMatch < iAvailable) && (pu8Match[iMatch] == pu8Data[iMatch])) {
+                    iMatch++;
+                }
+            }
+        }
+
+        if (iMatch >= compressed_min_match) {
+            PutBits(((uint32_t)(iDistance - 1) << m_iLengthBits) | (uint32_t)(iMatch - compressed_min_match), m_iMatchBits);
+            // Index the positions covered by the match, for later data to refer to
+            for (auto i = 1; (i < iMatch) && ((m_iPos + i + compressed_min_match) <= m_iEnd); i++) {
+                m_au16Hash[Hash(&pu8Data[i])] = (uint16_t)(m_u16Base + m_iPos + i);
+            }
+        } else {
+            iMatch = 1;
+            PutBits(0x100 | *pu8Data, 9);
+        }
+        m_iPos += iMatch;
+        m_u16RawLength += iMatch;
+
+        if (((m_iBlockLength + m_iMaxTokenBytes) > m_iBlockSize) || (m_u16RawLength > (UINT16_MAX - m_iMaxMatch))) {
+            EndBlock(pfLogWriter_);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogCompressor::BeginBlock()
+{
+    m_bOpen = true;
+    m_u8Flags = 0;
+    if (m_bKeyframe || (m_u8KeyframeInterval && (++m_u8Blocks >= m_u8KeyframeInterval))) {
+        // Everything preceding the next byte to encode is window
+        memset(m_au8Buf, 0, m_iPos);
+        m_u8Flags = compressed_flag_keyframe;
+        m_u8Blocks = 0;
+        m_bKeyframe = false;
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogCompressor::EndBlock(LogWrite_t pfLogWriter_)
+{
+    if (m_iBits) {
+        m_au8Block[sizeof(LogCompressedHeader_t) + m_iBlockLength++] = (uint8_t)(m_u32Bits << (8 - m_iBits));
+        m_iBits = 0;
+    }
+    LogCompressedHeader_t header = {
+        .sync = compressed_block_sync,
+        .sequence = m_u8Sequence++,
+        .flags = m_u8Flags,
+        .params = (uint8_t)((m_iWindowBits << 4) | m_iLengthBits),
+        .raw_length = m_u16RawLength,
+        .length = (uint16_t)m_iBlockLength,
+    };
+    memcpy(m_au8Block, &header, sizeof(header));
+    pfLogWriter_(m_au8Block, sizeof(header) + m_iBlockLength);
+
+    m_iBlockLength = 0;
+    m_u16RawLength = 0;
+    m_bOpen = false;
+}
+
+//---------------------------------------------------------------------------
+void LogCompressor::PutBits(uint32_t u32Bits_, int iCount_)
+{
+    m_u32Bits = (m_u32Bits << iCount_) | u32Bits_;
+    m_iBits += iCount_;
+    while (m_iBits >= 8) {
+        m_iBits -= 8;
+        m_au8Block[sizeof(LogCompressedHeader_t) + m_iBlockLength++] = (uint8_t)(m_u32Bits >> m_iBits);
+    }
+}
+
+//---------------------------------------------------------------------------
+void LogCompressor::Slide()
+{
+    auto iShift = m_iPos - m_iWindowSize;
+    if (iShift <= 0) {
+        return;
+    }
+    memmove(m_au8Buf, &m_au8Buf[iShift], m_iEnd - iShift);
+    m_iPos -= iShift;
+    m_iEnd -= iShift;
+    m_u16Base += iShift;
+}
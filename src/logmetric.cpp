@@ -0,0 +1,93 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logmetric.cpp On-target aggregated metrics: counters, gauges and histograms
+ */
+#include "logmetric.h"
+
+#include "mark3.h"
+
+#include <string.h>
+
+using namespace Mark3;
+
+//---------------------------------------------------------------------------
+namespace {
+    template <typename T>
+    int PutArg(uint8_t* pu8Tlv_, int idx_, LogTag eTag_, SizeTag eSize_, T value_)
+    {
+        pu8Tlv_[idx_++] = tlv_byte(eTag_, eSize_);
+        memcpy(&pu8Tlv_[idx_], &value_, sizeof(value_));
+        return idx_ + sizeof(value_);
+    }
+} // anonymous namespace
+
+//---------------------------------------------------------------------------
+LogMetric* LogMetric::m_pclHead = nullptr;
+
+//---------------------------------------------------------------------------
+LogMetric::LogMetric(Kind eKind_, uint32_t u32Id_)
+: m_pclNext{m_pclHead}
+, m_u32Id{u32Id_}
+, m_eKind{eKind_}
+{
+    // Metrics are constructed during static initialization, before any
+    // other context can walk the list.
+    m_pclHead = this;
+}
+
+//---------------------------------------------------------------------------
+int LogMetric::Summarize(uint8_t* pu8Tlv_, uint8_t* pu8Count_)
+{
+    auto idx = PutArg(pu8Tlv_, 0, LogTag::LogTagUint32, SizeTag::LogTagUint32, m_u32Id);
+    switch (m_eKind) {
+        case Kind::Counter: {
+            auto* pclCounter = static_cast<LogCounter*>(this);
+            auto u32Count = __atomic_exchange_n(&pclCounter->m_u32Count, 0, __ATOMIC_RELAXED);
+            idx = PutArg(pu8Tlv_, idx, LogTag::LogTagUint32, SizeTag::LogTagUint32, u32Count);
+            *pu8Count_ = 2;
+        } break;
+        case Kind::Gauge: {
+            auto* pclGauge = static_cast<LogGauge*>(this);
+            CriticalSection::Enter();
+            auto i32Value = pclGauge->m_i32Value;
+            auto i32Min = pclGauge->m_i32Min;
+            auto i32Max = pclGauge->m_i32Max;
+            pclGauge->m_i32Min = INT32_MAX;
+            pclGauge->m_i32Max = INT32_MIN;
+            CriticalSection::Exit();
+            // A gauge that wasn't set during the interval held its last value
+            if (i32Min > i32Max) {
+                i32Min = i32Value;
+                i32Max = i32Value;
+            }
+            idx = PutArg(pu8Tlv_, idx, LogTag::LogTagInt32, SizeTag::LogTagInt32, i32Value);
+            idx = PutArg(pu8Tlv_, idx, LogTag::LogTagInt32, SizeTag::LogTagInt32, i32Min);
+            idx = PutArg(pu8Tlv_, idx, LogTag::LogTagInt32, SizeTag::LogTagInt32, i32Max);
+            *pu8Count_ = 4;
+        } break;
+        case Kind::Histogram: {
+            auto* pclHistogram = static_cast<LogHistogramBase*>(this);
+            auto u16Length = (uint16_t)((pclHistogram->m_iBounds + 1) * sizeof(uint32_t));
+            idx = PutArg(pu8Tlv_, idx, LogTag::LogTagBlob, SizeTag::LogTagBlob, u16Length);
+            for (auto i = 0; i <= pclHistogram->m_iBounds; i++) {
+                auto u32Count = __atomic_exchange_n(&pclHistogram->m_pu32Counts[i], 0, __ATOMIC_RELAXED);
+                memcpy(&pu8Tlv_[idx], &u32Count, sizeof(u32Count));
+                idx += sizeof(u32Count);
+            }
+            *pu8Count_ = 2;
+        } break;
+    }
+    return idx;
+}
@@ -0,0 +1,39 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file crc32.h   Compact CRC-32 (IEEE 802.3) implementation, shared with host tools
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//---------------------------------------------------------------------------
+// Computes the standard (reflected, polynomial 0xEDB88320) CRC-32 a nibble at
+// a time, trading speed for a 64-byte table.  Used to validate small blocks of
+// metadata, rather than bulk data.
+inline uint32_t crc32_nibble(const void* pvData_, size_t uLength_)
+{
+    static const uint32_t au32Table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    auto* pu8Data = (const uint8_t*)pvData_;
+    uint32_t u32Crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < uLength_; i++) {
+        u32Crc = au32Table[(u32Crc ^ pu8Data[i]) & 0x0F] ^ (u32Crc >> 4);
+        u32Crc = au32Table[(u32Crc ^ (pu8Data[i] >> 4)) & 0x0F] ^ (u32Crc >> 4);
+    }
+    return ~u32Crc;
+}
@@ -16,14 +16,98 @@ See license.txt for more information
  */
 #pragma once
 
+#include "logmetric.h"
 #include "logtypes.h"
 
+#include <stdarg.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+
+//---------------------------------------------------------------------------
+// Number of independent log buffers ("shards") available to the application.
+// Each shard has its own ring buffer, so this should be left at 1 unless
+// logs are sharded by context (see LogBuf::SetShardSelector()).
+#if !defined(LOGBUF_SHARD_COUNT)
+#define LOGBUF_SHARD_COUNT (1)
+#endif
+
+//---------------------------------------------------------------------------
+// Define LOGBUF_NOINIT to place the log buffers in the .noinit section (which
+// the linker script must leave uninitialized at startup), turning them into a
+// flight recorder: records committed but not yet flushed when the target
+// faults or resets are recovered by LogBuf::Recover() on the next boot, and
+// flushed as a post-mortem dump.
+
+//---------------------------------------------------------------------------
+// Define LOGBUF_FRAMING to add a per-shard sequence number and a CRC-16 to each
+// record (see log_flag_sequence and log_flag_crc), at a cost of 4 bytes per
+// record, so that host tools can reject torn or corrupted records, and count
+// the records lost between those received.
+
+//---------------------------------------------------------------------------
+// Define LOGBUF_STATS to have each shard keep statistics on its own operation
+// (see LogStats_t and LogBuf::GetStats()): how close the ring comes to being
+// overrun, the records and bytes passing through it, and the time spent with
+// interrupts disabled and flushing.  These can also be written to the capture
+// periodically (see LogBuf::SetStatsInterval()), so that ring sizes and flush
+// periods can be chosen from measurements of the running application.
+
+//---------------------------------------------------------------------------
+// Define LOGBUF_SITE_FILTER to allow DEBUG_LOG() sites to be enabled and
+// disabled individually at runtime (see LogBuf::EnableSite() and
+// LogCommandReader).  Each site places a key in the "logger_sites" section,
+// which the linker script must keep (in flash), and which GNU ld brackets with
+// the __start_logger_sites and __stop_logger_sites symbols.  Sites beyond the
+// first LOGBUF_MAX_SITES are always enabled.
+#if defined(LOGBUF_SITE_FILTER)
+#if !defined(LOGBUF_MAX_SITES)
+#define LOGBUF_MAX_SITES (1024)
+#endif
+extern "C" const LogSiteKey_t __start_logger_sites[];
+extern "C" const LogSiteKey_t __stop_logger_sites[];
+#endif
 
 //---------------------------------------------------------------------------
 using LogNotification_t = void (*)();
 using LogWrite_t = void (*)(const uint8_t* data_, size_t length_);
+using LogTimestamp_t = uint32_t (*)();
+using LogShardSelect_t = uint8_t (*)();
+using LogInIsr_t = bool (*)();
+
+//---------------------------------------------------------------------------
+// Segment of data passed to a vectored log writer (see LogBuf::SetVectorWriter())
+struct LogIoVec_t {
+    const uint8_t* data;
+    size_t length;
+};
+
+// Vectored log writer: writes the segments in order, and returns the number of
+// bytes consumed from the start of the first (less than their total length if
+// the transport can't accept them all right now).
+using LogWriteV_t = size_t (*)(const LogIoVec_t* vec_, int count_);
+
+#if defined(LOGBUF_STATS)
+//---------------------------------------------------------------------------
+// Statistics kept by a shard since it was started, or last reset.  Times are
+// in ticks of the stats clock (see LogBuf::SetStatsClock()).
+typedef struct {
+    uint32_t records;           //!< Records committed to the ring (not counting coalesced duplicates)
+    uint32_t bytes;             //!< Bytes committed to the ring, including framing and repeat records
+    uint32_t records_flushed;   //!< Records committed ahead of the last complete flush
+    uint32_t bytes_flushed;     //!< Bytes written from the ring by flushes
+    uint32_t overruns;          //!< Records written over data that hadn't yet been flushed
+    uint16_t high_water;        //!< Largest backlog of unflushed data, in bytes (the size of the ring, once overrun)
+    uint32_t lock_max;          //!< Longest critical section in BeginWrite()/EndWrite()
+    uint32_t lock_total;        //!< Total time spent in those critical sections
+    uint32_t lock_count;        //!< Number of those critical sections
+    uint32_t flush_max;         //!< Longest call to FlushData()
+    uint32_t flush_total;       //!< Total time spent in FlushData()
+    uint32_t flush_count;       //!< Number of calls to FlushData()
+} LogStats_t;
+#endif
+
+class LogCompressor;
 
 //---------------------------------------------------------------------------
 /**
@@ -36,36 +120,348 @@ using LogWrite_t = void (*)(const uint8_t* data_, size_t length_);
  * need to re-synchronize on the next valid packet.
  *
  * Guarantees thread/interrupt safety under certain conditions.
+ *
+ * Logs can optionally be sharded across LOGBUF_SHARD_COUNT buffers, i.e. one
+ * per thread, priority, or interrupt level, so that a burst of logs from one
+ * context can't overwrite unflushed logs from another.  A shard written to by
+ * only a single producer (i.e. producers that cannot pre-empt each other) can
+ * be marked as such, in which case records are written to it without entering
+ * a critical section.
  */
 class LogBuf {
 public:
 
     /**
      * @brief Instance
-     * @return Reference to the singleton LogBuf instance
+     * @return Reference to the primary LogBuf instance (shard 0)
      */
     static LogBuf& Instance();
 
+    /**
+     * @brief Shard
+     * @param u8Shard_ Index of the shard (0 to LOGBUF_SHARD_COUNT - 1)
+     * @return Reference to the given shard's LogBuf instance
+     */
+    static LogBuf& Shard(uint8_t u8Shard_);
+
+    /**
+     * @brief Current
+     *
+     * Return the shard that logs from the calling context are written to, as
+     * chosen by the shard selector (or the primary instance if none is set).
+     * This is used by the logging macros.
+     *
+     * @return Reference to the current context's LogBuf instance
+     */
+    static LogBuf& Current()
+    {
+        return m_pfShardSelect ? Shard(m_pfShardSelect()) : Instance();
+    }
+
+    /**
+     * @brief Recover
+     *
+     * Initialize the log buffers, recovering any records that were committed
+     * but not flushed before the target was reset.  Recovered records are
+     * flushed first, between a pair of post-mortem records.  When built with
+     * LOGBUF_NOINIT, this must be called once at startup, before any other
+     * LogBuf methods; otherwise, it does nothing.
+     *
+     * @return true if records were recovered
+     */
+    static bool Recover();
+
+    /**
+     * @brief SetShardSelector
+     *
+     * Set the function used to pick a shard for the calling context (i.e. from
+     * the current thread's priority, or the active interrupt level).  Once set,
+     * each flush of a shard begins with a shard record, so that host tools can
+     * attribute records to shards and merge them back into timestamp order.
+     *
+     * @param pfShardSelect_ Function returning the current context's shard
+     */
+    static void SetShardSelector(LogShardSelect_t pfShardSelect_);
+
+    /**
+     * @brief FlushAll
+     *
+     * Flush all written data from all shards to the debug interface. When the
+     * writer accepts only part of a shard's data, the remaining shards are left
+     * for the next call, so that they aren't written into the middle of a record.
+     */
+    static void FlushAll();
+
+    /**
+     * @brief SetSingleProducer
+     *
+     * Mark the shard as written to from a single context (or contexts that
+     * cannot pre-empt each other), allowing records to be written without
+     * entering a critical section.  Must be set before any records are
+     * written to the shard.
+     *
+     * @param bSingleProducer_ true if the shard has a single producer
+     */
+    void SetSingleProducer(bool bSingleProducer_);
+
+    /**
+     * @brief SetCoalescing
+     *
+     * Enable or disable coalescing of duplicate records.  When enabled, each
+     * record is compared against the previous record in the shard as it's
+     * committed; a record identical to it in all but its timestamp is dropped,
+     * and counted instead.  The run of duplicates is reported by a single
+     * repeat record, written ahead of the next record that differs, or at the
+     * next flush (which then reports each further duplicate in the run).
+     *
+     * Comparing each record costs a pass over its bytes as it's committed.  A
+     * record is only compared if no other records are being written to the
+     * shard at the time, and records in snapshot mode aren't coalesced.
+     *
+     * @param bEnable_ true to coalesce duplicate records
+     */
+    void SetCoalescing(bool bEnable_);
+
     /**
      * @brief SetNotifyCallback
      *
-     * Set a callback to be invoked whenever the object detects that a FIFO
-     * rollover or half-rollover has occurred.  This is used to provide a means
-     * for the application to call FlushData() on the object from the desired
-     * context in a timely fashion (i.e., before the next rollover can occur).
+     * Set a callback to be invoked whenever the object detects that enough
+     * data has been written to warrant a flush (see SetNotifyThresholds()).
+     * This is used to provide a means for the application to call FlushData()
+     * on the object from the desired context in a timely fashion (i.e., before
+     * the buffer can be overrun).  Shards without a callback of their own use
+     * the primary instance's.
      *
-     * @param pfHandler_ Notification function to call on FIFO rollover/half-rollover
+     * @param pfHandler_ Notification function to call when data should be flushed
      */
     void SetNotifyCallback(LogNotification_t pfHandler_);
 
+    /**
+     * @brief SetNotifyThresholds
+     *
+     * Set the conditions under which the notification callback is invoked.
+     * The callback is invoked once when the amount of unflushed data reaches
+     * the high watermark, or when the given number of records have been written
+     * since the last notification.  Further notifications are suppressed until
+     * the buffer has been flushed down to the low watermark, so a burst of
+     * writes only signals the flushing context once.  Regardless of these
+     * settings, the callback is invoked once more if the buffer is in danger of
+     * being overrun.
+     *
+     * By default, the high watermark is half the buffer, the low watermark is
+     * a quarter of the buffer, and the record trigger is disabled.
+     *
+     * @param u16HighWatermark_ Unflushed bytes at which to notify (0 to disable)
+     * @param u16LowWatermark_ Unflushed bytes at or below which notifications
+     *        are re-armed
+     * @param u16RecordCount_ Number of records at which to notify (0 to disable)
+     */
+    void SetNotifyThresholds(uint16_t u16HighWatermark_, uint16_t u16LowWatermark_, uint16_t u16RecordCount_ = 0);
+
+    /**
+     * @brief SetNotifyInterval
+     *
+     * Set the minimum interval between notifications, in timestamp source
+     * units.  A notification that falls within the interval is held off until
+     * the first record written after it has elapsed, unless the buffer is in
+     * danger of being overrun.
+     *
+     * @param u32MinInterval_ Minimum interval between notifications (0 to disable)
+     */
+    void SetNotifyInterval(uint32_t u32MinInterval_);
+
+    /**
+     * @brief SetNotifyDeferral
+     *
+     * Set a function that reports whether the caller is running in interrupt
+     * context (i.e. by reading the active exception number).  Notifications
+     * raised from interrupt context are deferred until the next record is
+     * written from thread context, or until ServiceNotify() is called.
+     *
+     * @param pfInIsr_ Function returning true when called from an interrupt
+     */
+    static void SetNotifyDeferral(LogInIsr_t pfInIsr_);
+
+    /**
+     * @brief ServiceNotify
+     *
+     * Invoke the notification callback for any shards with notifications
+     * deferred out of interrupt context.  Call this from thread context (i.e.
+     * from the idle thread, or a periodic timer thread).
+     */
+    static void ServiceNotify();
+
+    /**
+     * @brief SetSnapshotMode
+     *
+     * Enable or disable snapshot mode.  In snapshot mode, records are written
+     * to the ring continuously, overwriting the oldest records, and nothing is
+     * flushed (or notified) until a snapshot is triggered (see TriggerSnapshot()
+     * and SetTriggerSite()).  Once the given number of records have been written
+     * following the trigger, the shard freezes, dropping any further records,
+     * and the notification callback is invoked.  The next flush writes the
+     * window of records around the trigger, with a trigger record marking the
+     * point at which it occurred, and recording then resumes.
+     *
+     * Any unflushed records are flushed when the mode is changed; records
+     * written in snapshot mode that haven't been captured by a snapshot are
+     * discarded.
+     *
+     * @param bEnable_ true to enable snapshot mode
+     * @param u16PostTrigger_ Number of records to write following a trigger
+     */
+    void SetSnapshotMode(bool bEnable_, uint16_t u16PostTrigger_ = 0);
+
+    /**
+     * @brief TriggerSnapshot
+     *
+     * Trigger a snapshot on all shards in snapshot mode (shards that have
+     * already been triggered are unaffected).  This can be called from any
+     * context, including an assert or panic handler - in which case, no further
+     * records may follow, so freeze the shards immediately and flush them with
+     * FlushAll().
+     *
+     * @param bFreeze_ true to freeze without waiting for post-trigger records
+     */
+    static void TriggerSnapshot(bool bFreeze_ = false);
+
+    /**
+     * @brief SetTriggerSite
+     *
+     * Trigger a snapshot whenever a record is written from the given call site,
+     * with the trigger record preceding the site's record.
+     *
+     * @param u32FileId_ File ID of the site (i.e. HASH(main.cpp)), or 0 to disable
+     * @param u16Line_ Line number of the site
+     */
+    static void SetTriggerSite(uint32_t u32FileId_, uint16_t u16Line_);
+
     /**
      * @brief SetLogWriter
      *
-     * Set the function to call to write data payloads over the wire.
+     * Set the function to call to write data payloads over the wire.  Shards
+     * without a writer of their own use the primary instance's (and its
+     * compressor).
+     *
+     * Flushed data can optionally be compressed on its way to the writer, in
+     * which case host tools must decompress the capture (i.e. logtool -Z).
+     * Shards sharing a writer should also share its compressor.
      *
      * @param pfLogWriter_ Function to call to write log data.
+     * @param pclCompressor_ Compressor to pass flushed data through, or nullptr
+     *        to write it as-is
+     */
+    void SetLogWriter(LogWrite_t pfLogWriter_, LogCompressor* pclCompressor_ = nullptr);
+
+    /**
+     * @brief SetVectorWriter
+     *
+     * Set a vectored function to write data payloads over the wire, in place
+     * of a writer set by SetLogWriter().  Where the data flushed from the ring
+     * wraps around its end, both segments are passed in a single call, so the
+     * transport's per-transfer setup is paid once per flush.
+     *
+     * The writer may accept only part of the data (i.e. a non-blocking writer
+     * whose transmit queue is full): data it doesn't consume stays in the ring,
+     * and is written by the next flush.  Records written directly by the
+     * logger (i.e. shard, repeat and metric records, and snapshots) aren't
+     * retained, so a partial write of one of those truncates it.  Flushed data
+     * can't be compressed on its way to a vectored writer.
+     *
+     * @param pfVectorWriter_ Function to call to write log data.
+     */
+    void SetVectorWriter(LogWriteV_t pfVectorWriter_);
+
+    /**
+     * @brief SetTimestampSource
+     *
+     * Set the function used to timestamp records, in place of the kernel tick
+     * count (i.e. a cycle counter or free-running hardware timer, for sub-tick
+     * ordering of records).  The source must be a free-running 32-bit counter,
+     * which may wrap, and must be cheap enough to read from any context that
+     * writes logs.  A clock-rate record is written when the source is changed,
+     * so host tools can convert timestamps to time.
+     *
+     * The source is shared by all shards, so their records can be merged.
+     *
+     * @param pfTimestamp_ Function returning the current timestamp
+     * @param u32FrequencyHz_ Rate at which the timestamp increments, in Hz
+     */
+    static void SetTimestampSource(LogTimestamp_t pfTimestamp_, uint32_t u32FrequencyHz_);
+
+    /**
+     * @brief SetMetricInterval
+     *
+     * Set the interval at which metrics (see LogMetric) are summarized.  Each
+     * metric's summary record is written by the primary buffer's FlushData(),
+     * following its data, on the first flush after the interval elapses, so
+     * the primary buffer must be flushed at least this often.
+     *
+     * @param u32Ms_ Interval, in milliseconds (0 to summarize on every flush)
+     */
+    static void SetMetricInterval(uint32_t u32Ms_) { m_u32MetricInterval = u32Ms_; }
+
+#if defined(LOGBUF_STATS)
+    /**
+     * @brief SetStatsClock
+     *
+     * Set the clock used to time critical sections and flushes.  These are
+     * typically far shorter than a timestamp tick, so this should be a cycle
+     * counter or free-running hardware timer; by default, the timestamp
+     * source is used.
+     *
+     * @param pfClock_ Function returning the current clock count, or nullptr
+     *        to use the timestamp source
+     * @param u32FrequencyHz_ Rate at which the clock increments, in Hz
      */
-    void SetLogWriter(LogWrite_t pfLogWriter_);
+    static void SetStatsClock(LogTimestamp_t pfClock_, uint32_t u32FrequencyHz_);
+
+    /**
+     * @brief SetStatsInterval
+     *
+     * Write this shard's statistics to the capture as a stats record, on the
+     * first flush after each interval elapses.  Records aren't written in
+     * snapshot mode.
+     *
+     * @param u32Ms_ Interval, in milliseconds (0 to disable)
+     */
+    void SetStatsInterval(uint32_t u32Ms_) { m_u32StatsInterval = u32Ms_; }
+
+    /**
+     * @brief GetStats
+     *
+     * Take a copy of this shard's statistics.
+     *
+     * @param pstStats_ [out] Statistics
+     */
+    void GetStats(LogStats_t* pstStats_);
+
+    /**
+     * @brief ResetStats
+     *
+     * Reset this shard's statistics, i.e. to measure a single phase of the
+     * application.
+     */
+    void ResetStats();
+#endif
+
+    /**
+     * @brief GetTimestamp
+     * @return Current value of the timestamp source, used to stamp records
+     */
+    static uint32_t GetTimestamp() { return m_pfTimestamp(); }
+
+    /**
+     * @brief GetTimestamp64
+     *
+     * Return the current timestamp, extended to 64 bits.  The extension is
+     * maintained as records are written, and is only guaranteed to be correct
+     * if records are written (or this function is called) at least once per
+     * half-period of the 32-bit timestamp source.
+     *
+     * @return Current timestamp, extended to 64 bits
+     */
+    uint64_t GetTimestamp64();
 
     /**
      * @brief WriteLog
@@ -80,6 +476,354 @@ public:
      */
     void WriteLog(int length_, const LogHeader_t* header_, const Tlv_t data[]);
 
+    /**
+     * @brief BeginLog
+     *
+     * Begin writing a record in place - reserving space for the record in the
+     * buffer, and writing its header.  The record's arguments are then written
+     * with WriteArg(), and the record completed with EndLog().  This is used by
+     * the logging macros, which serialize arguments straight into the buffer.
+     *
+     * @param length_ Length of the record (header and arguments), in bytes
+     * @param u32FileId_ File ID of the record
+     * @param u16Line_ Line number of the record
+     * @param u8Count_ Number of arguments in the record
+     * @param u32Timestamp_ Timestamp of the record
+     * @return Index at which to write the record's first argument, or -1 if the
+     *         record was dropped (the shard is frozen, holding a snapshot), in
+     *         which case no arguments are written, and EndLog() isn't called
+     */
+    int BeginLog(int length_, uint32_t u32FileId_, uint16_t u16Line_, uint8_t u8Count_, uint32_t u32Timestamp_);
+
+    /**
+     * @brief WriteArg
+     *
+     * Write a fixed-size argument (its tag/length byte, then its value) to a
+     * record started with BeginLog().
+     *
+     * @param idx_ Index at which to write the argument
+     * @param u8Tlv_ Tag/length byte of the argument (see tlv_byte())
+     * @param value_ Argument value
+     * @return Index at which to write the next argument
+     */
+    template <typename T>
+    int WriteArg(int idx_, uint8_t u8Tlv_, const T& value_)
+    {
+        struct __attribute__((packed)) {
+            uint8_t tlv;
+            T value;
+        } arg = { u8Tlv_, value_ };
+        return Put(idx_, arg);
+    }
+
+    /**
+     * @brief WriteArg
+     *
+     * Write a TagStrcopy argument (its tag/length byte, length, and characters)
+     * to a record started with BeginLog().
+     *
+     * @param idx_ Index at which to write the argument
+     * @param u8Tlv_ Tag/length byte of the argument
+     * @param value_ String to copy
+     * @return Index at which to write the next argument
+     */
+    int WriteArg(int idx_, uint8_t u8Tlv_, const LogStrcopy_t& value_);
+
+    /**
+     * @brief WriteArg
+     *
+     * Write a TagBlob argument (its tag/length byte, length, and data) to a
+     * record started with BeginLog().
+     *
+     * @param idx_ Index at which to write the argument
+     * @param u8Tlv_ Tag/length byte of the argument
+     * @param value_ Data to copy
+     * @return Index at which to write the next argument
+     */
+    int WriteArg(int idx_, uint8_t u8Tlv_, const LogBlob_t& value_);
+
+    /**
+     * @brief EndLog
+     *
+     * Complete a record started with BeginLog(), making it available to flush.
+     *
+     * @param start_ Index returned by BeginLog() for the record
+     * @param idx_ Index following the record's last argument
+     */
+    void EndLog(int start_, int idx_)
+    {
+#if defined(LOGBUF_FRAMING)
+        idx_ = WriteCrc(start_, idx_);
+#else
+        (void)start_;
+#endif
+        EndWrite(idx_);
+    }
+
+    /**
+     * @brief ArgLength
+     * @return Number of bytes an argument's value occupies in a record beyond
+     *         the fixed size given by its SizeTag (i.e. a copied string's
+     *         characters)
+     */
+    template <typename T>
+    static constexpr int ArgLength(const T&) { return 0; }
+    static int ArgLength(const LogStrcopy_t& value_) { return value_.length; }
+    static int ArgLength(const LogBlob_t& value_) { return value_.length; }
+
+    /**
+     * @brief LogSite
+     *
+     * Write a record for a DEBUG_LOG() call site to the current context's log
+     * buffer.  This is the shared encoder used by the logging macros, so that
+     * the code at each call site is reduced to a single call, passing the site's
+     * constant descriptor and its argument values.
+     *
+     * @param pstSite_ Constant descriptor of the call site
+     * @param ... Argument values, of the types given by the site's tags
+     */
+    static void LogSite(const LogSite_t* pstSite_, ...);
+
+    /**
+     * @brief LogSite
+     *
+     * Write a record for a sampled or rate-limited call site, appending the
+     * number of calls suppressed since the site's previous record (if any).
+     *
+     * @param pstLimit_ State of the call site (see LimitEveryN(), LimitRate())
+     * @param pstSite_ Constant descriptor of the call site
+     * @param ... Argument values, of the types given by the site's tags
+     */
+    static void LogSite(LogLimit_t* pstLimit_, const LogSite_t* pstSite_, ...);
+
+    /**
+     * @brief LogSite
+     *
+     * Write a record for a call site without a suppressed-call count (used by
+     * the logging macros for unlimited sites).
+     */
+    template <typename... Args>
+    static void LogSite(decltype(nullptr), const LogSite_t* pstSite_, Args... args_)
+    {
+        LogSite(pstSite_, args_...);
+    }
+
+    /**
+     * @brief LimitOnce
+     *
+     * Gate a call site so that only its first call is logged (see
+     * DEBUG_LOG_ONCE()).
+     *
+     * @param pstLimit_ State of the call site
+     * @return true if the call should be logged
+     */
+    static bool LimitOnce(LogLimit_t* pstLimit_)
+    {
+        if (pstLimit_->count) {
+            return false;
+        }
+        pstLimit_->count = 1;
+        return true;
+    }
+
+    /**
+     * @brief LimitEveryN
+     *
+     * Gate a call site so that only every Nth call is logged, starting with
+     * the first (see DEBUG_LOG_EVERY_N()).  A suppressed call costs a single
+     * compare and two increments of the site's state: the timestamp isn't
+     * read, and no critical section is entered.
+     *
+     * The site's state isn't protected by a critical section, so a site called
+     * concurrently from several contexts may occasionally log an extra record,
+     * or miscount the calls it suppressed.
+     *
+     * @param pstLimit_ State of the call site
+     * @param u32Interval_ Number of calls per record (at least 1)
+     * @return true if the call should be logged
+     */
+    static bool LimitEveryN(LogLimit_t* pstLimit_, uint32_t u32Interval_)
+    {
+        if (pstLimit_->count) {
+            pstLimit_->count--;
+            pstLimit_->suppressed++;
+            return false;
+        }
+        pstLimit_->count = u32Interval_ - 1;
+        return true;
+    }
+
+    /**
+     * @brief LimitRate
+     *
+     * Gate a call site so that at most a given number of calls are logged per
+     * interval (see DEBUG_LOG_RATE()).  The interval begins with the first call
+     * logged after the previous one has elapsed.  Calls within the allowance
+     * are let through with a single compare; once it's exhausted, each call
+     * reads the timestamp to check for the end of the interval, but no
+     * critical section is entered.  As with LimitEveryN(), concurrent calls
+     * from several contexts may miscount.
+     *
+     * @param pstLimit_ State of the call site
+     * @param u32Count_ Number of calls logged per interval (at least 1)
+     * @param u32Ms_ Length of the interval, in milliseconds
+     * @return true if the call should be logged
+     */
+    static bool LimitRate(LogLimit_t* pstLimit_, uint32_t u32Count_, uint32_t u32Ms_)
+    {
+        if (pstLimit_->count && (pstLimit_->count < u32Count_)) {
+            pstLimit_->count++;
+            return true;
+        }
+        return LimitRateWindow(pstLimit_, u32Ms_);
+    }
+
+    /**
+     * @brief TakeSuppressed
+     * @param pstLimit_ State of the call site, or nullptr for unlimited sites
+     * @return Number of calls suppressed since the site's last record, which
+     *         is then reset
+     */
+    static constexpr uint32_t TakeSuppressed(decltype(nullptr)) { return 0; }
+    static uint32_t TakeSuppressed(LogLimit_t* pstLimit_)
+    {
+        auto u32Suppressed = pstLimit_->suppressed;
+        pstLimit_->suppressed = 0;
+        return u32Suppressed;
+    }
+
+    /**
+     * @brief SuppressedLength
+     * @return Number of bytes added to a record to carry a suppressed-call count
+     */
+    static constexpr int SuppressedLength(uint32_t u32Suppressed_)
+    {
+        return u32Suppressed_ ? (sizeof(uint8_t) + sizeof(uint32_t)) : 0;
+    }
+
+    /**
+     * @brief SuppressedFlag
+     * @return Flag added to a record's argument count (see BeginLog()) to
+     *         signal that it carries a suppressed-call count
+     */
+    static constexpr uint8_t SuppressedFlag(uint32_t u32Suppressed_)
+    {
+        return u32Suppressed_ ? (log_flag_suppressed + 1) : 0;
+    }
+
+    /**
+     * @brief WriteSuppressed
+     *
+     * Write a suppressed-call count (if non-zero) as the last argument of a
+     * record started with BeginLog().
+     *
+     * @param idx_ Index at which to write the argument
+     * @param u32Suppressed_ Number of calls suppressed
+     * @return Index at which to write the next argument
+     */
+    int WriteSuppressed(int idx_, uint32_t u32Suppressed_)
+    {
+        if (!u32Suppressed_) {
+            return idx_;
+        }
+        return WriteArg(idx_, tlv_byte(LogTag::LogTagUint32, SizeTag::LogTagUint32), u32Suppressed_);
+    }
+
+    /**
+     * @brief LogScope
+     *
+     * Write a scope begin or end record to the current context's log buffer
+     * (see TRACE_SCOPE(), TRACE_BEGIN() and TRACE_END()).  The record holds no
+     * format string, only the scope's id: host tools pair each end with the
+     * latest unmatched begin of the same scope from the same shard, and name
+     * the scope from its .logger record.
+     *
+     * @param eType_ LogSystemRecord::ScopeBegin or LogSystemRecord::ScopeEnd
+     * @param u32Scope_ Scope id (hash of the scope's name)
+     */
+    static void LogScope(LogSystemRecord eType_, uint32_t u32Scope_);
+
+#if defined(LOGBUF_SITE_FILTER)
+    /**
+     * @brief SiteEnabled
+     *
+     * Check whether a site is enabled, ahead of any other work done by the
+     * site (see DEBUG_LOG()).
+     *
+     * @param pstKey_ The site's key, in the "logger_sites" section
+     * @return true if the site's records are to be written
+     */
+    static bool SiteEnabled(const LogSiteKey_t* pstKey_)
+    {
+        auto uIndex = (size_t)(pstKey_ - __start_logger_sites);
+        return (uIndex >= LOGBUF_MAX_SITES)
+               || !(__atomic_load_n(&m_au32SiteDisabled[uIndex / 32], __ATOMIC_RELAXED) & (1u << (uIndex % 32)));
+    }
+
+    /**
+     * @brief GetSiteCount
+     * @return Number of sites in the image (including any beyond LOGBUF_MAX_SITES)
+     */
+    static uint16_t GetSiteCount() { return (uint16_t)(__stop_logger_sites - __start_logger_sites); }
+
+    /**
+     * @brief EnableSite
+     *
+     * Enable or disable a site, given its index in the "logger_sites" section.
+     * Host tools resolve sites (by file, line or format string) to indexes
+     * from the image and the .logger section.
+     *
+     * @param u16Index_ Index of the site
+     * @param bEnable_ true to enable the site, false to disable it
+     * @return true if the site's state changed
+     */
+    static bool EnableSite(uint16_t u16Index_, bool bEnable_);
+
+    /**
+     * @brief EnableAllSites
+     * @param bEnable_ true to enable every site, false to disable every site
+     *        (up to LOGBUF_MAX_SITES)
+     * @return Number of sites whose state changed
+     */
+    static uint16_t EnableAllSites(bool bEnable_);
+
+    /**
+     * @brief LogSiteFilter
+     *
+     * Write a site filter record to the current context's log buffer,
+     * acknowledging a command from the host.
+     *
+     * @param eCommand_ Command executed
+     * @param u16Sites_ Number of sites it changed
+     */
+    static void LogSiteFilter(LogCommand eCommand_, uint16_t u16Sites_);
+#endif
+
+    /**
+     * @brief WriteClockSync
+     *
+     * Write a clock-sync record, pairing the current kernel tick count with a
+     * wall-clock time, allowing host tools to convert timestamps to wall-clock
+     * time.  This should be called periodically (i.e. once per flush, or once
+     * every few seconds), with a time read as close to the call as possible.
+     *
+     * @param u64EpochUs_ Current wall-clock time, in microseconds since the epoch
+     */
+    void WriteClockSync(uint64_t u64EpochUs_);
+
+    /**
+     * @brief WriteClockRate
+     *
+     * Write a clock-rate record, containing the frequency of the timestamp
+     * source and the current timestamp extended to 64 bits.  Host tools use
+     * the frequency to convert timestamps to time, and the extended timestamp
+     * to re-anchor their own extension of the 32-bit timestamps in records
+     * (i.e. after a gap in the capture longer than the counter's period).
+     * This is written automatically by SetTimestampSource(), and should also
+     * be called periodically (i.e. along with WriteClockSync()).
+     */
+    void WriteClockRate();
+
     /**
      * @brief FlushData
      *
@@ -88,21 +832,338 @@ public:
     void FlushData();
 
 private:
+    /**
+     * @brief FlushRing
+     *
+     * Write the data committed to the ring since the last flush, along with
+     * the records that follow it (repeat, stats and metric records).
+     */
+    void FlushRing();
 
     /**
      * @brief BeginWrite
      *
-     * Begin a new log - reserving the appropriate number of bytes in the buffer,
-     * and returning an offset into the buffer at which logs will be written.
+     * Begin a new log - reserving the appropriate number of bytes in the buffer
+     * (including the record's sync words), and returning an offset into the
+     * buffer at which the record will be written.
      *
      * Note: in a multithreaded application, or an application where logs are written
      * from ISRs, BeginWrite()/Write()/EndWrite() calls must be called from within
      * a single critical section.
      *
      * @param size_ Number of bytes to reserve in the buffer
-     * @return Index to begin logging at
+     * @param timestamp_ Timestamp of the record being written, used to maintain
+     *        the 64-bit timestamp extension
+     * @param pu16Sequence_ [out] Sequence number of the record
+     * @return Index to begin logging at, or -1 if the shard is frozen
+     */
+    int BeginWrite(int size_, uint32_t timestamp_, uint16_t* pu16Sequence_);
+
+    /**
+     * @brief PutHeader
+     *
+     * Write the start of a record (its sync word, header, and sequence number)
+     * to the log buffer.
+     *
+     * @param idx_ Index at which to write the record
+     * @param u32FileId_ File ID of the record
+     * @param u16Line_ Line number of the record
+     * @param u8Count_ Number of arguments in the record
+     * @param u32Timestamp_ Timestamp of the record
+     * @param u16Sequence_ Sequence number of the record (LOGBUF_FRAMING only)
+     * @return Index at which to write the record's first argument
+     */
+    int PutHeader(int idx_, uint32_t u32FileId_, uint16_t u16Line_, uint8_t u8Count_, uint32_t u32Timestamp_,
+                  uint16_t u16Sequence_);
+
+    /**
+     * @brief WriteRepeat
+     *
+     * Write a complete repeat record to the log buffer, ending a run of
+     * duplicate records.
+     *
+     * @param idx_ Index at which to write the record
+     * @param u32Repeats_ Number of duplicates in the run
+     * @param u32Timestamp_ Timestamp of the last duplicate
+     * @param u16Sequence_ Sequence number of the record
+     * @return Index following the record
+     */
+    int WriteRepeat(int idx_, uint32_t u32Repeats_, uint32_t u32Timestamp_, uint16_t u16Sequence_);
+
+    /**
+     * @brief Coalesce
+     *
+     * Compare a newly-written record against the previous record, releasing
+     * its reservation and counting it as a repeat if it's a duplicate.  Must
+     * be called from within a critical section.
+     *
+     * @param bLatest_ true if the record is the last reserved, and can be
+     *        released
+     * @return true if the record was released
+     */
+    bool Coalesce(bool bLatest_);
+
+    /**
+     * @brief SameRecord
+     * @param iFirst_ Index of the first record
+     * @param iSecond_ Index of the second record
+     * @param iLength_ Length of both records, including sync words
+     * @return true if the records are identical, but for their timestamps
+     */
+    bool SameRecord(int iFirst_, int iSecond_, int iLength_) const;
+
+    /**
+     * @brief ExtendTimestamp
+     *
+     * Account for a newly-read timestamp in the 64-bit timestamp extension.  Must
+     * be called from within a critical section.
+     *
+     * @param timestamp_ Timestamp read from the timestamp source
+     * @return The timestamp, extended to 64 bits
+     */
+    uint64_t ExtendTimestamp(uint32_t timestamp_);
+
+    /**
+     * @brief UpdateNotify
+     *
+     * Account for a newly-reserved record against the notification thresholds,
+     * flagging a notification to be sent once the record is committed.  Must
+     * be called from within a critical section.
+     *
+     * @param backlog_ Number of unflushed bytes, including the new record
+     * @param length_ Size of the new record, in bytes
+     * @param timestamp_ Timestamp of the new record
+     */
+    void UpdateNotify(int backlog_, int length_, uint32_t timestamp_);
+
+    /**
+     * @brief UpdateSnapshot
+     *
+     * Account for a newly-reserved record in snapshot mode, tracking the oldest
+     * data in the ring, and freezing the shard once the post-trigger records
+     * have been reserved.  Must be called from within a critical section.
+     *
+     * @param backlog_ Number of bytes written since the last flush, including
+     *        the new record (modulo the size of the ring)
+     * @param length_ Size of the new record, in bytes
+     */
+    void UpdateSnapshot(int backlog_, int length_);
+
+    /**
+     * @brief Trigger
+     *
+     * Trigger a snapshot of this shard, if it's in snapshot mode.
+     *
+     * @param bFreeze_ true to freeze without waiting for post-trigger records
+     */
+    void Trigger(bool bFreeze_);
+
+    /**
+     * @brief FlushSnapshot
+     *
+     * Flush a frozen snapshot to the debug interface, and resume recording.
+     * Does nothing if the shard hasn't frozen.
+     */
+    void FlushSnapshot();
+
+    /**
+     * @brief WriteSystemRecord
+     *
+     * Write a system record with single-byte arguments directly to the debug
+     * interface, as part of the data being flushed from this shard.
+     *
+     * @param pfLogWriter_ Function used to write the record
+     * @param eType_ Type of system record
+     * @param pu8Args_ Argument values, each logged as TagUint8
+     * @param u8Count_ Number of arguments (at most site_max_args)
+     * @param u32Timestamp_ Timestamp of the record
+     * @return false if a vectored writer accepted only part of the record (see
+     *         Output()), in which case nothing more may be written in this flush
+     */
+    bool WriteSystemRecord(LogWrite_t pfLogWriter_, LogSystemRecord eType_, const uint8_t* pu8Args_, uint8_t u8Count_,
+                           uint32_t u32Timestamp_);
+
+    /**
+     * @brief WriteSystemRecord
+     *
+     * Write a system record with a single TagUint32 argument directly to the
+     * debug interface.
+     */
+    bool WriteSystemRecord(LogWrite_t pfLogWriter_, LogSystemRecord eType_, uint32_t u32Arg_, uint32_t u32Timestamp_);
+
+    /**
+     * @brief WriteSystemRecord
+     *
+     * Write a system record with TLV-encoded arguments directly to the debug
+     * interface.
+     *
+     * @param pfLogWriter_ Function used to write the record
+     * @param eType_ Type of system record
+     * @param pu8Tlv_ Encoded arguments
+     * @param iLength_ Length of the encoded arguments (at most metric_summary_max)
+     * @param u8Count_ Number of arguments
+     * @param u32Timestamp_ Timestamp of the record
+     * @return false if a vectored writer accepted only part of the record
      */
-    int BeginWrite(int size_);
+    bool WriteSystemRecord(LogWrite_t pfLogWriter_, LogSystemRecord eType_, const uint8_t* pu8Tlv_, int iLength_,
+                           uint8_t u8Count_, uint32_t u32Timestamp_);
+
+    /**
+     * @brief WriteMetrics
+     *
+     * Write a summary record for each metric, if the metric interval has
+     * elapsed since the last summaries were written.
+     *
+     * @param pfLogWriter_ Function used to write the records
+     * @return false if a vectored writer accepted only part of a record; the
+     *         remaining metrics are summarized after the next interval
+     */
+    bool WriteMetrics(LogWrite_t pfLogWriter_);
+
+#if defined(LOGBUF_STATS)
+    /**
+     * @brief WriteStats
+     *
+     * Write a stats record for this shard, if the stats interval has elapsed.
+     *
+     * @param pfLogWriter_ Function used to write the record
+     * @return false if a vectored writer accepted only part of the record
+     */
+    bool WriteStats(LogWrite_t pfLogWriter_);
+
+    /**
+     * @brief PublishStats
+     *
+     * Account for records being made available to flush.
+     *
+     * @param iBytes_ Number of bytes published, which may have wrapped
+     */
+    void PublishStats(int iBytes_);
+
+    /**
+     * @brief LockStats
+     *
+     * Account for a critical section about to be exited.
+     *
+     * @param u32Start_ Stats clock at which it was entered
+     */
+    void LockStats(uint32_t u32Start_);
+
+    static uint32_t StatsClock() { return m_pfStatsClock ? m_pfStatsClock() : m_pfTimestamp(); }
+#endif
+
+    /**
+     * @brief WriterOwner
+     * @return The buffer whose writer (and compressor) this shard's data is
+     *         written through: this shard, or the primary instance
+     */
+    LogBuf& WriterOwner() { return (m_pfLogWriter || m_pfVectorWriter) ? *this : Instance(); }
+
+    /**
+     * @brief WriteSpan
+     *
+     * Write a number of bytes from the ring buffer to the debug interface.
+     *
+     * @param pfLogWriter_ Function used to write the data (nullptr when
+     *        writing through a vectored writer)
+     * @param iStart_ Index of the first byte to write
+     * @param iLength_ Number of bytes to write, up to the size of the ring
+     * @return Number of bytes written, which is less than iLength_ only if a
+     *         vectored writer accepted part of the data
+     */
+    int WriteSpan(LogWrite_t pfLogWriter_, int iStart_, int iLength_);
+
+    /**
+     * @brief WritePending
+     *
+     * Write the unflushed data in a range of the ring buffer, advancing the
+     * start of the range past the data written.
+     *
+     * @param pfLogWriter_ Function used to write the data (nullptr when
+     *        writing through a vectored writer)
+     * @param piStart_ [in/out] Index of the start of the range
+     * @param iEnd_ Index of the end of the range, which may have wrapped
+     * @return true if the whole range was written
+     */
+    bool WritePending(LogWrite_t pfLogWriter_, int* piStart_, int iEnd_);
+
+    /**
+     * @brief Output
+     *
+     * Write flushed data to the debug interface, through the compressor if
+     * there is one.  Through a vectored writer, this writes records written
+     * directly (rather than from the ring); bytes the writer doesn't accept are
+     * held, and written ahead of anything else by the next flush.
+     *
+     * @param pfLogWriter_ Function used to write the data (nullptr when
+     *        writing through a vectored writer)
+     * @param pu8Data_ Data to write (at most m_uMaxSystemRecord bytes, through
+     *        a vectored writer)
+     * @param uLength_ Number of bytes to write
+     * @return false if bytes were held back
+     */
+    bool Output(LogWrite_t pfLogWriter_, const uint8_t* pu8Data_, size_t uLength_);
+
+    /**
+     * @brief WriteUnsent
+     *
+     * Write the bytes of a record held back by a vectored writer (see Output()),
+     * ahead of any other data.  Called on the instance owning the writer.
+     *
+     * @return true if no bytes remain held back
+     */
+    bool WriteUnsent();
+
+    /**
+     * @brief EndOutput
+     *
+     * Write any flushed data held by the compressor, at the end of a flush.
+     *
+     * @param pfLogWriter_ Function used to write the data
+     */
+    void EndOutput(LogWrite_t pfLogWriter_);
+
+    /**
+     * @brief UpdateFlightHeader
+     *
+     * Record the committed and flushed extents of the ring in the flight
+     * recorder header (LOGBUF_NOINIT only).  Must be called from within a
+     * critical section.
+     */
+    void UpdateFlightHeader();
+
+    /**
+     * @brief NotifyFlush
+     *
+     * Invoke the notification callback, signalling that data should be flushed,
+     * or defer it if called from interrupt context.
+     */
+    void NotifyFlush();
+
+    static uint32_t KernelTimestamp();
+
+    /**
+     * @brief LimitRateWindow
+     *
+     * Slow path of LimitRate(): start a new interval if the current one has
+     * elapsed (or none has started), otherwise suppress the call.
+     *
+     * @param pstLimit_ State of the call site
+     * @param u32Ms_ Length of the interval, in milliseconds
+     * @return true if the call should be logged
+     */
+    static bool LimitRateWindow(LogLimit_t* pstLimit_, uint32_t u32Ms_);
+
+    /**
+     * @brief LogSiteArgs
+     *
+     * Encode a call site's record from its argument list (see LogSite()).
+     *
+     * @param pstSite_ Constant descriptor of the call site
+     * @param u32Suppressed_ Suppressed-call count to append (0 for none)
+     * @param args_ Argument values, of the types given by the site's tags
+     */
+    static void LogSiteArgs(const LogSite_t* pstSite_, uint32_t u32Suppressed_, va_list args_);
 
     /**
      * @brief Write
@@ -118,7 +1179,39 @@ private:
      *
      * @return Index to continue writing at
      */
-    int Write(int idx_, const void* data_, uint8_t length_);
+    int Write(int idx_, const void* data_, int length_);
+
+    /**
+     * @brief Put
+     *
+     * Write a fixed-size value to the log buffer, using a single store (or
+     * fixed-size copy) when it doesn't cross the end of the buffer.
+     *
+     * @param idx_ Index at which to write the value
+     * @param value_ Value to write
+     * @return Index to continue writing at
+     */
+    template <typename T>
+    int Put(int idx_, const T& value_)
+    {
+        if ((idx_ + (int)sizeof(T)) <= m_uBufferSize) {
+            memcpy(&m_buf[idx_], &value_, sizeof(T));
+            return idx_ + sizeof(T);
+        }
+        return Write(idx_, &value_, sizeof(T));
+    }
+
+    /**
+     * @brief WriteCrc
+     *
+     * Write the CRC of a record, computed over the record as written to the
+     * ring (LOGBUF_FRAMING only).
+     *
+     * @param start_ Index returned by BeginLog() for the record
+     * @param idx_ Index following the record's last argument
+     * @return Index to continue writing at
+     */
+    int WriteCrc(int start_, int idx_);
 
     /**
      * @brief EndWrite
@@ -134,13 +1227,104 @@ private:
     void EndWrite(int idx_);
 
     static constexpr auto m_uBufferSize = 512;
+    static constexpr size_t m_uMaxSystemRecord = sizeof(uint16_t) + sizeof(LogHeader_t) + metric_summary_max + (2 * sizeof(uint16_t));
     LogNotification_t m_pfNotificationHandler = nullptr;
     LogWrite_t m_pfLogWriter = nullptr;
+    LogWriteV_t m_pfVectorWriter = nullptr;
+    LogCompressor* m_pclCompressor = nullptr;
+    uint8_t m_au8Unsent[m_uMaxSystemRecord];    // Tail of a record written directly, held back by the vectored writer
+    size_t m_uUnsent = 0;
+    static LogTimestamp_t m_pfTimestamp;
+    static uint32_t m_u32TimestampHz;
+    static LogShardSelect_t m_pfShardSelect;
+    static LogInIsr_t m_pfInIsr;
+    static uint32_t m_u32TriggerFile;
+    static uint16_t m_u16TriggerLine;
+    static uint32_t m_u32MetricInterval;
+    static uint32_t m_u32MetricTimestamp;
+#if defined(LOGBUF_STATS)
+    static LogTimestamp_t m_pfStatsClock;
+    static uint32_t m_u32StatsClockHz;
+#endif
+#if defined(LOGBUF_SITE_FILTER)
+    static uint32_t m_au32SiteDisabled[(LOGBUF_MAX_SITES + 31) / 32];  // Zero (enabled) at startup
+#endif
+    uint32_t m_u32LastTimestamp = 0;
+    uint32_t m_u32TimestampHigh = 0;
+#if defined(LOGBUF_NOINIT)
+    LogFlightHeader_t m_stFlight;   // Must immediately precede the ring
+#endif
     uint8_t m_buf[m_uBufferSize];
     int m_iWriteIdx = 0;
     int m_iReadIdx = 0;
     int m_iLastReadIdx = 0;
+    uint16_t m_u16Sequence = 0;
+    uint16_t m_u16HighWatermark = m_uBufferSize / 2;
+    uint16_t m_u16LowWatermark = m_uBufferSize / 4;
+    uint16_t m_u16RecordTrigger = 0;
+    uint16_t m_u16Records = 0;
+    uint32_t m_u32NotifyInterval = 0;
+    uint32_t m_u32LastNotify = 0;
+    bool m_bNotifyArmed = true;
+    bool m_bOverrunArmed = true;
+    bool m_bNotifyDeferred = false;
     bool m_bDoNotify = false;
     bool m_bPending = false;
+    bool m_bSingleProducer = false;
+    bool m_bPostMortem = false;
+    bool m_bPostMortemOpen = false;         // The marker opening the recovered records has been written
+    int m_iPostMortemEnd = 0;
+    bool m_bSnapshot = false;
+    bool m_bSnapshotWrapped = false;
+    bool m_bTriggered = false;
+    bool m_bFrozen = false;
+    uint16_t m_u16PostTrigger = 0;
+    uint16_t m_u16PostRemaining = 0;
+    uint32_t m_u32TriggerTimestamp = 0;
+    int m_iTriggerIdx = 0;
+    int m_iTriggerFill = 0;
+    bool m_bCoalesce = false;
+    uint32_t m_u32Repeats = 0;              // Duplicates of the last record not yet reported
+    uint32_t m_u32RepeatTimestamp = 0;      // Timestamp of the last of them
+    int m_iLastRecord = -1;                 // Index of the record they duplicate, or -1 if none
+    int m_iLastLength = 0;
+    int m_iReserveStart = 0;                // Index of the last reservation, including any repeat record
+    int m_iReserveRecord = 0;               // Index of the record within it
+    uint32_t m_u32ReserveRepeats = 0;       // Duplicates reported by its repeat record
+    uint32_t m_u32ReserveTimestamp = 0;
+    uint16_t m_u16ReserveSequence = 0;
+    uint32_t m_u32HeldRepeats = 0;          // Duplicates of a record left in the ring by a partial flush
+    uint32_t m_u32HeldTimestamp = 0;
+    int m_iHeldIdx = 0;                     // Index of the end of the record they duplicate
+    bool m_bRetained = false;               // The tail of a partly written record is still in the ring
     int m_iCount = 0;
+#if defined(LOGBUF_STATS)
+    LogStats_t m_stStats = {};
+    uint32_t m_u32StatsPending = 0;         // Records committed, but not yet published to the flushing context
+    uint32_t m_u32StatsInterval = 0;
+    uint32_t m_u32StatsTimestamp = 0;
+#endif
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogTraceScope class
+ *
+ * Writes a scope begin record when constructed, and the matching end record
+ * when destroyed, bracketing the lifetime of the enclosing block (see
+ * TRACE_SCOPE()).
+ */
+class LogTraceScope {
+public:
+    explicit LogTraceScope(uint32_t u32Scope_) : m_u32Scope{u32Scope_}
+    {
+        LogBuf::LogScope(LogSystemRecord::ScopeBegin, m_u32Scope);
+    }
+    ~LogTraceScope() { LogBuf::LogScope(LogSystemRecord::ScopeEnd, m_u32Scope); }
+
+    LogTraceScope(const LogTraceScope&) = delete;
+    LogTraceScope& operator=(const LogTraceScope&) = delete;
+
+private:
+    uint32_t m_u32Scope;
 };
@@ -0,0 +1,72 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logcommand.h Reader for site filter commands sent by the host
+ */
+#pragma once
+
+#include "logbuf.h"
+#include "logtypes.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(LOGBUF_SITE_FILTER)
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogCommandReader class
+ *
+ * Parses the site filter commands written by host tools (see LogCommand and
+ * "logtool sites") from the target's receive path (i.e. a UART, or the debug
+ * probe's channel back to the target), and applies them to the site enable
+ * bitmap.  Bytes may be presented in pieces of any size; bytes outside of a
+ * valid frame are discarded, as are frames with a bad CRC.  Each command that
+ * is executed is acknowledged with a LogSystemRecord::SiteFilter record.
+ *
+ * The reader isn't threadsafe: bytes must be presented from a single context
+ * (i.e. a receive thread, rather than the receive interrupt).
+ */
+class LogCommandReader {
+public:
+    /**
+     * @brief Receive
+     *
+     * Parse received bytes, executing each command completed by them.
+     *
+     * @param pu8Data_ Received bytes
+     * @param uLength_ Number of bytes received
+     */
+    void Receive(const uint8_t* pu8Data_, size_t uLength_);
+
+    /**
+     * @brief GetRejected
+     * @return Number of frames discarded because of a bad CRC or count
+     */
+    uint32_t GetRejected() const { return m_u32Rejected; }
+
+private:
+    /**
+     * @brief Execute
+     *
+     * Apply the complete, validated frame in the buffer.
+     */
+    void Execute();
+
+    static constexpr size_t m_uMaxFrame = sizeof(LogCommandHeader_t) + (command_max_sites * sizeof(uint16_t)) + sizeof(uint16_t);
+
+    uint8_t m_au8Frame[m_uMaxFrame];
+    size_t m_uLength = 0;       // Bytes of the current frame received
+    uint32_t m_u32Rejected = 0;
+};
+#endif
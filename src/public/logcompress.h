@@ -0,0 +1,183 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logcompress.h Fixed-memory streaming compressor for flushed log data
+ */
+#pragma once
+
+#include "logbuf.h"
+#include "logtypes.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+//---------------------------------------------------------------------------
+// Size of the compressor's window (as a power of two), and of the field used
+// to encode match lengths.  The compressor uses 2 * (1 << window bits) bytes
+// of buffer space, and encodes matches in (1 + window bits + length bits) bits.
+// Window bits must be between 4 and 15, and length bits between 1 and 8.
+#if !defined(LOGCOMPRESS_WINDOW_BITS)
+#define LOGCOMPRESS_WINDOW_BITS (8)
+#endif
+#if !defined(LOGCOMPRESS_LENGTH_BITS)
+#define LOGCOMPRESS_LENGTH_BITS (4)
+#endif
+
+//---------------------------------------------------------------------------
+// Maximum size of a compressed block's bitstream, in bytes.  Each block is
+// written with a single call to the log writer.
+#if !defined(LOGCOMPRESS_BLOCK_SIZE)
+#define LOGCOMPRESS_BLOCK_SIZE (128)
+#endif
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogCompressor class
+ *
+ * LZSS compressor placed between LogBuf::FlushData() and the log writer (see
+ * LogBuf::SetLogWriter()), reducing the bandwidth required of the debug link.
+ * Data is written as a series of blocks (see LogCompressedHeader_t), with each
+ * flush ending a block, so the host receives everything flushed without
+ * waiting for more data to follow.
+ *
+ * All state is held within the object: no memory is allocated.  Matches are
+ * found using a single probe of a hash table of recent positions, so the work
+ * done per byte is bounded (a hash, and at most a match's length of byte
+ * comparisons), and the cost of a flush is linear in the number of bytes
+ * flushed -- which is itself bounded by the size of the ring.
+ *
+ * Every few blocks, a keyframe block resets the compression window, so a
+ * host attaching to a running target (or recovering from a dropped block) can
+ * resume decoding from the next keyframe.
+ *
+ * The compressor isn't threadsafe: it must only be used from the context(s)
+ * that flush log data, as with the log writer itself.
+ */
+class LogCompressor {
+public:
+    /**
+     * @brief SetKeyframeInterval
+     *
+     * Set the number of blocks between keyframes.  Shorter intervals let the
+     * host resynchronize sooner, at some cost in compression ratio.
+     *
+     * @param u8Blocks_ Blocks between keyframes (1 for every block to be a
+     *        keyframe, 0 for the first block only)
+     */
+    void SetKeyframeInterval(uint8_t u8Blocks_) { m_u8KeyframeInterval = u8Blocks_; }
+
+    /**
+     * @brief Reset
+     *
+     * Discard any data not yet written, and make the next block a keyframe.
+     */
+    void Reset();
+
+    /**
+     * @brief Write
+     *
+     * Compress data, writing each block as it's filled.  Data at the end of
+     * the input may be held until more data is written, or the compressor is
+     * flushed.
+     *
+     * @param pfLogWriter_ Function used to write compressed blocks
+     * @param pu8Data_ Data to compress
+     * @param uLength_ Number of bytes to compress
+     */
+    void Write(LogWrite_t pfLogWriter_, const uint8_t* pu8Data_, size_t uLength_);
+
+    /**
+     * @brief Flush
+     *
+     * Compress all data written so far, and write the block holding it.
+     *
+     * @param pfLogWriter_ Function used to write compressed blocks
+     */
+    void Flush(LogWrite_t pfLogWriter_);
+
+private:
+    /**
+     * @brief Compress
+     *
+     * Encode the buffered input, ending blocks as they're filled.
+     *
+     * @param pfLogWriter_ Function used to write compressed blocks
+     * @param bFinal_ true to encode all of the input, false to hold back enough
+     *        of it to find the longest possible match from the last position
+     */
+    void Compress(LogWrite_t pfLogWriter_, bool bFinal_);
+
+    /**
+     * @brief BeginBlock
+     *
+     * Start a new block, resetting the window first if it's a keyframe.
+     */
+    void BeginBlock();
+
+    /**
+     * @brief EndBlock
+     *
+     * Pad the bitstream to a whole byte, and write the block.
+     *
+     * @param pfLogWriter_ Function used to write the block
+     */
+    void EndBlock(LogWrite_t pfLogWriter_);
+
+    /**
+     * @brief PutBits
+     * @param u32Bits_ Bits to append to the block, right-aligned
+     * @param iCount_ Number of bits to append
+     */
+    void PutBits(uint32_t u32Bits_, int iCount_);
+
+    /**
+     * @brief Slide
+     *
+     * Move the window and unencoded input to the start of the buffer, making
+     * room for more input.
+     */
+    void Slide();
+
+    static uint8_t Hash(const uint8_t* pu8Data_)
+    {
+        return (uint8_t)((((uint32_t)pu8Data_[0] << 16) | ((uint32_t)pu8Data_[1] << 8) | pu8Data_[2]) * 2654435761u >> 24);
+    }
+
+    static constexpr int m_iWindowBits = LOGCOMPRESS_WINDOW_BITS;
+    static constexpr int m_iLengthBits = LOGCOMPRESS_LENGTH_BITS;
+    static constexpr int m_iWindowSize = 1 << m_iWindowBits;
+    static constexpr int m_iMaxMatch = compressed_min_match + (1 << m_iLengthBits) - 1;
+    static constexpr int m_iMatchBits = 1 + m_iWindowBits + m_iLengthBits;
+    static constexpr int m_iMaxTokenBytes = (7 + m_iMatchBits + 7) / 8;   // Including bits pending from the last token
+    static constexpr int m_iBlockSize = LOGCOMPRESS_BLOCK_SIZE;
+
+    // The window (data already encoded) is followed by the input still to be
+    // encoded; positions are indexes into this buffer.
+    uint8_t m_au8Buf[2 * m_iWindowSize] = {};
+    uint16_t m_au16Hash[256] = {};          // Last position (offset by m_u16Base) of each hash
+    uint8_t m_au8Block[sizeof(LogCompressedHeader_t) + m_iBlockSize];
+    int m_iPos = m_iWindowSize;             // Next byte to encode
+    int m_iEnd = m_iWindowSize;             // End of the input
+    uint16_t m_u16Base = 0;                 // Stream position of the start of the buffer (modulo 2^16)
+    uint32_t m_u32Bits = 0;
+    int m_iBits = 0;                        // Number of bits in m_u32Bits not yet written to the block
+    int m_iBlockLength = 0;
+    uint16_t m_u16RawLength = 0;
+    uint8_t m_u8Sequence = 0;
+    uint8_t m_u8Flags = 0;
+    uint8_t m_u8KeyframeInterval = 16;
+    uint8_t m_u8Blocks = 0;                 // Blocks since the last keyframe
+    bool m_bOpen = false;
+    bool m_bKeyframe = true;
+};
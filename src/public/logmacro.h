@@ -71,19 +71,113 @@ See license.txt for more information
 
  @endcode
 
+ Strings can be logged in two ways.  TagString logs only a pointer to a constant
+ string (i.e. a literal), which is read back out of the .elf file by host tools
+ when decoding.  TagStrcopy copies up to strcopy_max_length characters from a
+ string built at runtime into the log.
+
+ @code
+
+    DEBUG_LOG("state %s -> %s\n", TagString, StateName(old), TagStrcopy, szBuffer);
+
+ @endcode
+
+ Blocks of binary data (i.e. packets or register blocks) are logged as a single
+ TagBlob argument, copying up to blob_max_length bytes into the log.  Host tools
+ render blobs as hex, or as a struct whose layout is declared in the format
+ string in place of a conversion specifier.
+
+ @code
+
+    DEBUG_LOG("rx %x\n", TagBlob, LogBlob_t(pu8Packet, u16Length));
+    DEBUG_LOG("regs %{ctrl:x32,status:x32,count:u16}\n", TagBlob, LogBlob_t(&stRegs, sizeof(stRegs)));
+
+ @endcode
+
+ Noisy sites (i.e. in a hot loop, or an error path that can repeat) can log
+ only their first call, every nth call, or at most a given number of calls per
+ interval.  A suppressed call costs a compare against the site's static state,
+ and records from sampled and rate-limited sites report how many calls were
+ suppressed since the site's previous record.
+
+ @code
+
+    DEBUG_LOG_ONCE("init %d\n", TagInt32, iResult);
+    DEBUG_LOG_EVERY_N(100, "rx %d bytes\n", TagUint16, u16Length);
+    DEBUG_LOG_RATE(5, 1000, "crc error on %d\n", TagUint8, u8Channel);
+
+ @endcode
+
+ Counters, gauges and histograms are updated in place, without writing a
+ record per event, and summarized once per interval (see LogBuf::SetMetricInterval()).
+
+ @code
+
+    LOG_COUNTER(clRxPackets, "rx-packets");
+    LOG_GAUGE(clQueueDepth, "queue-depth");
+    LOG_HISTOGRAM(clRxLength, "rx-length", 16, 64, 256, 1024);
+
+    clRxPackets.Add();
+    clQueueDepth.Set(iDepth);
+    clRxLength.Record(u16Length);
+
+ @endcode
+
+ With LOGBUF_SITE_FILTER defined, each DEBUG_LOG() site can be enabled or
+ disabled at runtime, by the host (see LogCommandReader and "logtool sites"),
+ without rebuilding the target.  A disabled site costs a single bit test.
+
+ The time spent within a block (or between two points) can be traced with
+ compact begin/end records holding only a scope id.  Host tools pair them to
+ build a histogram of each scope's durations, and show them as slices in trace
+ exports.
+
+ @code
+
+    void Dispatch()
+    {
+        TRACE_SCOPE("dispatch");
+        ...
+    }
+
+    TRACE_BEGIN("rx-frame");
+    ...
+    TRACE_END("rx-frame");
+
+ @endcode
+
  */
 #pragma once
 
 #include "mark3.h"
 #include "logbuf.h"
+#include "logmetric.h"
 #include "fnv_hash32.h"
 
 //---------------------------------------------------------------------------
 // Macro to generate a hash for a given source file.  Note:  This implementation
-// applies to C++11 and onward.
-#define HASH(string) hash_32_fnv1a_const( # string )
+// applies to C++11 and onward.  The two-level expansion ensures the hash is
+// generated from the value of __FILENAME__, rather than its name.
+#define HASH_I(string) hash_32_fnv1a_const( # string )
+#define HASH(string) HASH_I(string)
 #define FILE_HASH   HASH(__FILENAME__)
 
+//---------------------------------------------------------------------------
+// Build a complete .logger section record (see LogSectionRecord_t) for the
+// given record type, line, and string.
+#define LOG_SECTION_RECORD(type, line, str)                                                             \
+    {                                                                                                   \
+        {                                                                                               \
+            logger_section_magic,                                                                       \
+            logger_section_version,                                                                     \
+            (uint8_t)(type),                                                                            \
+            (uint16_t)sizeof(LogSectionRecord_t<sizeof(str)>),                                          \
+            (uint16_t)(line),                                                                           \
+            FILE_HASH                                                                                   \
+        },                                                                                              \
+        str                                                                                             \
+    }
+
 //---------------------------------------------------------------------------
 // ELF-file magic:  Emit the user's printf-style format string and file ID/line into
 // a special elf section named ".logger".  The resulting output isn't part of the
@@ -92,26 +186,22 @@ See license.txt for more information
 // with post-processing.  This allows the application to perform optimized,
 // fixed-time logging operations (i.e. avoids runtime parsing of format strings)
 // as part of the DEBUG_LOG() macros.
-#define EMIT_DBG_STRING(str)                                                                                             \
-    do {                                                                                                                 \
-        const static volatile uint16_t __sync_begin __attribute__((section(".logger"))) __attribute__((used)) = 0xCAFE;   \
-        const static volatile char     __log_str[] __attribute__((section(".logger"))) __attribute__((used))  = str;      \
-        const static volatile uint16_t __line_id __attribute__((section(".logger"))) __attribute__((used))    = __LINE__; \
-        const static volatile uint32_t __file_id __attribute__((section(".logger"))) __attribute__((used))    = FILE_HASH;  \
-        const static volatile uint16_t __sync_end __attribute__((section(".logger"))) __attribute__((used)) = 0xD00D;   \
+#define EMIT_DBG_STRING(str)                                                                                \
+    do {                                                                                                    \
+        const static LogSectionRecord_t<sizeof(str)> __log_site                                             \
+            __attribute__((section(".logger"), aligned(4))) __attribute__((used))                           \
+            = LOG_SECTION_RECORD(LogSectionType::Site, __LINE__, str);                                      \
     } while (0);
 
 //---------------------------------------------------------------------------
 // More ELF-file magic: This code creates file-level debug information in the
-// ".logger" elf file section.  A series of variable declarations are made
-// that result in the filename and its unique hash being emitted, which can 
-// be used to build a lookup table that maps a file to its hash, which is used
-// to identify log components in post-processing.
-#define EMIT_DBG_HEADER() \
-        const static volatile uint16_t __file_sync_start __attribute__((section(".logger"))) __attribute__((used)) = 0xACDC;   \
-        const static volatile uint32_t __file_id __attribute__((section(".logger"))) __attribute__((used))   = FILE_HASH;  \
-        const static volatile char     __file_name[] __attribute__((section(".logger"))) __attribute__((used))   = __FILE__;      \
-        const static volatile uint16_t __file_sync_end __attribute__((section(".logger"))) __attribute__((used)) = 0xABBA;   \
+// ".logger" elf file section.  A record is emitted containing the filename and
+// its unique hash, which can be used to build a lookup table that maps a file to
+// its hash, which is used to identify log components in post-processing.
+#define EMIT_DBG_HEADER()                                                                                   \
+        const static LogSectionRecord_t<sizeof(__FILE__)> __file_record                                     \
+            __attribute__((section(".logger"), aligned(4))) __attribute__((used))                           \
+            = LOG_SECTION_RECORD(LogSectionType::File, 0, __FILE__);
 
 //---------------------------------------------------------------------------
 // Preprocessor magic: This code creates a symbol name composed of "serialize_"
@@ -131,133 +221,247 @@ See license.txt for more information
 #define VALUE_I(a) v_##a
 #define VALUE(a) VALUE_I(a)
 
+//---------------------------------------------------------------------------
+// Type of the value logged for a given tag
+#define ARG_TYPE(a) decltype(LogVariant_t::VALUE(a))
+
+//---------------------------------------------------------------------------
+// Tag/length byte written ahead of the value logged for a given tag
+#define TLV_I(a) tlv_byte(LogTag::Log##a, SizeTag::Log##a)
+#define TLV(a) TLV_I(a)
+
+//---------------------------------------------------------------------------
+// Build a constant call-site descriptor (see LogSite_t) from the site's
+// argument count, fixed record length, and argument tag/length bytes.
+#define LOG_SITE(count, length, ...)                                                                        \
+    {                                                                                                       \
+        FILE_HASH,                                                                                          \
+        (uint16_t)__LINE__,                                                                                 \
+        (uint8_t)(count),                                                                                   \
+        (uint8_t)(length),                                                                                  \
+        { __VA_ARGS__ }                                                                                     \
+    }
+
 //---------------------------------------------------------------------------
 // Logging macros -- when a user calls DEBUG_LOG(), one of the following macros
 // will be substituted, based on the number of arguments in the list.
-#define _DEBUG_LOG5(s, fmt1, a1, fmt2, a2, fmt3, a3, fmt4, a4, fmt5, a5) \
+//
+// By default, each call site stores a constant descriptor in flash, and calls
+// the shared encoder (LogBuf::LogSite()) with the descriptor and argument
+// values, minimizing the code emitted at each site.  Defining LOGBUF_INLINE_SITES instead expands the
+// encoding at each site (faster, at the expense of code size): each argument
+// is evaluated once, into a local of the tag's type, and the record is then
+// serialized directly into the log buffer.
+#if defined(LOGBUF_INLINE_SITES)
+#define _DEBUG_LOG5(lim, s, fmt1, a1, fmt2, a2, fmt3, a3, fmt4, a4, fmt5, a5) \
 do { \
-	EMIT_DBG_STRING(s); \
-    Tlv_t data[5] = { \
-        {.tag = (unsigned int)TAG(fmt1), .length = SIZE(fmt1), .value = {.VALUE(fmt1) = a1}}, \
-        {.tag = (unsigned int)TAG(fmt2), .length = SIZE(fmt2), .value = {.VALUE(fmt2) = a2}}, \
-        {.tag = (unsigned int)TAG(fmt3), .length = SIZE(fmt3), .value = {.VALUE(fmt3) = a3}}, \
-        {.tag = (unsigned int)TAG(fmt4), .length = SIZE(fmt4), .value = {.VALUE(fmt4) = a4}}, \
-        {.tag = (unsigned int)TAG(fmt5), .length = SIZE(fmt5), .value = {.VALUE(fmt5) = a5}}, \
-    }; \
-    LogHeader_t header = { \
-        .file_id = FILE_HASH, \
-        .timestamp = Kernel::GetTicks(), \
-        .line = __LINE__, \
-        .log_count = 5, \
-    }; \
-    int length = sizeof(header) \
+    EMIT_DBG_STRING(s); \
+    const ARG_TYPE(fmt1) __log_v1 = a1; \
+    const ARG_TYPE(fmt2) __log_v2 = a2; \
+    const ARG_TYPE(fmt3) __log_v3 = a3; \
+    const ARG_TYPE(fmt4) __log_v4 = a4; \
+    const ARG_TYPE(fmt5) __log_v5 = a5; \
+    auto __log_suppressed = LogBuf::TakeSuppressed(lim); \
+    int length = sizeof(LogHeader_t) \
                 + (sizeof(uint8_t) * 5) \
-                + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3) + SIZE(fmt4) + SIZE(fmt5); \
-    auto &logBuf = LogBuf::Instance(); \
-    logBuf.WriteLog(length, &header, data); \
-} while (0); 
+                + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3) + SIZE(fmt4) + SIZE(fmt5) \
+                + LogBuf::ArgLength(__log_v1) + LogBuf::ArgLength(__log_v2) \
+                + LogBuf::ArgLength(__log_v3) + LogBuf::ArgLength(__log_v4) + LogBuf::ArgLength(__log_v5) \
+                + LogBuf::SuppressedLength(__log_suppressed); \
+    auto &logBuf = LogBuf::Current(); \
+    auto __log_start = logBuf.BeginLog(length, FILE_HASH, __LINE__, 5 + LogBuf::SuppressedFlag(__log_suppressed), LogBuf::GetTimestamp()); \
+    if (__log_start < 0) { break; } \
+    auto idx = __log_start; \
+    idx = logBuf.WriteArg(idx, TLV(fmt1), __log_v1); \
+    idx = logBuf.WriteArg(idx, TLV(fmt2), __log_v2); \
+    idx = logBuf.WriteArg(idx, TLV(fmt3), __log_v3); \
+    idx = logBuf.WriteArg(idx, TLV(fmt4), __log_v4); \
+    idx = logBuf.WriteArg(idx, TLV(fmt5), __log_v5); \
+    idx = logBuf.WriteSuppressed(idx, __log_suppressed); \
+    logBuf.EndLog(__log_start, idx); \
+} while (0);
 
 //---------------------------------------------------------------------------
-#define _DEBUG_LOG4(s, fmt1, a1, fmt2, a2, fmt3, a3, fmt4, a4) \
+#define _DEBUG_LOG4(lim, s, fmt1, a1, fmt2, a2, fmt3, a3, fmt4, a4) \
 do { \
     EMIT_DBG_STRING(s); \
-    Tlv_t data[4] = { \
-        {.tag = (unsigned int)TAG(fmt1), .length = SIZE(fmt1), .value = {.VALUE(fmt1) = a1}}, \
-        {.tag = (unsigned int)TAG(fmt2), .length = SIZE(fmt2), .value = {.VALUE(fmt2) = a2}}, \
-        {.tag = (unsigned int)TAG(fmt3), .length = SIZE(fmt3), .value = {.VALUE(fmt3) = a3}}, \
-        {.tag = (unsigned int)TAG(fmt4), .length = SIZE(fmt4), .value = {.VALUE(fmt4) = a4}}, \
-    }; \
-    LogHeader_t header = { \
-        .file_id = FILE_HASH, \
-        .timestamp = Kernel::GetTicks(), \
-        .line = __LINE__, \
-        .log_count = 4, \
-    }; \
-    int length = sizeof(header) \
+    const ARG_TYPE(fmt1) __log_v1 = a1; \
+    const ARG_TYPE(fmt2) __log_v2 = a2; \
+    const ARG_TYPE(fmt3) __log_v3 = a3; \
+    const ARG_TYPE(fmt4) __log_v4 = a4; \
+    auto __log_suppressed = LogBuf::TakeSuppressed(lim); \
+    int length = sizeof(LogHeader_t) \
                 + (sizeof(uint8_t) * 4) \
-                + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3) + SIZE(fmt4); \
-    auto &logBuf = LogBuf::Instance(); \
-    logBuf.WriteLog(length, &header, data); \
+                + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3) + SIZE(fmt4) \
+                + LogBuf::ArgLength(__log_v1) + LogBuf::ArgLength(__log_v2) \
+                + LogBuf::ArgLength(__log_v3) + LogBuf::ArgLength(__log_v4) \
+                + LogBuf::SuppressedLength(__log_suppressed); \
+    auto &logBuf = LogBuf::Current(); \
+    auto __log_start = logBuf.BeginLog(length, FILE_HASH, __LINE__, 4 + LogBuf::SuppressedFlag(__log_suppressed), LogBuf::GetTimestamp()); \
+    if (__log_start < 0) { break; } \
+    auto idx = __log_start; \
+    idx = logBuf.WriteArg(idx, TLV(fmt1), __log_v1); \
+    idx = logBuf.WriteArg(idx, TLV(fmt2), __log_v2); \
+    idx = logBuf.WriteArg(idx, TLV(fmt3), __log_v3); \
+    idx = logBuf.WriteArg(idx, TLV(fmt4), __log_v4); \
+    idx = logBuf.WriteSuppressed(idx, __log_suppressed); \
+    logBuf.EndLog(__log_start, idx); \
 } while (0);
 
 //---------------------------------------------------------------------------
-#define _DEBUG_LOG3(s, fmt1, a1, fmt2, a2, fmt3, a3) \
+#define _DEBUG_LOG3(lim, s, fmt1, a1, fmt2, a2, fmt3, a3) \
 do { \
     EMIT_DBG_STRING(s); \
-    Tlv_t data[3] = { \
-        {.tag = (unsigned int)TAG(fmt1), .length = SIZE(fmt1), .value = {.VALUE(fmt1) = a1}}, \
-        {.tag = (unsigned int)TAG(fmt2), .length = SIZE(fmt2), .value = {.VALUE(fmt2) = a2}}, \
-        {.tag = (unsigned int)TAG(fmt3), .length = SIZE(fmt3), .value = {.VALUE(fmt3) = a3}}, \
-    }; \
-    LogHeader_t header = { \
-        .file_id = FILE_HASH, \
-        .timestamp = Kernel::GetTicks(), \
-        .line = __LINE__, \
-        .log_count = 3, \
-    }; \
-    int length = sizeof(header) \
+    const ARG_TYPE(fmt1) __log_v1 = a1; \
+    const ARG_TYPE(fmt2) __log_v2 = a2; \
+    const ARG_TYPE(fmt3) __log_v3 = a3; \
+    auto __log_suppressed = LogBuf::TakeSuppressed(lim); \
+    int length = sizeof(LogHeader_t) \
                 + (sizeof(uint8_t) * 3) \
-                + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3); \
-    auto &logBuf = LogBuf::Instance(); \
-    logBuf.WriteLog(length, &header, data); \
-} while(0);
+                + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3) \
+                + LogBuf::ArgLength(__log_v1) + LogBuf::ArgLength(__log_v2) + LogBuf::ArgLength(__log_v3) \
+                + LogBuf::SuppressedLength(__log_suppressed); \
+    auto &logBuf = LogBuf::Current(); \
+    auto __log_start = logBuf.BeginLog(length, FILE_HASH, __LINE__, 3 + LogBuf::SuppressedFlag(__log_suppressed), LogBuf::GetTimestamp()); \
+    if (__log_start < 0) { break; } \
+    auto idx = __log_start; \
+    idx = logBuf.WriteArg(idx, TLV(fmt1), __log_v1); \
+    idx = logBuf.WriteArg(idx, TLV(fmt2), __log_v2); \
+    idx = logBuf.WriteArg(idx, TLV(fmt3), __log_v3); \
+    idx = logBuf.WriteSuppressed(idx, __log_suppressed); \
+    logBuf.EndLog(__log_start, idx); \
+} while (0);
 
 //---------------------------------------------------------------------------
-#define _DEBUG_LOG2(s, fmt1, a1, fmt2, a2) \
+#define _DEBUG_LOG2(lim, s, fmt1, a1, fmt2, a2) \
 do { \
     EMIT_DBG_STRING(s); \
-    Tlv_t data[2] = { \
-        {.tag = (unsigned int)TAG(fmt1), .length = SIZE(fmt1), .value = {.VALUE(fmt1) = a1}}, \
-        {.tag = (unsigned int)TAG(fmt2), .length = SIZE(fmt2), .value = {.VALUE(fmt2) = a2}}, \
-    }; \
-    LogHeader_t header = { \
-        .file_id = FILE_HASH, \
-        .timestamp = Kernel::GetTicks(), \
-        .line = __LINE__, \
-        .log_count = 2, \
-    }; \
-    int length = sizeof(header) \
+    const ARG_TYPE(fmt1) __log_v1 = a1; \
+    const ARG_TYPE(fmt2) __log_v2 = a2; \
+    auto __log_suppressed = LogBuf::TakeSuppressed(lim); \
+    int length = sizeof(LogHeader_t) \
                 + (sizeof(uint8_t) * 2) \
-                + SIZE(fmt1) + SIZE(fmt2); \
-    auto &logBuf = LogBuf::Instance(); \
-    logBuf.WriteLog(length, &header, data); \
+                + SIZE(fmt1) + SIZE(fmt2) \
+                + LogBuf::ArgLength(__log_v1) + LogBuf::ArgLength(__log_v2) \
+                + LogBuf::SuppressedLength(__log_suppressed); \
+    auto &logBuf = LogBuf::Current(); \
+    auto __log_start = logBuf.BeginLog(length, FILE_HASH, __LINE__, 2 + LogBuf::SuppressedFlag(__log_suppressed), LogBuf::GetTimestamp()); \
+    if (__log_start < 0) { break; } \
+    auto idx = __log_start; \
+    idx = logBuf.WriteArg(idx, TLV(fmt1), __log_v1); \
+    idx = logBuf.WriteArg(idx, TLV(fmt2), __log_v2); \
+    idx = logBuf.WriteSuppressed(idx, __log_suppressed); \
+    logBuf.EndLog(__log_start, idx); \
 } while (0);
 
 //---------------------------------------------------------------------------
-#define _DEBUG_LOG1(s, fmt1, a1) \
+#define _DEBUG_LOG1(lim, s, fmt1, a1) \
 do { \
     EMIT_DBG_STRING(s); \
-    Tlv_t data[1] = { \
-        {.tag = (unsigned int)TAG(fmt1), .length = SIZE(fmt1), .value = {.VALUE(fmt1) = a1}}, \
-    }; \
-    LogHeader_t header = { \
-        .file_id = FILE_HASH, \
-        .timestamp = Kernel::GetTicks(), \
-        .line = __LINE__, \
-        .log_count = 1, \
-    }; \
-    int length = sizeof(header) \
+    const ARG_TYPE(fmt1) __log_v1 = a1; \
+    auto __log_suppressed = LogBuf::TakeSuppressed(lim); \
+    int length = sizeof(LogHeader_t) \
                 + sizeof(uint8_t) \
-                + SIZE(fmt1); \
-    auto &logBuf = LogBuf::Instance(); \
-    logBuf.WriteLog(length, &header, data); \
+                + SIZE(fmt1) \
+                + LogBuf::ArgLength(__log_v1) \
+                + LogBuf::SuppressedLength(__log_suppressed); \
+    auto &logBuf = LogBuf::Current(); \
+    auto __log_start = logBuf.BeginLog(length, FILE_HASH, __LINE__, 1 + LogBuf::SuppressedFlag(__log_suppressed), LogBuf::GetTimestamp()); \
+    if (__log_start < 0) { break; } \
+    auto idx = __log_start; \
+    idx = logBuf.WriteArg(idx, TLV(fmt1), __log_v1); \
+    idx = logBuf.WriteSuppressed(idx, __log_suppressed); \
+    logBuf.EndLog(__log_start, idx); \
 } while (0);
 
 //---------------------------------------------------------------------------
-#define _DEBUG_LOG0(s) \
+#define _DEBUG_LOG0(lim, s) \
+do { \
+    EMIT_DBG_STRING(s); \
+    auto __log_suppressed = LogBuf::TakeSuppressed(lim); \
+    int length = sizeof(LogHeader_t) + LogBuf::SuppressedLength(__log_suppressed); \
+    auto &logBuf = LogBuf::Current(); \
+    auto __log_start = logBuf.BeginLog(length, FILE_HASH, __LINE__, 0 + LogBuf::SuppressedFlag(__log_suppressed), LogBuf::GetTimestamp()); \
+    if (__log_start < 0) { break; } \
+    auto idx = __log_start; \
+    idx = logBuf.WriteSuppressed(idx, __log_suppressed); \
+    logBuf.EndLog(__log_start, idx); \
+} while (0);
+
+#else
+#define _DEBUG_LOG5(lim, s, fmt1, a1, fmt2, a2, fmt3, a3, fmt4, a4, fmt5, a5) \
 do { \
     EMIT_DBG_STRING(s); \
-    LogHeader_t header = { \
-        .file_id = FILE_HASH, \
-        .timestamp = Kernel::GetTicks(), \
-        .line = __LINE__, \
-        .log_count = 0, \
-    }; \
-    int length = sizeof(header); \
-    auto &logBuf = LogBuf::Instance(); \
-    logBuf.WriteLog(length, &header, nullptr); \
+    static constexpr LogSite_t __log_desc = LOG_SITE(5, \
+        sizeof(LogHeader_t) + (sizeof(uint8_t) * 5) + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3) + SIZE(fmt4) + SIZE(fmt5), \
+        TLV(fmt1), TLV(fmt2), TLV(fmt3), TLV(fmt4), TLV(fmt5)); \
+    LogBuf::LogSite(lim, &__log_desc, \
+                    static_cast<ARG_TYPE(fmt1)>(a1), \
+                    static_cast<ARG_TYPE(fmt2)>(a2), \
+                    static_cast<ARG_TYPE(fmt3)>(a3), \
+                    static_cast<ARG_TYPE(fmt4)>(a4), \
+                    static_cast<ARG_TYPE(fmt5)>(a5)); \
 } while (0);
 
+//---------------------------------------------------------------------------
+#define _DEBUG_LOG4(lim, s, fmt1, a1, fmt2, a2, fmt3, a3, fmt4, a4) \
+do { \
+    EMIT_DBG_STRING(s); \
+    static constexpr LogSite_t __log_desc = LOG_SITE(4, \
+        sizeof(LogHeader_t) + (sizeof(uint8_t) * 4) + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3) + SIZE(fmt4), \
+        TLV(fmt1), TLV(fmt2), TLV(fmt3), TLV(fmt4)); \
+    LogBuf::LogSite(lim, &__log_desc, \
+                    static_cast<ARG_TYPE(fmt1)>(a1), \
+                    static_cast<ARG_TYPE(fmt2)>(a2), \
+                    static_cast<ARG_TYPE(fmt3)>(a3), \
+                    static_cast<ARG_TYPE(fmt4)>(a4)); \
+} while (0);
+
+//---------------------------------------------------------------------------
+#define _DEBUG_LOG3(lim, s, fmt1, a1, fmt2, a2, fmt3, a3) \
+do { \
+    EMIT_DBG_STRING(s); \
+    static constexpr LogSite_t __log_desc = LOG_SITE(3, \
+        sizeof(LogHeader_t) + (sizeof(uint8_t) * 3) + SIZE(fmt1) + SIZE(fmt2) + SIZE(fmt3), \
+        TLV(fmt1), TLV(fmt2), TLV(fmt3)); \
+    LogBuf::LogSite(lim, &__log_desc, \
+                    static_cast<ARG_TYPE(fmt1)>(a1), \
+                    static_cast<ARG_TYPE(fmt2)>(a2), \
+                    static_cast<ARG_TYPE(fmt3)>(a3)); \
+} while (0);
+
+//---------------------------------------------------------------------------
+#define _DEBUG_LOG2(lim, s, fmt1, a1, fmt2, a2) \
+do { \
+    EMIT_DBG_STRING(s); \
+    static constexpr LogSite_t __log_desc = LOG_SITE(2, \
+        sizeof(LogHeader_t) + (sizeof(uint8_t) * 2) + SIZE(fmt1) + SIZE(fmt2), \
+        TLV(fmt1), TLV(fmt2)); \
+    LogBuf::LogSite(lim, &__log_desc, \
+                    static_cast<ARG_TYPE(fmt1)>(a1), \
+                    static_cast<ARG_TYPE(fmt2)>(a2)); \
+} while (0);
+
+//---------------------------------------------------------------------------
+#define _DEBUG_LOG1(lim, s, fmt1, a1) \
+do { \
+    EMIT_DBG_STRING(s); \
+    static constexpr LogSite_t __log_desc = LOG_SITE(1, \
+        sizeof(LogHeader_t) + sizeof(uint8_t) + SIZE(fmt1), \
+        TLV(fmt1)); \
+    LogBuf::LogSite(lim, &__log_desc, \
+                    static_cast<ARG_TYPE(fmt1)>(a1)); \
+} while (0);
+
+//---------------------------------------------------------------------------
+#define _DEBUG_LOG0(lim, s) \
+do { \
+    EMIT_DBG_STRING(s); \
+    static constexpr LogSite_t __log_desc = LOG_SITE(0, sizeof(LogHeader_t)); \
+    LogBuf::LogSite(lim, &__log_desc); \
+} while (0);
+#endif
+
 //---------------------------------------------------------------------------
 #define _LOG_ERROR \
 	#error "Each argument requires a matching format tag"
@@ -273,6 +477,107 @@ do { \
 // a huge boost in usability and maintainability, as users would otherwise have to manually 
 // select a macro based on the number of arguments.
 #define _GET_OVERRIDE(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, NAME, ...) NAME
-#define DEBUG_LOG(x, ...) _GET_OVERRIDE("ignore", ##__VA_ARGS__, _LOG_ERROR, _DEBUG_LOG5, _LOG_ERROR, _DEBUG_LOG4, _LOG_ERROR, _DEBUG_LOG3, _LOG_ERROR, _DEBUG_LOG2, _LOG_ERROR, _DEBUG_LOG1, _LOG_ERROR, _DEBUG_LOG0)(x, ##__VA_ARGS__)
+#define _DEBUG_LOG_SELECT(x, ...) _GET_OVERRIDE("ignore", ##__VA_ARGS__, _LOG_ERROR, _DEBUG_LOG5, _LOG_ERROR, _DEBUG_LOG4, _LOG_ERROR, _DEBUG_LOG3, _LOG_ERROR, _DEBUG_LOG2, _LOG_ERROR, _DEBUG_LOG1, _LOG_ERROR, _DEBUG_LOG0)
 
+//---------------------------------------------------------------------------
+// Runtime site filtering (see LOGBUF_SITE_FILTER).  Each site's key is placed
+// in the "logger_sites" section, and its index within the section selects its
+// bit in the enable bitmap; a disabled site costs that one bit test.
+#if defined(LOGBUF_SITE_FILTER)
+#define _LOG_SITE_FILTER() \
+    static const LogSiteKey_t __log_key __attribute__((section("logger_sites"), aligned(sizeof(LogSiteKey_t)), used)) = \
+        { FILE_HASH, (uint16_t)__LINE__, 0 }; \
+    if (!LogBuf::SiteEnabled(&__log_key)) { break; }
+
+#define DEBUG_LOG(x, ...) \
+do { \
+    _LOG_SITE_FILTER() \
+    _DEBUG_LOG_SELECT(x, ##__VA_ARGS__)(nullptr, x, ##__VA_ARGS__) \
+} while (0);
+#else
+#define _LOG_SITE_FILTER()
+
+#define DEBUG_LOG(x, ...) _DEBUG_LOG_SELECT(x, ##__VA_ARGS__)(nullptr, x, ##__VA_ARGS__)
+#endif
+
+//---------------------------------------------------------------------------
+// Log-once, sampled, and rate-limited variants of DEBUG_LOG().  Each site keeps
+// its own static state (see LogLimit_t), checked before the arguments are
+// evaluated, the timestamp is read, or a critical section is entered.  Records
+// from sampled and rate-limited sites carry the number of calls suppressed
+// since the site's previous record (see log_flag_suppressed).
+#define _DEBUG_LOG_LIMITED(check, x, ...) \
+do { \
+    static LogLimit_t __log_limit; \
+    _LOG_SITE_FILTER() \
+    if (!(check)) { break; } \
+    _DEBUG_LOG_SELECT(x, ##__VA_ARGS__)(&__log_limit, x, ##__VA_ARGS__) \
+} while (0);
+
+// Log only the first call to the site
+#define DEBUG_LOG_ONCE(x, ...) _DEBUG_LOG_LIMITED(LogBuf::LimitOnce(&__log_limit), x, ##__VA_ARGS__)
+
+// Log the first call to the site, and every nth call after it
+#define DEBUG_LOG_EVERY_N(n, x, ...) _DEBUG_LOG_LIMITED(LogBuf::LimitEveryN(&__log_limit, (n)), x, ##__VA_ARGS__)
+
+// Log at most count calls to the site per interval of ms milliseconds
+#define DEBUG_LOG_RATE(count, ms, x, ...) _DEBUG_LOG_LIMITED(LogBuf::LimitRate(&__log_limit, (count), (ms)), x, ##__VA_ARGS__)
+
+//---------------------------------------------------------------------------
+// Scoped duration tracing.  Each scope is named in the ".logger" section (see
+// LogSectionType::Scope), and is identified in its begin/end records by the
+// hash of its name, so host tools can pair them and measure the time spent
+// within the scope.  TRACE_SCOPE() brackets the rest of the enclosing block;
+// TRACE_BEGIN() and TRACE_END() bracket code that doesn't map onto a block,
+// and are paired by name, so may be placed in different functions or files.
+#define EMIT_DBG_SCOPE(name)                                                                                \
+    do {                                                                                                    \
+        const static LogSectionRecord_t<sizeof(name)> __log_scope                                           \
+            __attribute__((section(".logger"), aligned(4))) __attribute__((used))                           \
+            = LOG_SECTION_RECORD(LogSectionType::Scope, __LINE__, name);                                    \
+    } while (0);
+
+#define SCOPE_ID(name) hash_32_fnv1a_const(name)
+
+#define _TRACE_CONCAT_I(a, b) a##b
+#define _TRACE_CONCAT(a, b) _TRACE_CONCAT_I(a, b)
+
+#define TRACE_SCOPE(name) \
+    EMIT_DBG_SCOPE(name) \
+    LogTraceScope _TRACE_CONCAT(__log_trace_scope_, __LINE__)(SCOPE_ID(name));
+
+#define TRACE_BEGIN(name) \
+do { \
+    EMIT_DBG_SCOPE(name); \
+    LogBuf::LogScope(LogSystemRecord::ScopeBegin, SCOPE_ID(name)); \
+} while (0);
+
+#define TRACE_END(name) \
+do { \
+    EMIT_DBG_SCOPE(name); \
+    LogBuf::LogScope(LogSystemRecord::ScopeEnd, SCOPE_ID(name)); \
+} while (0);
 
+//---------------------------------------------------------------------------
+// On-target metrics (see LogMetric), declared at namespace scope.  Each metric
+// is named in the ".logger" section, and identified in its summary records by
+// the hash of its name.  Histogram bounds must be integer literals, as they're
+// also recorded in the ".logger" section (following the name) for host tools.
+#define METRIC_ID(name) hash_32_fnv1a_const(name)
+
+#define EMIT_DBG_METRIC(var, type, str)                                                                     \
+        const static LogSectionRecord_t<sizeof(str)> __log_metric_##var                                     \
+            __attribute__((section(".logger"), aligned(4))) __attribute__((used))                           \
+            = LOG_SECTION_RECORD(type, __LINE__, str);
+
+#define LOG_COUNTER(var, name) \
+    EMIT_DBG_METRIC(var, LogSectionType::Counter, name) \
+    LogCounter var(METRIC_ID(name));
+
+#define LOG_GAUGE(var, name) \
+    EMIT_DBG_METRIC(var, LogSectionType::Gauge, name) \
+    LogGauge var(METRIC_ID(name));
+
+#define LOG_HISTOGRAM(var, name, ...) \
+    EMIT_DBG_METRIC(var, LogSectionType::Histogram, name "|" #__VA_ARGS__) \
+    LogHistogram<LogArgCount(__VA_ARGS__)> var(METRIC_ID(name), __VA_ARGS__);
@@ -0,0 +1,191 @@
+/*===========================================================================
+     _____        _____        _____        _____
+ ___|    _|__  __|_    |__  __|__   |__  __| __  |__  ______
+|    \  /  | ||    \      ||     |     ||  |/ /     ||___   |
+|     \/   | ||     \     ||     \     ||     \     ||___   |
+|__/\__/|__|_||__|\__\  __||__|\__\  __||__|\__\  __||______|
+    |_____|      |_____|      |_____|      |_____|
+
+--[Mark3 Realtime Platform]--------------------------------------------------
+
+Copyright (c) 2019 m0slevin, all rights reserved.
+See license.txt for more information
+=========================================================================== */
+/*!
+  @file logmetric.h On-target aggregated metrics: counters, gauges and histograms
+ */
+#pragma once
+
+#include "logtypes.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+//---------------------------------------------------------------------------
+// Maximum length of the arguments of a metric's summary record: its id, and a
+// histogram's bucket counts.
+constexpr auto metric_summary_max = (sizeof(uint8_t) + sizeof(uint32_t)) + (sizeof(uint8_t) + sizeof(uint16_t))
+                                    + (metric_max_buckets * sizeof(uint32_t));
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogMetric class
+ *
+ * Base of the metric primitives (LogCounter, LogGauge and LogHistogram).  A
+ * metric is updated in place, without writing to the log; instead, each
+ * metric is summarized once per interval by the primary log buffer's flush
+ * (see LogBuf::SetMetricInterval()), as a single metric record.  High-rate
+ * signals thus cost a few instructions per event, rather than a record.
+ *
+ * Metrics are declared at namespace scope with LOG_COUNTER(), LOG_GAUGE() and
+ * LOG_HISTOGRAM(), which name them in the .logger section, and link them into
+ * a list during static initialization.
+ */
+class LogMetric {
+public:
+    static LogMetric* First() { return m_pclHead; }
+    LogMetric* Next() const { return m_pclNext; }
+
+    /**
+     * @brief Summarize
+     *
+     * Encode the metric's summary for the interval just ended as the arguments
+     * of a metric record, and start a new interval.
+     *
+     * @param pu8Tlv_ [out] TLV-encoded arguments (at least metric_summary_max bytes)
+     * @param pu8Count_ [out] Number of arguments
+     * @return Length of the arguments, in bytes
+     */
+    int Summarize(uint8_t* pu8Tlv_, uint8_t* pu8Count_);
+
+protected:
+    enum class Kind : uint8_t {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    LogMetric(Kind eKind_, uint32_t u32Id_);
+
+private:
+    static LogMetric* m_pclHead;
+
+    LogMetric* m_pclNext;
+    uint32_t m_u32Id;
+    Kind m_eKind;
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogCounter class
+ *
+ * Counts events, reporting the number counted in each interval.
+ */
+class LogCounter : public LogMetric {
+public:
+    explicit LogCounter(uint32_t u32Id_) : LogMetric(Kind::Counter, u32Id_) {}
+
+    void Add(uint32_t u32Count_ = 1) { __atomic_fetch_add(&m_u32Count, u32Count_, __ATOMIC_RELAXED); }
+
+private:
+    friend class LogMetric;
+    uint32_t m_u32Count = 0;
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogGauge class
+ *
+ * Tracks a level (i.e. a queue depth), reporting its last, minimum and maximum
+ * values in each interval.  Updates aren't atomic: a value set concurrently
+ * from another context, or while the gauge is summarized, may be missed from
+ * the minimum or maximum.
+ */
+class LogGauge : public LogMetric {
+public:
+    explicit LogGauge(uint32_t u32Id_) : LogMetric(Kind::Gauge, u32Id_) {}
+
+    void Set(int32_t i32Value_)
+    {
+        m_i32Value = i32Value_;
+        if (i32Value_ < m_i32Min) {
+            m_i32Min = i32Value_;
+        }
+        if (i32Value_ > m_i32Max) {
+            m_i32Max = i32Value_;
+        }
+    }
+
+private:
+    friend class LogMetric;
+    int32_t m_i32Value = 0;
+    int32_t m_i32Min = INT32_MAX;   // Empty range while not set in the interval
+    int32_t m_i32Max = INT32_MIN;
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogHistogramBase class
+ *
+ * Counts values into fixed buckets, reporting the count in each bucket per
+ * interval.  Bucket i counts values up to (and including) the ith bound, and
+ * the last bucket counts values above the last bound.  See LogHistogram.
+ */
+class LogHistogramBase : public LogMetric {
+public:
+    void Record(uint32_t u32Value_)
+    {
+        auto i = 0;
+        while ((i < m_iBounds) && (u32Value_ > m_pu32Bounds[i])) {
+            i++;
+        }
+        __atomic_fetch_add(&m_pu32Counts[i], 1, __ATOMIC_RELAXED);
+    }
+
+protected:
+    LogHistogramBase(uint32_t u32Id_, const uint32_t* pu32Bounds_, uint32_t* pu32Counts_, int iBounds_)
+    : LogMetric(Kind::Histogram, u32Id_)
+    , m_pu32Bounds{pu32Bounds_}
+    , m_pu32Counts{pu32Counts_}
+    , m_iBounds{iBounds_}
+    {}
+
+private:
+    friend class LogMetric;
+    const uint32_t* m_pu32Bounds;
+    uint32_t* m_pu32Counts;
+    int m_iBounds;
+};
+
+//---------------------------------------------------------------------------
+/**
+ * @brief The LogHistogram class
+ *
+ * Histogram with N ascending bucket bounds (and so N + 1 buckets), given to
+ * the constructor.
+ */
+template <int N>
+class LogHistogram : public LogHistogramBase {
+public:
+    template <typename... Bounds>
+    LogHistogram(uint32_t u32Id_, Bounds... bounds_)
+    : LogHistogramBase(u32Id_, m_au32Bounds, m_au32Counts, N)
+    , m_au32Bounds{(uint32_t)bounds_...}
+    {
+        static_assert(sizeof...(Bounds) == N, "A bound is required for each bucket but the last");
+        static_assert((N + 1) <= metric_max_buckets, "Too many buckets (see metric_max_buckets)");
+    }
+
+private:
+    uint32_t m_au32Bounds[N];
+    uint32_t m_au32Counts[N + 1] = {};
+};
+
+//---------------------------------------------------------------------------
+// Number of arguments in a list, as a constant expression (used to size a
+// histogram from its bounds)
+template <typename... Args>
+constexpr int LogArgCount(Args...)
+{
+    return sizeof...(Args);
+}
@@ -23,6 +23,25 @@ See license.txt for more information
 constexpr auto tag_bits = 4;
 constexpr auto length_bits = 8 - tag_bits;
 
+//---------------------------------------------------------------------------
+// Maximum number of characters copied from a runtime string by a TagStrcopy
+// argument (must not exceed UINT8_MAX).
+constexpr auto strcopy_max_length = 32;
+
+//---------------------------------------------------------------------------
+// Maximum number of bytes copied into the log by a TagBlob argument.  This
+// must leave room in the LogBuf ring for the rest of the record.
+constexpr auto blob_max_length = 128;
+
+//---------------------------------------------------------------------------
+// Maximum number of arguments logged by a single DEBUG_LOG() call
+constexpr auto site_max_args = 5;
+
+//---------------------------------------------------------------------------
+// Maximum number of buckets in a histogram metric (including the overflow
+// bucket), so that its summary fits in a single TagBlob argument.
+constexpr auto metric_max_buckets = blob_max_length / sizeof(uint32_t);
+
 //---------------------------------------------------------------------------
 // Enumeration describing the different types of argument data that are
 // supported by the logging macros.
@@ -39,6 +58,9 @@ enum class LogTag {
     LogTagFloat,
     LogTagDouble,
     LogTagChar,
+    LogTagString,   //!< Pointer to a constant string, resolved on the host from the .elf file
+    LogTagStrcopy,  //!< Bounded copy of a runtime string: TLV length 1, then a length byte and the characters
+    LogTagBlob,     //!< Bounded copy of a byte range: TLV length 2, then a 16-bit length and the bytes
 };
 
 //---------------------------------------------------------------------------
@@ -56,7 +78,52 @@ enum class SizeTag : uint8_t {
     LogTagVoidptr =   (sizeof(void*)),
     LogTagFloat =     (sizeof(float)),
     LogTagDouble =    (sizeof(double)),
-    LogTagChar =      (sizeof(char))
+    LogTagChar =      (sizeof(char)),
+    LogTagString =    (sizeof(const char*)),
+    LogTagStrcopy =   (sizeof(uint8_t)),
+    LogTagBlob =      (sizeof(uint16_t))
+};
+
+//---------------------------------------------------------------------------
+// Build the tag/length byte that precedes an argument's value in a record
+constexpr uint8_t tlv_byte(LogTag tag_, SizeTag size_)
+{
+    return (uint8_t)((unsigned int)tag_ | ((unsigned int)size_ << tag_bits));
+}
+
+//---------------------------------------------------------------------------
+// Argument value for a TagStrcopy argument.  Constructing this object from a
+// string computes (once) the number of characters that will be copied into the
+// log, so the record length and its contents are guaranteed to be consistent,
+// even if the string is modified while it's being logged.
+struct __attribute__((packed)) LogStrcopy_t {
+    LogStrcopy_t() = default;
+    LogStrcopy_t(const char* szString_)
+    : str{szString_}
+    , length{0}
+    {
+        while (szString_ && (length < strcopy_max_length) && szString_[length]) {
+            length++;
+        }
+    }
+
+    const char* str;
+    uint8_t     length;
+};
+
+//---------------------------------------------------------------------------
+// Argument value for a TagBlob argument, describing a range of bytes (i.e. a
+// packet or a block of registers) to copy into the log as a single argument,
+// truncated to blob_max_length bytes.
+struct __attribute__((packed)) LogBlob_t {
+    LogBlob_t() = default;
+    LogBlob_t(const void* pvData_, size_t uLength_)
+    : data{pvData_}
+    , length{(uint16_t)((uLength_ < blob_max_length) ? uLength_ : blob_max_length)}
+    {}
+
+    const void* data;
+    uint16_t    length;
 };
 
 //---------------------------------------------------------------------------
@@ -75,6 +142,9 @@ typedef union __attribute__((packed)) {
     float       v_TagFloat;
     double      v_TagDouble;
     char        v_TagChar;
+    const char* v_TagString;
+    LogStrcopy_t v_TagStrcopy;
+    LogBlob_t   v_TagBlob;
 } LogVariant_t;
 
 //---------------------------------------------------------------------------
@@ -97,3 +167,177 @@ typedef struct __attribute__((packed)) {
     uint16_t line;
     uint8_t log_count;
 } LogHeader_t;
+
+//---------------------------------------------------------------------------
+// The upper bits of a record's log_count flag optional framing fields (see
+// LOGBUF_FRAMING) and suppressed-call counts (see DEBUG_LOG_EVERY_N()),
+// leaving the lower bits for the number of arguments.
+constexpr uint8_t log_count_mask = 0x1F;
+constexpr uint8_t log_flag_suppressed = 0x20;    //!< The last argument (TagUint32, included in the count) is the number of calls to the site suppressed since its previous record
+constexpr uint8_t log_flag_sequence = 0x40;  //!< A 16-bit sequence number follows the header
+constexpr uint8_t log_flag_crc = 0x80;       //!< A CRC-16 of the preceding fields (after the start sync word) precedes the end sync word
+
+//---------------------------------------------------------------------------
+// Constant description of a DEBUG_LOG() call site, generated at build time and
+// stored in flash, so that the code emitted at each call site is reduced to
+// passing the descriptor and argument values to a shared encoder (see
+// LogBuf::LogSite()).
+struct LogSite_t {
+    uint32_t file_id;               //!< Hash of the site's file
+    uint16_t line;                  //!< Line number of the site
+    uint8_t  log_count;             //!< Number of arguments
+    uint8_t  length;                //!< Record length, excluding variable-length argument data
+    uint8_t  tlv[site_max_args];    //!< Tag/length byte of each argument
+};
+
+//---------------------------------------------------------------------------
+// State of a log-once, sampled or rate-limited call site (see DEBUG_LOG_ONCE(),
+// DEBUG_LOG_EVERY_N() and DEBUG_LOG_RATE()), allocated statically at the site.
+struct LogLimit_t {
+    uint32_t suppressed;    //!< Calls suppressed since the site's last record
+    uint32_t count;         //!< Calls still to skip (sampled), records written in the current window (rate-limited), or non-zero once logged (log-once)
+    uint32_t window;        //!< Timestamp at the start of the current window (rate-limited)
+    uint32_t period;        //!< Length of a window, in timestamp ticks (rate-limited)
+};
+
+//---------------------------------------------------------------------------
+// Key of a DEBUG_LOG() call site, placed in the "logger_sites" section of the
+// target image when sites can be filtered at runtime (see LOGBUF_SITE_FILTER).
+// Keys are placed at an alignment equal to their size, so the section is a
+// dense array, and a site's index within it selects its bit in the target's
+// enable bitmap.
+typedef struct __attribute__((packed)) {
+    uint32_t file_id;   //!< Hash of the site's file
+    uint16_t line;      //!< Line number of the site
+    uint16_t reserved;
+} LogSiteKey_t;
+
+//---------------------------------------------------------------------------
+// Commands sent by the host to filter sites at runtime (see LogCommandReader).
+// Each is framed by a LogCommandHeader_t, followed by count site indexes
+// (uint16_t), and a CRC-16 of the header and indexes.
+constexpr uint16_t command_sync = 0x5173;
+constexpr auto command_max_sites = 64;
+
+enum class LogCommand : uint8_t {
+    EnableSites = 1,    //!< Enable the sites whose indexes follow
+    DisableSites = 2,   //!< Disable the sites whose indexes follow
+    EnableAll = 3,      //!< Enable every site
+    DisableAll = 4,     //!< Disable every site
+};
+
+typedef struct __attribute__((packed)) {
+    uint16_t sync;      //!< command_sync
+    uint8_t  command;   //!< LogCommand
+    uint8_t  count;     //!< Number of site indexes following (at most command_max_sites)
+} LogCommandHeader_t;
+
+//---------------------------------------------------------------------------
+// Records generated by the logger itself (rather than a DEBUG_LOG() site) are
+// tagged with a reserved file_id, and use the line field to identify the type
+// of record.  FNV1a-32 file hashes are never zero in practice.
+constexpr uint32_t system_file_id = 0;
+
+//---------------------------------------------------------------------------
+// Types of records generated by the logger itself, stored in the line field.
+enum class LogSystemRecord : uint16_t {
+    ClockSync = 1,  //!< TagUint64: wall-clock time (microseconds since epoch) at the record's timestamp
+    ClockRate = 2,  //!< TagUint32: timestamp frequency (Hz), TagUint64: record's timestamp, extended to 64 bits
+    Shard = 3,      //!< TagUint8: shard that the records following this one were flushed from, TagUint8: number of shards
+    PostMortem = 4, //!< TagUint8: 1 ahead of records recovered from before a reset, 0 following them
+    Trigger = 5,    //!< Marks where a snapshot was triggered, within the window of records around it
+    Repeat = 6,     //!< TagUint32: number of duplicates of the shard's previous record (see LogBuf::SetCoalescing()), at the timestamp of the last
+    ScopeBegin = 7, //!< TagUint32: scope id (hash of the scope's name; see TRACE_BEGIN()) entered
+    ScopeEnd = 8,   //!< TagUint32: scope id (hash of the scope's name; see TRACE_END()) exited
+    Metric = 9,     //!< TagUint32: metric id (hash of the metric's name; see LogMetric), then its summary for the interval:
+                    //!< TagUint32 count (counters), TagInt32 last, min and max values (gauges), or a TagBlob
+                    //!< holding a uint32_t count per bucket (histograms)
+    Stats = 10,     //!< TagUint32 each: the shard's records and bytes committed, records and bytes flushed, overruns,
+                    //!< high-water mark (bytes), max and mean critical-section time, max and mean flush time, and the
+                    //!< frequency (Hz) of the clock the times are in (see LOGBUF_STATS)
+    SiteFilter = 11, //!< TagUint8: site filter command (see LogCommand) executed, TagUint16: number of sites it changed
+};
+
+//---------------------------------------------------------------------------
+// Header of a shard's flight recorder (see LOGBUF_NOINIT), immediately
+// followed in memory by the shard's ring buffer.  This describes the committed,
+// and as-yet unflushed, records in the ring, so they can be recovered after a
+// reset, or from a dump of the target's RAM.
+constexpr uint32_t flight_recorder_magic = 0x5246334D;  // "M3FR"
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;         //!< flight_recorder_magic
+    uint8_t  shard;         //!< Index of the shard
+    uint8_t  shard_count;   //!< Number of shards
+    uint16_t size;          //!< Size of the ring buffer following the header
+    uint16_t read_idx;      //!< End of the committed records in the ring
+    uint16_t last_read_idx; //!< Start of the unflushed records in the ring
+    uint32_t crc;           //!< CRC-32 of the preceding fields
+} LogFlightHeader_t;
+
+//---------------------------------------------------------------------------
+// Compressed log data (see LogCompressor) is written as a series of blocks,
+// each holding an LZSS bitstream: MSB-first tokens of a 1 bit and a literal
+// byte, or a 0 bit, the match distance - 1 (window_bits), and the match
+// length - compressed_min_match (length_bits).  Matches refer to the
+// preceding (uncompressed) data of the stream, up to the window size back;
+// a keyframe block resets the window to zeros first, so it can be decoded
+// without any of the blocks before it.
+constexpr uint16_t compressed_block_sync = 0xC0DE;
+constexpr uint8_t compressed_flag_keyframe = 0x01;
+constexpr auto compressed_min_match = 3;
+
+typedef struct __attribute__((packed)) {
+    uint16_t sync;          //!< compressed_block_sync
+    uint8_t  sequence;      //!< Incremented with each block
+    uint8_t  flags;         //!< compressed_flag_keyframe
+    uint8_t  params;        //!< Window bits (upper nibble) and length bits (lower nibble)
+    uint16_t raw_length;    //!< Number of bytes encoded by the block
+    uint16_t length;        //!< Number of bytes of bitstream following the header
+} LogCompressedHeader_t;
+
+//---------------------------------------------------------------------------
+// .logger section format (version 2).  The section consists of a contiguous
+// series of records, each starting with a LogSectionHeader_t, followed by a
+// nul-terminated string (a format string for a log site, or a file name for a
+// file record), and padded to a multiple of 4 bytes.  Each record's length
+// covers the header, string and padding, so the section can be walked without
+// any knowledge of the compiler's layout rules.  Parsers skip zero-filled
+// 32-bit words between records, which a linker may insert when aligning the
+// .logger sections of separate object files; a record never starts with zero.
+constexpr uint16_t logger_section_magic = 0x4C4D;  // "ML"
+constexpr uint8_t logger_section_version = 2;
+
+//---------------------------------------------------------------------------
+// Types of records stored in the .logger section
+enum class LogSectionType : uint8_t {
+    File = 1,       //!< Maps a file hash (file_id) to a file name
+    Site = 2,       //!< Maps a file hash and line to a format string
+    Scope = 3,      //!< Names a traced scope (see TRACE_SCOPE()) at a file hash and line
+    Counter = 4,    //!< Names a counter metric (see LOG_COUNTER())
+    Gauge = 5,      //!< Names a gauge metric (see LOG_GAUGE())
+    Histogram = 6,  //!< Names a histogram metric (see LOG_HISTOGRAM()), followed by '|' and its bucket bounds
+};
+
+//---------------------------------------------------------------------------
+// Fixed-size header common to all .logger section records
+typedef struct __attribute__((packed)) {
+    uint16_t magic;     //!< logger_section_magic
+    uint8_t version;    //!< logger_section_version
+    uint8_t type;       //!< LogSectionType
+    uint16_t length;    //!< Total length of the record (header, string, padding)
+    uint16_t line;      //!< Line of the log site (0 for file records)
+    uint32_t file_id;   //!< FNV1a-32 hash of the source file name
+} LogSectionHeader_t;
+
+//---------------------------------------------------------------------------
+// A complete .logger section record, emitted at build time by the logging
+// macros.  Aligning the record to 4 bytes pads its size to a multiple of 4;
+// the macros also declare each record with an explicit 4-byte alignment, so
+// the compiler won't over-align larger records, and consecutive records are
+// laid out back-to-back.
+template <size_t N>
+struct __attribute__((packed, aligned(4))) LogSectionRecord_t {
+    LogSectionHeader_t header;
+    char str[N];
+};